@@ -24,15 +24,13 @@ DEFINES += QT_DEPRECATED_WARNINGS
 
 CONFIG += c++11
 
+include(qmultiheader.pri)
+
 SOURCES += \
-        hierarchicalheadermodel.cpp \
-        hierarchicalheaderview.cpp \
         main.cpp \
         mainwindow.cpp
 
 HEADERS += \
-        hierarchicalheadermodel.h \
-        hierarchicalheaderview.h \
         mainwindow.h
 
 FORMS += \
@@ -0,0 +1,21 @@
+#-------------------------------------------------
+#
+# Randomized mutation stress run for the header view,
+# checks the layout cache after every step.
+# Run with -platform offscreen on machines without a display.
+#
+#-------------------------------------------------
+
+QT       += core gui widgets
+
+TARGET = headerstress
+TEMPLATE = app
+CONFIG += c++11 console
+CONFIG -= app_bundle
+
+DEFINES += QT_DEPRECATED_WARNINGS
+
+include(../../qmultiheader.pri)
+
+SOURCES += \
+        main.cpp
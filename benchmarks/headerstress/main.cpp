@@ -0,0 +1,307 @@
+#include "hierarchicalcolumnproxymodel.h"
+#include "hierarchicalheadermodel.h"
+#include "hierarchicalheaderview.h"
+
+#include <QApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QImage>
+#include <QStandardItem>
+#include <QStandardItemModel>
+#include <QTextStream>
+#include <QVector>
+
+#include <algorithm>
+#include <random>
+
+namespace {
+
+enum Mutation {
+    AppendColumn,
+    RemoveColumn,
+    SetSectionTitle,
+    SetColumnItemValue,
+    SelectColumn,
+    FilterState,
+    MoveSection,
+    ResizeSection,
+    CollapseGroup,
+    MoveGroup,
+    MutationCount
+};
+
+const char *const mutationNames[MutationCount] = {
+    "appendColumnItem", "removeColumnItem", "setSectionTitle", "setColumnItemValue",
+    "setSelectedColumn", "setColunmFilterState", "moveSection", "resizeSection",
+    "setGroupCollapsed", "moveGroup"
+};
+
+class StressRun
+{
+public:
+    StressRun(quint32 seed, int leaves)
+        : m_random(seed), m_serial(0)
+    {
+        QStandardItemModel *tree = new QStandardItemModel;
+        while (tree->columnCount() < 2 || leafTotal(tree) < leaves)
+            tree->appendColumn({ randomItem() });
+
+        m_model = new HierarchicalHeaderModel(tree);
+        tree->setParent(m_model);
+
+        m_view = new HierarchicalHeaderView(Qt::Horizontal);
+        m_view->setCanSort(true);
+        m_view->setCanFilter(true);
+        m_view->setGroupsCollapsible(true);
+        m_view->setSectionsMovable(true);
+        m_view->setModel(m_model);
+        m_view->resize(1600, 90);
+        m_view->show();
+
+        m_image = QImage(m_view->size(), QImage::Format_ARGB32_Premultiplied);
+    }
+
+    ~StressRun()
+    {
+        delete m_view;
+        delete m_model;
+    }
+
+    int uniform(int low, int high)
+    {
+        return std::uniform_int_distribution<int>(low, high)(m_random);
+    }
+
+    Mutation step()
+    {
+        const Mutation mutation = static_cast<Mutation>(uniform(0, MutationCount - 1));
+        const int sections = m_view->count();
+        const int topColumns = topLevelCount();
+
+        switch (mutation) {
+        case AppendColumn:
+            m_model->appendColumnItem(randomItem());
+            break;
+        case RemoveColumn:
+            if (topColumns > 2)
+                m_model->removeColumnItem(uniform(0, topColumns - 1), 1, -1);
+            break;
+        case SetSectionTitle: {
+            const int column = uniform(0, topColumns - 1);
+            m_model->setSectionTitle(column, nextTitle(), uniform(-1, 2));
+            break;
+        }
+        case SetColumnItemValue:
+            m_model->setColumnItemValue(uniform(0, topColumns - 1), nextTitle());
+            break;
+        case SelectColumn:
+            m_view->setSelectedColumn(uniform(-1, sections - 1));
+            break;
+        case FilterState:
+            m_view->setColunmFilterState(uniform(0, sections - 1), uniform(0, 2),
+                                         uniform(0, 1) ? HierarchicalHeaderModel::CanFilter
+                                                       : HierarchicalHeaderModel::FilterBtnState);
+            break;
+        case MoveSection:
+            m_view->moveSection(uniform(0, sections - 1), uniform(0, sections - 1));
+            break;
+        case ResizeSection:
+            m_view->resizeSection(uniform(0, sections - 1), uniform(0, 4) == 0 ? uniform(2, 12) : uniform(20, 240));
+            break;
+        case CollapseGroup: {
+            const QModelIndex group = m_view->getModelIndexByColumn(uniform(0, sections - 1)).parent();
+            if (group.isValid())
+                m_view->setGroupCollapsed(group, !m_view->isGroupCollapsed(group));
+            break;
+        }
+        case MoveGroup: {
+            const QModelIndex group = m_view->getModelIndexByColumn(uniform(0, sections - 1));
+            if (!group.isValid())
+                break;
+            const QModelIndex node = uniform(0, 1) ? group : (group.parent().isValid() ? group.parent() : group);
+            const int siblings = node.model()->columnCount(node.parent());
+            const QModelIndex target = node.model()->index(0, uniform(0, siblings - 1), node.parent());
+            m_view->moveGroup(node, target, uniform(0, 1) == 1);
+            break;
+        }
+        case MutationCount:
+            break;
+        }
+        return mutation;
+    }
+
+    // lays out and paints the whole header, what a visible view does after a change
+    void relayout()
+    {
+        QCoreApplication::processEvents();
+        m_image.fill(Qt::white);
+        m_view->render(&m_image);
+    }
+
+    bool verify(QString *error) const
+    {
+        return m_view->verifyLayoutCache(error);
+    }
+
+    int sectionCount() const { return m_view->count(); }
+
+private:
+    static int leafTotal(const QStandardItemModel *tree)
+    {
+        int count = 0;
+        for (int i = 0; i < tree->columnCount(); ++i) {
+            const int children = tree->item(0, i)->columnCount();
+            count += children == 0 ? 1 : children;
+        }
+        return count;
+    }
+
+    int topLevelCount() const
+    {
+        const QModelIndex leaf = m_view->getModelIndexByColumn(0);
+        return leaf.isValid() ? leaf.model()->columnCount() : 0;
+    }
+
+    QString nextTitle()
+    {
+        return QString("section %1").arg(++m_serial);
+    }
+
+    // a top level column with no, one or a handful of leaves, a few titles are long
+    QStandardItem *randomItem()
+    {
+        QStandardItem *item = new QStandardItem(nextTitle());
+        const int children = uniform(0, 3) == 0 ? 0 : uniform(1, 6);
+        for (int i = 0; i < children; ++i) {
+            QString title = nextTitle();
+            if (uniform(0, 9) == 0)
+                title += QString(" with a much longer caption").repeated(uniform(1, 3));
+            item->appendColumn({ new QStandardItem(title) });
+        }
+        return item;
+    }
+
+    std::mt19937 m_random;
+    int m_serial;
+    HierarchicalHeaderModel *m_model;
+    HierarchicalHeaderView *m_view;
+    QImage m_image;
+};
+
+// hidden columns of the proxy stay the same source columns across structural changes of the source
+bool checkColumnProxy(QString *error)
+{
+    QStandardItemModel source(1, 8);
+    for (int column = 0; column < source.columnCount(); ++column)
+        source.setHeaderData(column, Qt::Horizontal, QString("column %1").arg(column));
+    HierarchicalColumnProxyModel proxy;
+    proxy.setSourceModel(&source);
+    proxy.setColumnHidden(5, true);
+
+    const auto hiddenTitles = [&]() {
+        QStringList titles;
+        for (int column = 0; column < source.columnCount(); ++column) {
+            if (proxy.isColumnHidden(column))
+                titles << source.headerData(column, Qt::Horizontal).toString();
+        }
+        return titles;
+    };
+    const QStringList expected = QStringList() << "column 5";
+
+    source.insertColumn(0);
+    if (hiddenTitles() != expected) {
+        *error = "column proxy: hidden column moved after an insertion in front of it";
+        return false;
+    }
+    source.removeColumns(1, 2);
+    if (hiddenTitles() != expected) {
+        *error = "column proxy: hidden column moved after a removal in front of it";
+        return false;
+    }
+    if (proxy.columnCount() != source.columnCount() - 1) {
+        *error = "column proxy: column count differs from the source after structural changes";
+        return false;
+    }
+    return true;
+}
+
+qint64 percentile(const QVector<qint64> &sorted, double p)
+{
+    if (sorted.isEmpty())
+        return 0;
+    const int position = qBound(0, int(p * (sorted.size() - 1) + 0.5), sorted.size() - 1);
+    return sorted.at(position);
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    QApplication a(argc, argv);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Random mutations against HierarchicalHeaderModel/HierarchicalHeaderView, "
+                                     "the layout cache is checked against a fresh computation after every step.");
+    parser.addHelpOption();
+    QCommandLineOption seedOption("seed", "Random seed.", "n", "1");
+    QCommandLineOption stepsOption("steps", "Number of mutations.", "n", "5000");
+    QCommandLineOption leavesOption("leaves", "Initial leaf count.", "n", "200");
+    QCommandLineOption noVerifyOption("no-verify", "Only measure, skip the cache check.");
+    parser.addOption(seedOption);
+    parser.addOption(stepsOption);
+    parser.addOption(leavesOption);
+    parser.addOption(noVerifyOption);
+    parser.process(a);
+
+    const quint32 seed = parser.value(seedOption).toUInt();
+    const int steps = qMax(1, parser.value(stepsOption).toInt());
+    const bool verify = !parser.isSet(noVerifyOption);
+
+    QTextStream out(stdout);
+    StressRun run(seed, qMax(2, parser.value(leavesOption).toInt()));
+
+    QString error;
+    if (verify && !checkColumnProxy(&error)) {
+        out << error << endl;
+        return 1;
+    }
+    if (verify && !run.verify(&error)) {
+        out << "initial layout cache is wrong: " << error << endl;
+        return 1;
+    }
+
+    QVector<qint64> latencies;
+    latencies.reserve(steps);
+    QVector<int> counts(MutationCount, 0);
+    qint64 busy = 0;
+    QElapsedTimer timer;
+
+    for (int i = 0; i < steps; ++i) {
+        timer.start();
+        const Mutation mutation = run.step();
+        run.relayout();
+        const qint64 elapsed = timer.nsecsElapsed();
+        busy += elapsed;
+        latencies.append(elapsed);
+        ++counts[mutation];
+
+        if (verify && !run.verify(&error)) {
+            out << "step " << i << " (" << mutationNames[mutation] << ", seed " << seed << "): " << error << endl;
+            return 1;
+        }
+    }
+
+    std::sort(latencies.begin(), latencies.end());
+
+    out << "seed " << seed << ", " << steps << " steps, " << run.sectionCount() << " sections at the end" << endl;
+    for (int i = 0; i < MutationCount; ++i)
+        out << "  " << mutationNames[i] << ": " << counts.at(i) << endl;
+    out << "mutations/s: " << (busy > 0 ? qint64(steps * 1e9 / busy) : 0) << endl;
+    out << "relayout latency us, p50 " << percentile(latencies, 0.50) / 1000
+        << ", p90 " << percentile(latencies, 0.90) / 1000
+        << ", p99 " << percentile(latencies, 0.99) / 1000
+        << ", max " << latencies.last() / 1000 << endl;
+    if (verify)
+        out << "layout cache consistent after every step" << endl;
+    return 0;
+}
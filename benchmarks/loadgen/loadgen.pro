@@ -0,0 +1,22 @@
+#-------------------------------------------------
+#
+# Streaming load generator for the header view: large generated
+# headers, cell and header updates at a fixed rate, automated
+# scrolling and resizing, frame-time report on exit.
+# Run with -platform offscreen on machines without a display.
+#
+#-------------------------------------------------
+
+QT       += core gui widgets
+
+TARGET = loadgen
+TEMPLATE = app
+CONFIG += c++11 console
+CONFIG -= app_bundle
+
+DEFINES += QT_DEPRECATED_WARNINGS
+
+include(../../qmultiheader.pri)
+
+SOURCES += \
+        main.cpp
@@ -0,0 +1,301 @@
+#include "hierarchicalheaderview.h"
+#include "hierarchicalheadertrace.h"
+
+#include <QApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QScrollBar>
+#include <QStandardItem>
+#include <QStandardItemModel>
+#include <QTableView>
+#include <QTextStream>
+#include <QTimer>
+#include <QVector>
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+namespace {
+
+struct LoadOptions
+{
+    int leaves;
+    int depth;
+    int fanOut;
+    int rows;
+    int cellRate;    // cell updates per second
+    int headerRate;  // header title updates per second
+    int fps;
+    int seconds;
+    int scrollStep;  // pixels per frame, both directions
+    int resizeEvery; // frames between two column resizes, 0 disables
+};
+
+/**
+ * @brief The LoadTableModel class rows x leaves of numbers, serves the generated header tree
+ * through HorizontalHeaderDataRole like HierarchicalHeaderModel does
+ */
+class LoadTableModel : public QAbstractTableModel
+{
+public:
+    LoadTableModel(QStandardItemModel *header, int rows, int columns, QObject *parent = Q_NULLPTR)
+        : QAbstractTableModel(parent), m_header(header), m_rows(rows), m_columns(columns),
+          m_values(rows * columns, 0.0)
+    {
+    }
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override
+    {
+        return parent.isValid() ? 0 : m_rows;
+    }
+
+    int columnCount(const QModelIndex &parent = QModelIndex()) const override
+    {
+        return parent.isValid() ? 0 : m_columns;
+    }
+
+    QVariant data(const QModelIndex &index, int role) const override
+    {
+        if (role == HierarchicalHeaderView::HorizontalHeaderDataRole) {
+            QVariant v;
+            v.setValue(static_cast<QObject *>(m_header));
+            return v;
+        }
+        if (!index.isValid() || role != Qt::DisplayRole)
+            return QVariant();
+        return m_values.at(index.row() * m_columns + index.column());
+    }
+
+    void setValue(int row, int column, double value)
+    {
+        m_values[row * m_columns + column] = value;
+        const QModelIndex cell = index(row, column);
+        emit dataChanged(cell, cell, QVector<int>() << Qt::DisplayRole);
+    }
+
+private:
+    QStandardItemModel *m_header;
+    int m_rows;
+    int m_columns;
+    QVector<double> m_values;
+};
+
+/**
+ * @brief The HeaderShape class builds a header of `leaves` leaves, every group has up to
+ * `fanOut` children and every leaf sits `depth` levels down
+ */
+class HeaderShape
+{
+public:
+    HeaderShape(int depth, int fanOut) : m_depth(depth), m_fanOut(fanOut) {}
+
+    QStandardItemModel *build(int leaves, QVector<QStandardItem *> &items)
+    {
+        QStandardItemModel *tree = new QStandardItemModel;
+        const int chunk = capacity(0);
+        for (int first = 0; first < leaves; first += chunk)
+            tree->appendColumn({ node(0, qMin(chunk, leaves - first), first, items) });
+        return tree;
+    }
+
+private:
+    // leaves under one node of the given level
+    int capacity(int level) const
+    {
+        qint64 result = 1;
+        for (int i = level + 1; i < m_depth; ++i)
+            result = qMin<qint64>(result * m_fanOut, 1 << 30);
+        return int(result);
+    }
+
+    QStandardItem *node(int level, int leaves, int firstLeaf, QVector<QStandardItem *> &items)
+    {
+        QStandardItem *item = Q_NULLPTR;
+        if (level == m_depth - 1) {
+            item = new QStandardItem(QString("leaf %1").arg(firstLeaf));
+        } else {
+            item = new QStandardItem(QString("group %1.%2").arg(level).arg(firstLeaf));
+            const int chunk = capacity(level + 1);
+            for (int first = 0; first < leaves; first += chunk)
+                item->appendColumn({ node(level + 1, qMin(chunk, leaves - first), firstLeaf + first, items) });
+        }
+        items.append(item);
+        return item;
+    }
+
+    int m_depth;
+    int m_fanOut;
+};
+
+qint64 percentile(const QVector<qint64> &sorted, double p)
+{
+    if (sorted.isEmpty())
+        return 0;
+    const int position = qBound(0, int(p * (sorted.size() - 1) + 0.5), sorted.size() - 1);
+    return sorted.at(position);
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    QApplication a(argc, argv);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Streams cell and header updates into a large HierarchicalHeaderView "
+                                     "while scrolling and resizing, then reports frame times.");
+    parser.addHelpOption();
+    QCommandLineOption leavesOption("leaves", "Leaf columns.", "n", "2000");
+    QCommandLineOption depthOption("depth", "Header rows, leaves included.", "n", "3");
+    QCommandLineOption fanOutOption("fanout", "Children per group.", "n", "8");
+    QCommandLineOption rowsOption("rows", "Table rows.", "n", "500");
+    QCommandLineOption cellRateOption("cell-rate", "Cell updates per second.", "n", "20000");
+    QCommandLineOption headerRateOption("header-rate", "Header title updates per second.", "n", "200");
+    QCommandLineOption fpsOption("fps", "Target frame rate.", "n", "60");
+    QCommandLineOption secondsOption("seconds", "Run time.", "n", "10");
+    QCommandLineOption scrollOption("scroll-step", "Scrolled pixels per frame.", "n", "24");
+    QCommandLineOption resizeOption("resize-every", "Frames between column resizes, 0 disables.", "n", "15");
+    QCommandLineOption seedOption("seed", "Random seed.", "n", "1");
+    QCommandLineOption traceOption("trace", "Write a Chrome trace of the header phases.", "file");
+    parser.addOption(leavesOption);
+    parser.addOption(depthOption);
+    parser.addOption(fanOutOption);
+    parser.addOption(rowsOption);
+    parser.addOption(cellRateOption);
+    parser.addOption(headerRateOption);
+    parser.addOption(fpsOption);
+    parser.addOption(secondsOption);
+    parser.addOption(scrollOption);
+    parser.addOption(resizeOption);
+    parser.addOption(seedOption);
+    parser.addOption(traceOption);
+    parser.process(a);
+
+    LoadOptions options;
+    options.leaves = qMax(1, parser.value(leavesOption).toInt());
+    options.depth = qMax(1, parser.value(depthOption).toInt());
+    options.fanOut = qMax(1, parser.value(fanOutOption).toInt());
+    options.rows = qMax(1, parser.value(rowsOption).toInt());
+    options.cellRate = qMax(0, parser.value(cellRateOption).toInt());
+    options.headerRate = qMax(0, parser.value(headerRateOption).toInt());
+    options.fps = qBound(1, parser.value(fpsOption).toInt(), 1000);
+    options.seconds = qMax(1, parser.value(secondsOption).toInt());
+    options.scrollStep = parser.value(scrollOption).toInt();
+    options.resizeEvery = qMax(0, parser.value(resizeOption).toInt());
+
+    const QString traceFile = parser.value(traceOption);
+    if (!traceFile.isEmpty())
+        HierarchicalHeaderTrace::setEnabled(true);
+
+    std::mt19937 random(parser.value(seedOption).toUInt());
+
+    QVector<QStandardItem *> headerItems;
+    QStandardItemModel *headerTree = HeaderShape(options.depth, options.fanOut).build(options.leaves, headerItems);
+    LoadTableModel *tableModel = new LoadTableModel(headerTree, options.rows, options.leaves);
+    headerTree->setParent(tableModel);
+
+    QTableView table;
+    HierarchicalHeaderView *header = new HierarchicalHeaderView(Qt::Horizontal, &table);
+    header->setCanSort(true);
+    header->setGroupsCollapsible(true);
+    table.setHorizontalHeader(header);
+    table.setModel(tableModel);
+    header->setSectionsClickable(true); // setHorizontalHeader resets the clickable flag
+    table.resize(1280, 720);
+    table.show();
+
+    const double budget = 1e9 / options.fps;
+    const int frames = options.seconds * options.fps;
+    const double cellsPerFrame = double(options.cellRate) / options.fps;
+    const double headersPerFrame = double(options.headerRate) / options.fps;
+
+    QVector<qint64> frameTimes;
+    frameTimes.reserve(frames);
+    int dropped = 0;
+    int frame = 0;
+    double cellCredit = 0;
+    double headerCredit = 0;
+    qint64 cellUpdates = 0;
+    qint64 headerUpdates = 0;
+    qint64 previousStart = -1;
+    int scrollX = options.scrollStep;
+    int scrollY = options.scrollStep;
+
+    QElapsedTimer clock;
+    QTimer ticker;
+    ticker.setTimerType(Qt::PreciseTimer);
+    ticker.setInterval(qMax(1, 1000 / options.fps));
+
+    std::uniform_int_distribution<int> anyRow(0, options.rows - 1);
+    std::uniform_int_distribution<int> anyColumn(0, options.leaves - 1);
+    std::uniform_int_distribution<int> anyHeader(0, headerItems.size() - 1);
+    std::uniform_real_distribution<double> anyValue(-1e6, 1e6);
+
+    QObject::connect(&ticker, &QTimer::timeout, [&]() {
+        const qint64 start = clock.nsecsElapsed();
+        if (previousStart >= 0)
+            dropped += qMax(0, int((start - previousStart) / budget + 0.5) - 1);
+        previousStart = start;
+
+        // updates due this frame, fractional rates carry over
+        cellCredit += cellsPerFrame;
+        for (; cellCredit >= 1; cellCredit -= 1, ++cellUpdates)
+            tableModel->setValue(anyRow(random), anyColumn(random), anyValue(random));
+        headerCredit += headersPerFrame;
+        for (; headerCredit >= 1; headerCredit -= 1, ++headerUpdates) {
+            QStandardItem *item = headerItems.at(anyHeader(random));
+            item->setText(QString("%1 #%2").arg(item->text().section(" #", 0, 0)).arg(headerUpdates));
+        }
+
+        // bounce between the ends of both scroll bars
+        QScrollBar *horizontal = table.horizontalScrollBar();
+        if (horizontal->value() + scrollX > horizontal->maximum() || horizontal->value() + scrollX < 0)
+            scrollX = -scrollX;
+        horizontal->setValue(horizontal->value() + scrollX);
+        QScrollBar *vertical = table.verticalScrollBar();
+        if (vertical->value() + scrollY > vertical->maximum() || vertical->value() + scrollY < 0)
+            scrollY = -scrollY;
+        vertical->setValue(vertical->value() + scrollY);
+
+        if (options.resizeEvery > 0 && frame % options.resizeEvery == 0) {
+            const int first = header->logicalIndexAt(0);
+            const int last = header->logicalIndexAt(header->viewport()->width() - 1);
+            if (first >= 0) {
+                const int section = std::uniform_int_distribution<int>(first, last >= first ? last : first)(random);
+                header->resizeSection(section, std::uniform_int_distribution<int>(30, 220)(random));
+            }
+        }
+
+        table.repaint();
+        frameTimes.append(clock.nsecsElapsed() - start);
+
+        if (++frame >= frames)
+            a.quit();
+    });
+
+    clock.start();
+    ticker.start();
+    a.exec();
+    const qint64 elapsed = clock.nsecsElapsed();
+
+    if (!traceFile.isEmpty()) {
+        HierarchicalHeaderTrace::setEnabled(false);
+        HierarchicalHeaderTrace::dump(traceFile);
+    }
+
+    std::sort(frameTimes.begin(), frameTimes.end());
+
+    QTextStream out(stdout);
+    out << options.leaves << " leaves, depth " << options.depth << ", fan-out " << options.fanOut
+        << ", " << headerItems.size() << " header cells, " << options.rows << " rows" << endl;
+    out << frameTimes.size() << " frames in " << elapsed / 1000000 << " ms, target " << options.fps << " fps" << endl;
+    out << "updates applied: " << cellUpdates << " cells, " << headerUpdates << " header titles" << endl;
+    out << "frame time us, p50 " << percentile(frameTimes, 0.50) / 1000
+        << ", p90 " << percentile(frameTimes, 0.90) / 1000
+        << ", p99 " << percentile(frameTimes, 0.99) / 1000
+        << ", max " << (frameTimes.isEmpty() ? 0 : frameTimes.last() / 1000) << endl;
+    const int overBudget = int(frameTimes.end() - std::upper_bound(frameTimes.begin(), frameTimes.end(), qint64(budget)));
+    out << "frames over budget: " << overBudget << ", dropped frames: " << dropped << endl;
+    return 0;
+}
@@ -0,0 +1,644 @@
+#include "hierarchicalcolumnproxymodel.h"
+#include "hierarchicalheaderview.h"
+
+#include <algorithm>
+
+struct HierarchicalColumnProxyModel::HeaderNode
+{
+    HeaderNode() : parent(Q_NULLPTR), ordinal(0), firstLeaf(0), leafCount(0), visibleLeaves(0) {}
+    ~HeaderNode() { qDeleteAll(children); }
+
+    // children with at least one visible leaf, rebuilt from the leaf counts
+    void resetVisible()
+    {
+        visible.clear();
+        for (int i = 0; i < children.size(); ++i) {
+            HeaderNode *child = children.at(i);
+            if (child->visibleLeaves > 0) {
+                visible.append(child);
+                child->resetVisible();
+            } else {
+                child->visible.clear();
+            }
+        }
+    }
+
+    // position among the visible children of the parent, the node must be visible
+    int visiblePosition() const
+    {
+        const QVector<HeaderNode *> &siblings = parent->visible;
+        return int(std::lower_bound(siblings.begin(), siblings.end(), this,
+                                    [](const HeaderNode *a, const HeaderNode *b) { return a->ordinal < b->ordinal; })
+                   - siblings.begin());
+    }
+
+    QPersistentModelIndex source;
+    HeaderNode *parent;
+    int ordinal;        // position among all children of the parent
+    int firstLeaf;
+    int leafCount;
+    int visibleLeaves;
+    QVector<HeaderNode *> children;
+    QVector<HeaderNode *> visible;
+};
+
+/**
+ * @brief The HierarchicalColumnProxyModel::HeaderTree class the source header tree without the
+ * groups and leaves that have no visible column, in the row 0 / column i layout the header view reads
+ */
+class HierarchicalColumnProxyModel::HeaderTree : public QAbstractItemModel
+{
+public:
+    explicit HeaderTree(HierarchicalColumnProxyModel *proxy) : QAbstractItemModel(proxy), m_proxy(proxy) {}
+
+    using QAbstractItemModel::beginResetModel;
+    using QAbstractItemModel::endResetModel;
+
+    HeaderNode *node(const QModelIndex &index) const
+    {
+        return index.isValid() ? static_cast<HeaderNode *>(index.internalPointer()) : m_proxy->m_root;
+    }
+
+    QModelIndex indexOf(HeaderNode *node) const
+    {
+        if (node == Q_NULLPTR || node == m_proxy->m_root || node->visibleLeaves == 0)
+            return QModelIndex();
+        return createIndex(0, node->visiblePosition(), node);
+    }
+
+    // the highest ancestor left without visible leaves drops out of its parent
+    void hideLeaf(HeaderNode *leaf)
+    {
+        if (leaf->visibleLeaves == 0)
+            return;
+        HeaderNode *top = leaf;
+        while (top->parent != m_proxy->m_root && top->parent->visibleLeaves == 1)
+            top = top->parent;
+
+        const int position = top->visiblePosition();
+        beginRemoveColumns(indexOf(top->parent), position, position);
+        top->parent->visible.remove(position);
+        for (HeaderNode *node = leaf; node != top; node = node->parent)
+            node->parent->visible.clear();
+        for (HeaderNode *node = leaf; node != Q_NULLPTR; node = node->parent)
+            --node->visibleLeaves;
+        endRemoveColumns();
+    }
+
+    void showLeaf(HeaderNode *leaf)
+    {
+        if (leaf->visibleLeaves > 0)
+            return;
+        HeaderNode *top = leaf;
+        while (top->parent != m_proxy->m_root && top->parent->visibleLeaves == 0)
+            top = top->parent;
+
+        QVector<HeaderNode *> &siblings = top->parent->visible;
+        const int position = int(std::lower_bound(siblings.begin(), siblings.end(), top,
+                                                  [](const HeaderNode *a, const HeaderNode *b) { return a->ordinal < b->ordinal; })
+                                 - siblings.begin());
+        beginInsertColumns(indexOf(top->parent), position, position);
+        for (HeaderNode *node = leaf; node != top; node = node->parent)
+            node->parent->visible.append(node);
+        siblings.insert(position, top);
+        for (HeaderNode *node = leaf; node != Q_NULLPTR; node = node->parent)
+            ++node->visibleLeaves;
+        endInsertColumns();
+    }
+
+    QModelIndex index(int row, int column, const QModelIndex &parent = QModelIndex()) const override
+    {
+        HeaderNode *parentNode = node(parent);
+        if (parentNode == Q_NULLPTR || row != 0 || column < 0 || column >= parentNode->visible.size())
+            return QModelIndex();
+        return createIndex(0, column, parentNode->visible.at(column));
+    }
+
+    QModelIndex parent(const QModelIndex &child) const override
+    {
+        if (!child.isValid())
+            return QModelIndex();
+        return indexOf(node(child)->parent);
+    }
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override
+    {
+        HeaderNode *parentNode = node(parent);
+        return parentNode != Q_NULLPTR && !parentNode->visible.isEmpty() ? 1 : 0;
+    }
+
+    int columnCount(const QModelIndex &parent = QModelIndex()) const override
+    {
+        HeaderNode *parentNode = node(parent);
+        return parentNode != Q_NULLPTR ? parentNode->visible.size() : 0;
+    }
+
+    QVariant data(const QModelIndex &index, int role) const override
+    {
+        if (!index.isValid() || m_proxy->m_headerModel.isNull())
+            return QVariant();
+        return m_proxy->m_headerModel->data(node(index)->source, role);
+    }
+
+    bool setData(const QModelIndex &index, const QVariant &value, int role) override
+    {
+        if (!index.isValid() || m_proxy->m_headerModel.isNull())
+            return false;
+        return m_proxy->m_headerModel->setData(node(index)->source, value, role);
+    }
+
+    Qt::ItemFlags flags(const QModelIndex &index) const override
+    {
+        if (!index.isValid() || m_proxy->m_headerModel.isNull())
+            return Qt::NoItemFlags;
+        return m_proxy->m_headerModel->flags(node(index)->source);
+    }
+
+private:
+    HierarchicalColumnProxyModel *m_proxy;
+};
+
+HierarchicalColumnProxyModel::HierarchicalColumnProxyModel(QObject *parent) :
+    QAbstractProxyModel(parent),
+    m_headerTree(Q_NULLPTR),
+    m_root(new HeaderNode),
+    m_resetting(false)
+{
+    m_headerTree = new HeaderTree(this);
+}
+
+HierarchicalColumnProxyModel::~HierarchicalColumnProxyModel()
+{
+    delete m_root;
+}
+
+void HierarchicalColumnProxyModel::setSourceModel(QAbstractItemModel *sourceModel)
+{
+    beginResetModel();
+    m_headerTree->beginResetModel();
+    if (this->sourceModel() != Q_NULLPTR)
+        this->sourceModel()->disconnect(this);
+    QAbstractProxyModel::setSourceModel(sourceModel);
+
+    if (sourceModel != Q_NULLPTR) {
+        connect(sourceModel, SIGNAL(modelAboutToBeReset()), this, SLOT(slotSourceAboutToBeReset()));
+        connect(sourceModel, SIGNAL(modelReset()), this, SLOT(slotSourceReset()));
+        connect(sourceModel, SIGNAL(columnsAboutToBeInserted(QModelIndex, int, int)), this, SLOT(slotSourceAboutToBeReset()));
+        connect(sourceModel, SIGNAL(columnsInserted(QModelIndex, int, int)), this, SLOT(slotSourceColumnsInserted(QModelIndex, int, int)));
+        connect(sourceModel, SIGNAL(columnsAboutToBeRemoved(QModelIndex, int, int)), this, SLOT(slotSourceAboutToBeReset()));
+        connect(sourceModel, SIGNAL(columnsRemoved(QModelIndex, int, int)), this, SLOT(slotSourceColumnsRemoved(QModelIndex, int, int)));
+        connect(sourceModel, SIGNAL(columnsAboutToBeMoved(QModelIndex, int, int, QModelIndex, int)), this, SLOT(slotSourceAboutToBeReset()));
+        connect(sourceModel, SIGNAL(columnsMoved(QModelIndex, int, int, QModelIndex, int)),
+                this, SLOT(slotSourceColumnsMoved(QModelIndex, int, int, QModelIndex, int)));
+        connect(sourceModel, SIGNAL(rowsAboutToBeMoved(QModelIndex, int, int, QModelIndex, int)), this, SLOT(slotSourceAboutToBeReset()));
+        connect(sourceModel, SIGNAL(rowsMoved(QModelIndex, int, int, QModelIndex, int)), this, SLOT(slotSourceReset()));
+        connect(sourceModel, SIGNAL(dataChanged(QModelIndex, QModelIndex, QVector<int>)),
+                this, SLOT(slotSourceDataChanged(QModelIndex, QModelIndex, QVector<int>)));
+        connect(sourceModel, SIGNAL(headerDataChanged(Qt::Orientation, int, int)),
+                this, SLOT(slotSourceHeaderDataChanged(Qt::Orientation, int, int)));
+        connect(sourceModel, SIGNAL(rowsAboutToBeInserted(QModelIndex, int, int)),
+                this, SLOT(slotSourceRowsAboutToBeInserted(QModelIndex, int, int)));
+        connect(sourceModel, SIGNAL(rowsInserted(QModelIndex, int, int)), this, SLOT(slotSourceRowsInserted(QModelIndex)));
+        connect(sourceModel, SIGNAL(rowsAboutToBeRemoved(QModelIndex, int, int)),
+                this, SLOT(slotSourceRowsAboutToBeRemoved(QModelIndex, int, int)));
+        connect(sourceModel, SIGNAL(rowsRemoved(QModelIndex, int, int)), this, SLOT(slotSourceRowsRemoved(QModelIndex)));
+        connect(sourceModel, SIGNAL(layoutAboutToBeChanged()), this, SLOT(slotSourceLayoutAboutToBeChanged()));
+        connect(sourceModel, SIGNAL(layoutChanged()), this, SLOT(slotSourceLayoutChanged()));
+    }
+
+    m_hidden.clear();
+    m_collapsed.clear();
+    rebuild();
+    m_headerTree->endResetModel();
+    endResetModel();
+}
+
+void HierarchicalColumnProxyModel::setColumnHidden(int sourceColumn, bool hidden)
+{
+    if (sourceColumn < 0 || sourceColumn >= m_hidden.size() || m_hidden.at(sourceColumn) == hidden)
+        return;
+    m_hidden[sourceColumn] = hidden;
+    applyVisibility(sourceColumn, sourceColumn);
+}
+
+bool HierarchicalColumnProxyModel::isColumnHidden(int sourceColumn) const
+{
+    return sourceColumn >= 0 && sourceColumn < m_sourceToProxy.size() && m_sourceToProxy.at(sourceColumn) < 0;
+}
+
+void HierarchicalColumnProxyModel::setGroupHidden(const QModelIndex &headerIndex, bool hidden)
+{
+    const HeaderNode *node = nodeFromSource(headerIndex);
+    if (node == Q_NULLPTR)
+        return;
+    const int last = qMin(node->firstLeaf + node->leafCount, m_hidden.size()) - 1;
+    for (int column = node->firstLeaf; column <= last; ++column)
+        m_hidden[column] = hidden;
+    applyVisibility(node->firstLeaf, last);
+}
+
+void HierarchicalColumnProxyModel::setGroupCollapsed(const QModelIndex &headerIndex, bool collapsed)
+{
+    const HeaderNode *node = nodeFromSource(headerIndex);
+    if (node == Q_NULLPTR || m_collapsed.contains(node->source) == collapsed)
+        return;
+
+    if (collapsed)
+        m_collapsed.insert(node->source);
+    else
+        m_collapsed.remove(node->source);
+    collapseRange(node, collapsed ? 1 : -1);
+    applyVisibility(node->firstLeaf + 1, node->firstLeaf + node->leafCount - 1);
+}
+
+bool HierarchicalColumnProxyModel::isGroupCollapsed(const QModelIndex &headerIndex) const
+{
+    return headerIndex.isValid() && m_collapsed.contains(QPersistentModelIndex(headerIndex));
+}
+
+QModelIndex HierarchicalColumnProxyModel::mapHeaderToSource(const QModelIndex &headerIndex) const
+{
+    if (!headerIndex.isValid() || headerIndex.model() != m_headerTree)
+        return QModelIndex();
+    return m_headerTree->node(headerIndex)->source;
+}
+
+QModelIndex HierarchicalColumnProxyModel::mapHeaderFromSource(const QModelIndex &sourceHeaderIndex) const
+{
+    return m_headerTree->indexOf(nodeFromSource(sourceHeaderIndex));
+}
+
+QModelIndex HierarchicalColumnProxyModel::mapToSource(const QModelIndex &proxyIndex) const
+{
+    if (!proxyIndex.isValid() || sourceModel() == Q_NULLPTR || proxyIndex.column() >= m_proxyToSource.size())
+        return QModelIndex();
+    return sourceModel()->index(proxyIndex.row(), m_proxyToSource.at(proxyIndex.column()));
+}
+
+QModelIndex HierarchicalColumnProxyModel::mapFromSource(const QModelIndex &sourceIndex) const
+{
+    if (!sourceIndex.isValid() || sourceIndex.parent().isValid() || sourceIndex.column() >= m_sourceToProxy.size())
+        return QModelIndex();
+    const int column = m_sourceToProxy.at(sourceIndex.column());
+    return column < 0 ? QModelIndex() : createIndex(sourceIndex.row(), column);
+}
+
+QModelIndex HierarchicalColumnProxyModel::index(int row, int column, const QModelIndex &parent) const
+{
+    if (parent.isValid() || row < 0 || row >= rowCount() || column < 0 || column >= m_proxyToSource.size())
+        return QModelIndex();
+    return createIndex(row, column);
+}
+
+QModelIndex HierarchicalColumnProxyModel::parent(const QModelIndex &/*child*/) const
+{
+    return QModelIndex();
+}
+
+int HierarchicalColumnProxyModel::rowCount(const QModelIndex &parent) const
+{
+    if (parent.isValid() || sourceModel() == Q_NULLPTR)
+        return 0;
+    return sourceModel()->rowCount();
+}
+
+int HierarchicalColumnProxyModel::columnCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : m_proxyToSource.size();
+}
+
+QVariant HierarchicalColumnProxyModel::data(const QModelIndex &proxyIndex, int role) const
+{
+    if (!proxyIndex.isValid()) {
+        if (role == HierarchicalHeaderView::HorizontalHeaderDataRole) {
+            if (m_headerModel.isNull())
+                return QVariant();
+            QVariant v;
+            v.setValue(static_cast<QObject *>(m_headerTree));
+            return v;
+        }
+        return sourceModel() != Q_NULLPTR ? sourceModel()->data(QModelIndex(), role) : QVariant();
+    }
+    return QAbstractProxyModel::data(proxyIndex, role);
+}
+
+QVariant HierarchicalColumnProxyModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    if (sourceModel() == Q_NULLPTR)
+        return QVariant();
+    if (orientation == Qt::Horizontal) {
+        if (section < 0 || section >= m_proxyToSource.size())
+            return QVariant();
+        section = m_proxyToSource.at(section);
+    }
+    return sourceModel()->headerData(section, orientation, role);
+}
+
+void HierarchicalColumnProxyModel::slotSourceAboutToBeReset()
+{
+    if (m_resetting)
+        return;
+    m_resetting = true;
+    beginResetModel();
+    m_headerTree->beginResetModel();
+}
+
+void HierarchicalColumnProxyModel::slotSourceReset()
+{
+    if (!m_resetting)
+        slotSourceAboutToBeReset();
+    rebuild();
+    m_headerTree->endResetModel();
+    endResetModel();
+    m_resetting = false;
+}
+
+// the hidden flags follow their columns, rebuild() only sizes them to the new column count
+void HierarchicalColumnProxyModel::slotSourceColumnsInserted(const QModelIndex &parent, int first, int last)
+{
+    if (!parent.isValid() && first >= 0 && first <= m_hidden.size())
+        m_hidden.insert(first, last - first + 1, false);
+    slotSourceReset();
+}
+
+void HierarchicalColumnProxyModel::slotSourceColumnsRemoved(const QModelIndex &parent, int first, int last)
+{
+    if (!parent.isValid() && first >= 0 && first < m_hidden.size())
+        m_hidden.remove(first, qMin(last, m_hidden.size() - 1) - first + 1);
+    slotSourceReset();
+}
+
+void HierarchicalColumnProxyModel::slotSourceColumnsMoved(const QModelIndex &parent, int first, int last,
+                                                          const QModelIndex &destination, int column)
+{
+    // destination is the column the block is moved in front of, counted before the move
+    if (!parent.isValid() && !destination.isValid() && first >= 0 && last < m_hidden.size() && column <= m_hidden.size()) {
+        if (column < first)
+            std::rotate(m_hidden.begin() + column, m_hidden.begin() + first, m_hidden.begin() + last + 1);
+        else if (column > last + 1)
+            std::rotate(m_hidden.begin() + first, m_hidden.begin() + last + 1, m_hidden.begin() + column);
+    }
+    slotSourceReset();
+}
+
+void HierarchicalColumnProxyModel::slotSourceDataChanged(const QModelIndex &topLeft, const QModelIndex &bottomRight, const QVector<int> &roles)
+{
+    if (m_resetting || topLeft.parent().isValid())
+        return;
+    const int first = int(std::lower_bound(m_proxyToSource.begin(), m_proxyToSource.end(), topLeft.column()) - m_proxyToSource.begin());
+    const int last = int(std::upper_bound(m_proxyToSource.begin(), m_proxyToSource.end(), bottomRight.column()) - m_proxyToSource.begin()) - 1;
+    if (first <= last)
+        emit dataChanged(index(topLeft.row(), first), index(bottomRight.row(), last), roles);
+}
+
+void HierarchicalColumnProxyModel::slotSourceHeaderDataChanged(Qt::Orientation orientation, int first, int last)
+{
+    if (m_resetting)
+        return;
+    if (orientation == Qt::Horizontal) {
+        const int proxyFirst = int(std::lower_bound(m_proxyToSource.begin(), m_proxyToSource.end(), first) - m_proxyToSource.begin());
+        const int proxyLast = int(std::upper_bound(m_proxyToSource.begin(), m_proxyToSource.end(), last) - m_proxyToSource.begin()) - 1;
+        if (proxyFirst <= proxyLast)
+            emit headerDataChanged(orientation, proxyFirst, proxyLast);
+    } else {
+        emit headerDataChanged(orientation, first, last);
+    }
+}
+
+void HierarchicalColumnProxyModel::slotSourceRowsAboutToBeInserted(const QModelIndex &parent, int first, int last)
+{
+    if (!parent.isValid())
+        beginInsertRows(QModelIndex(), first, last);
+}
+
+void HierarchicalColumnProxyModel::slotSourceRowsInserted(const QModelIndex &parent)
+{
+    if (!parent.isValid())
+        endInsertRows();
+}
+
+void HierarchicalColumnProxyModel::slotSourceRowsAboutToBeRemoved(const QModelIndex &parent, int first, int last)
+{
+    if (!parent.isValid())
+        beginRemoveRows(QModelIndex(), first, last);
+}
+
+void HierarchicalColumnProxyModel::slotSourceRowsRemoved(const QModelIndex &parent)
+{
+    if (!parent.isValid())
+        endRemoveRows();
+}
+
+// row sorting keeps the columns, only the persistent indexes move
+void HierarchicalColumnProxyModel::slotSourceLayoutAboutToBeChanged()
+{
+    emit layoutAboutToBeChanged();
+    m_layoutProxy = persistentIndexList();
+    m_layoutSource.clear();
+    for (int i = 0; i < m_layoutProxy.size(); ++i)
+        m_layoutSource.append(QPersistentModelIndex(mapToSource(m_layoutProxy.at(i))));
+}
+
+void HierarchicalColumnProxyModel::slotSourceLayoutChanged()
+{
+    QModelIndexList moved;
+    for (int i = 0; i < m_layoutSource.size(); ++i)
+        moved.append(mapFromSource(m_layoutSource.at(i)));
+    changePersistentIndexList(m_layoutProxy, moved);
+    m_layoutProxy.clear();
+    m_layoutSource.clear();
+    emit layoutChanged();
+}
+
+void HierarchicalColumnProxyModel::slotHeaderDataChanged(const QModelIndex &topLeft, const QModelIndex &bottomRight, const QVector<int> &roles)
+{
+    if (m_resetting || !topLeft.isValid())
+        return;
+    for (int column = topLeft.column(); column <= bottomRight.column(); ++column) {
+        const QModelIndex &index = m_headerTree->indexOf(nodeFromSource(topLeft.sibling(topLeft.row(), column)));
+        if (index.isValid())
+            emit m_headerTree->dataChanged(index, index, roles);
+    }
+}
+
+void HierarchicalColumnProxyModel::slotHeaderStructureChanged()
+{
+    if (m_resetting)
+        return;
+    slotSourceAboutToBeReset();
+    slotSourceReset();
+}
+
+/**
+ * @brief HierarchicalColumnProxyModel::rebuild header nodes and remap arrays from scratch,
+ * only after a reset or a structural change of the source or of its header tree
+ */
+void HierarchicalColumnProxyModel::rebuild()
+{
+    QAbstractItemModel *headerModel = Q_NULLPTR;
+    if (sourceModel() != Q_NULLPTR) {
+        const QVariant &v = sourceModel()->data(QModelIndex(), HierarchicalHeaderView::HorizontalHeaderDataRole);
+        if (v.isValid())
+            headerModel = qobject_cast<QAbstractItemModel *>(v.value<QObject *>());
+    }
+    if (headerModel != m_headerModel.data()) {
+        if (!m_headerModel.isNull())
+            m_headerModel->disconnect(this);
+        m_headerModel = headerModel;
+        if (headerModel != Q_NULLPTR) {
+            connect(headerModel, SIGNAL(modelReset()), this, SLOT(slotHeaderStructureChanged()));
+            connect(headerModel, SIGNAL(layoutChanged()), this, SLOT(slotHeaderStructureChanged()));
+            connect(headerModel, SIGNAL(columnsInserted(QModelIndex, int, int)), this, SLOT(slotHeaderStructureChanged()));
+            connect(headerModel, SIGNAL(columnsRemoved(QModelIndex, int, int)), this, SLOT(slotHeaderStructureChanged()));
+            connect(headerModel, SIGNAL(columnsMoved(QModelIndex, int, int, QModelIndex, int)), this, SLOT(slotHeaderStructureChanged()));
+            connect(headerModel, SIGNAL(rowsRemoved(QModelIndex, int, int)), this, SLOT(slotHeaderStructureChanged()));
+            connect(headerModel, SIGNAL(dataChanged(QModelIndex, QModelIndex, QVector<int>)),
+                    this, SLOT(slotHeaderDataChanged(QModelIndex, QModelIndex, QVector<int>)));
+        }
+    }
+
+    delete m_root;
+    m_root = new HeaderNode;
+    m_leaves.clear();
+    if (!m_headerModel.isNull())
+        buildNodes(m_root, QModelIndex());
+
+    const int columns = sourceModel() != Q_NULLPTR ? sourceModel()->columnCount() : 0;
+    m_hidden.resize(columns);
+    m_collapsedAway.fill(0, columns);
+    for (QSet<QPersistentModelIndex>::iterator it = m_collapsed.begin(); it != m_collapsed.end();) {
+        const HeaderNode *node = nodeFromSource(*it);
+        if (node == Q_NULLPTR) {
+            it = m_collapsed.erase(it);
+        } else {
+            collapseRange(node, 1);
+            ++it;
+        }
+    }
+
+    m_proxyToSource.clear();
+    m_sourceToProxy.fill(-1, columns);
+    for (int column = 0; column < columns; ++column) {
+        if (!wantsVisible(column))
+            continue;
+        m_sourceToProxy[column] = m_proxyToSource.size();
+        m_proxyToSource.append(column);
+        if (column < m_leaves.size()) {
+            for (HeaderNode *node = m_leaves.at(column); node != Q_NULLPTR; node = node->parent)
+                ++node->visibleLeaves;
+        }
+    }
+    m_root->resetVisible();
+}
+
+void HierarchicalColumnProxyModel::buildNodes(HeaderNode *parent, const QModelIndex &parentIndex)
+{
+    const int count = m_headerModel->columnCount(parentIndex);
+    parent->children.reserve(count);
+    for (int i = 0; i < count; ++i) {
+        HeaderNode *node = new HeaderNode;
+        node->source = m_headerModel->index(0, i, parentIndex);
+        node->parent = parent;
+        node->ordinal = i;
+        node->firstLeaf = m_leaves.size();
+        parent->children.append(node);
+
+        if (m_headerModel->columnCount(node->source) == 0) {
+            m_leaves.append(node);
+            node->leafCount = 1;
+        } else {
+            buildNodes(node, node->source);
+            node->leafCount = m_leaves.size() - node->firstLeaf;
+        }
+    }
+}
+
+HierarchicalColumnProxyModel::HeaderNode *HierarchicalColumnProxyModel::nodeFromSource(const QModelIndex &sourceHeaderIndex) const
+{
+    if (!sourceHeaderIndex.isValid() || sourceHeaderIndex.model() != m_headerModel.data())
+        return Q_NULLPTR;
+
+    QVector<int> path;
+    for (QModelIndex index = sourceHeaderIndex; index.isValid(); index = index.parent())
+        path.append(index.column());
+
+    HeaderNode *node = m_root;
+    for (int i = path.size() - 1; i >= 0; --i) {
+        if (path.at(i) >= node->children.size())
+            return Q_NULLPTR;
+        node = node->children.at(path.at(i));
+    }
+    return node;
+}
+
+void HierarchicalColumnProxyModel::collapseRange(const HeaderNode *node, int delta)
+{
+    const int last = qMin(node->firstLeaf + node->leafCount, m_collapsedAway.size()) - 1;
+    for (int column = node->firstLeaf + 1; column <= last; ++column)
+        m_collapsedAway[column] += delta;
+}
+
+bool HierarchicalColumnProxyModel::wantsVisible(int sourceColumn) const
+{
+    return !m_hidden.at(sourceColumn) && m_collapsedAway.at(sourceColumn) == 0;
+}
+
+/**
+ * @brief HierarchicalColumnProxyModel::applyVisibility bring the columns of [first, last] to their
+ * wanted visibility, one column insertion or removal per run of changed columns
+ */
+void HierarchicalColumnProxyModel::applyVisibility(int first, int last)
+{
+    first = qMax(first, 0);
+    last = qMin(last, m_sourceToProxy.size() - 1);
+
+    // back to front, the proxy positions in front of a run stay valid
+    int column = last;
+    while (column >= first) {
+        const bool visible = m_sourceToProxy.at(column) >= 0;
+        if (visible == wantsVisible(column)) {
+            --column;
+            continue;
+        }
+        const int runLast = column;
+        while (column >= first && (m_sourceToProxy.at(column) >= 0) == visible && wantsVisible(column) != visible)
+            --column;
+        if (visible)
+            hideColumns(column + 1, runLast);
+        else
+            showColumns(column + 1, runLast);
+    }
+}
+
+void HierarchicalColumnProxyModel::hideColumns(int first, int last)
+{
+    // the header tree first, a header view then sees leaves and sections agree after the removal
+    for (int column = first; column <= last && column < m_leaves.size(); ++column)
+        m_headerTree->hideLeaf(m_leaves.at(column));
+
+    const int proxyFirst = m_sourceToProxy.at(first);
+    const int count = last - first + 1;
+    beginRemoveColumns(QModelIndex(), proxyFirst, proxyFirst + count - 1);
+    m_proxyToSource.remove(proxyFirst, count);
+    for (int column = first; column <= last; ++column)
+        m_sourceToProxy[column] = -1;
+    for (int position = proxyFirst; position < m_proxyToSource.size(); ++position)
+        m_sourceToProxy[m_proxyToSource.at(position)] = position;
+    endRemoveColumns();
+}
+
+void HierarchicalColumnProxyModel::showColumns(int first, int last)
+{
+    for (int column = first; column <= last && column < m_leaves.size(); ++column)
+        m_headerTree->showLeaf(m_leaves.at(column));
+
+    const int proxyFirst = int(std::lower_bound(m_proxyToSource.begin(), m_proxyToSource.end(), first) - m_proxyToSource.begin());
+    const int count = last - first + 1;
+    beginInsertColumns(QModelIndex(), proxyFirst, proxyFirst + count - 1);
+    m_proxyToSource.insert(proxyFirst, count, 0);
+    for (int i = 0; i < count; ++i)
+        m_proxyToSource[proxyFirst + i] = first + i;
+    for (int position = proxyFirst; position < m_proxyToSource.size(); ++position)
+        m_sourceToProxy[m_proxyToSource.at(position)] = position;
+    endInsertColumns();
+}
@@ -0,0 +1,97 @@
+#ifndef HIERARCHICAL_COLUMN_PROXY_MODEL_H
+#define HIERARCHICAL_COLUMN_PROXY_MODEL_H
+
+#include <QAbstractProxyModel>
+#include <QPersistentModelIndex>
+#include <QPointer>
+#include <QSet>
+#include <QVector>
+
+/**
+ * @brief The HierarchicalColumnProxyModel class exposes only the visible leaf columns of a table
+ * model whose columns are the leaves of a header tree (served through HorizontalHeaderDataRole).
+ * Hidden columns and the leaves of collapsed groups are not columns of the proxy at all, the
+ * attached view never lays them out nor asks for their data. The header tree handed on to a
+ * HierarchicalHeaderView is filtered the same way.
+ * Columns are mapped in O(1) through two remap arrays; showing or hiding columns updates them
+ * and emits column insertions and removals for the changed runs only. Flat table models only.
+ */
+class HierarchicalColumnProxyModel : public QAbstractProxyModel
+{
+    Q_OBJECT
+public:
+    explicit HierarchicalColumnProxyModel(QObject *parent = Q_NULLPTR);
+    ~HierarchicalColumnProxyModel();
+
+    void setSourceModel(QAbstractItemModel *sourceModel) override;
+
+    void setColumnHidden(int sourceColumn, bool hidden);
+    bool isColumnHidden(int sourceColumn) const;
+
+    // header indexes below are indexes of the source header tree
+    void setGroupHidden(const QModelIndex &headerIndex, bool hidden);
+    // like HierarchicalHeaderView, a collapsed group keeps its first leaf
+    void setGroupCollapsed(const QModelIndex &headerIndex, bool collapsed);
+    bool isGroupCollapsed(const QModelIndex &headerIndex) const;
+
+    // between the filtered header tree served by the proxy and the source header tree
+    QModelIndex mapHeaderToSource(const QModelIndex &headerIndex) const;
+    QModelIndex mapHeaderFromSource(const QModelIndex &sourceHeaderIndex) const;
+
+    QModelIndex mapToSource(const QModelIndex &proxyIndex) const override;
+    QModelIndex mapFromSource(const QModelIndex &sourceIndex) const override;
+
+    QModelIndex index(int row, int column, const QModelIndex &parent = QModelIndex()) const override;
+    QModelIndex parent(const QModelIndex &child) const override;
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &proxyIndex, int role = Qt::DisplayRole) const override;
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+
+private slots:
+    void slotSourceAboutToBeReset();
+    void slotSourceReset();
+    void slotSourceColumnsInserted(const QModelIndex &parent, int first, int last);
+    void slotSourceColumnsRemoved(const QModelIndex &parent, int first, int last);
+    void slotSourceColumnsMoved(const QModelIndex &parent, int first, int last, const QModelIndex &destination, int column);
+    void slotSourceDataChanged(const QModelIndex &topLeft, const QModelIndex &bottomRight, const QVector<int> &roles);
+    void slotSourceHeaderDataChanged(Qt::Orientation orientation, int first, int last);
+    void slotSourceRowsAboutToBeInserted(const QModelIndex &parent, int first, int last);
+    void slotSourceRowsInserted(const QModelIndex &parent);
+    void slotSourceRowsAboutToBeRemoved(const QModelIndex &parent, int first, int last);
+    void slotSourceRowsRemoved(const QModelIndex &parent);
+    void slotSourceLayoutAboutToBeChanged();
+    void slotSourceLayoutChanged();
+    void slotHeaderDataChanged(const QModelIndex &topLeft, const QModelIndex &bottomRight, const QVector<int> &roles);
+    void slotHeaderStructureChanged();
+
+private:
+    class HeaderTree;
+    struct HeaderNode;
+
+    void rebuild();
+    void buildNodes(HeaderNode *parent, const QModelIndex &parentIndex);
+    HeaderNode *nodeFromSource(const QModelIndex &sourceHeaderIndex) const;
+    void collapseRange(const HeaderNode *node, int delta);
+    void applyVisibility(int first, int last);
+    void hideColumns(int first, int last);
+    void showColumns(int first, int last);
+    bool wantsVisible(int sourceColumn) const;
+
+    QPointer<QAbstractItemModel> m_headerModel; // source header tree
+    HeaderTree *m_headerTree;                   // filtered header tree
+    HeaderNode *m_root;
+    QVector<HeaderNode *> m_leaves;             // by source column
+
+    QVector<int> m_proxyToSource;
+    QVector<int> m_sourceToProxy;               // -1 when hidden
+    QVector<bool> m_hidden;
+    QVector<int> m_collapsedAway;               // collapsed groups hiding the column
+    QSet<QPersistentModelIndex> m_collapsed;
+
+    QList<QPersistentModelIndex> m_layoutSource;
+    QModelIndexList m_layoutProxy;
+    bool m_resetting;
+};
+
+#endif // HIERARCHICAL_COLUMN_PROXY_MODEL_H
@@ -0,0 +1,268 @@
+#include "hierarchicalheaderaggregates.h"
+#include <limits>
+#include <qnumeric.h>
+
+static const double Infinity = std::numeric_limits<double>::infinity();
+
+/**
+ * @brief scanValues bulk pass over one column. Four independent accumulators and no branches
+ * (NaN fails every comparison) let the compiler vectorize the loop.
+ */
+static HierarchicalHeaderAggregates::Aggregate scanValues(const double *values, int count)
+{
+    double sum[4] = { 0.0, 0.0, 0.0, 0.0 };
+    double low[4] = { Infinity, Infinity, Infinity, Infinity };
+    double high[4] = { -Infinity, -Infinity, -Infinity, -Infinity };
+    qint64 valid[4] = { 0, 0, 0, 0 };
+
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        for (int k = 0; k < 4; ++k) {
+            const double v = values[i + k];
+            const bool ok = v == v;
+            sum[k] += ok ? v : 0.0;
+            low[k] = v < low[k] ? v : low[k];
+            high[k] = v > high[k] ? v : high[k];
+            valid[k] += ok ? 1 : 0;
+        }
+    }
+    for (; i < count; ++i) {
+        const double v = values[i];
+        const bool ok = v == v;
+        sum[0] += ok ? v : 0.0;
+        low[0] = v < low[0] ? v : low[0];
+        high[0] = v > high[0] ? v : high[0];
+        valid[0] += ok ? 1 : 0;
+    }
+
+    HierarchicalHeaderAggregates::Aggregate result;
+    result.sum = (sum[0] + sum[1]) + (sum[2] + sum[3]);
+    result.compensation = 0.0;
+    result.min = qMin(qMin(low[0], low[1]), qMin(low[2], low[3]));
+    result.max = qMax(qMax(high[0], high[1]), qMax(high[2], high[3]));
+    result.count = valid[0] + valid[1] + valid[2] + valid[3];
+    return result;
+}
+
+double HierarchicalHeaderAggregates::Aggregate::mean() const
+{
+    return count > 0 ? (sum + compensation) / count : qQNaN();
+}
+
+/**
+ * @brief Aggregate::add Neumaier summation: the rounding error of every addition is collected in
+ * compensation, so sum + compensation does not drift however many values come and go.
+ */
+void HierarchicalHeaderAggregates::Aggregate::add(double value)
+{
+    const double total = sum + value;
+    if (qAbs(sum) >= qAbs(value))
+        compensation += (sum - total) + value;
+    else
+        compensation += (value - total) + sum;
+    sum = total;
+}
+
+void HierarchicalHeaderAggregates::Aggregate::combine(const Aggregate &other)
+{
+    add(other.sum);
+    compensation += other.compensation;
+    min = qMin(min, other.min);
+    max = qMax(max, other.max);
+    count += other.count;
+}
+
+HierarchicalHeaderAggregates::Aggregate HierarchicalHeaderAggregates::Aggregate::empty()
+{
+    Aggregate result;
+    result.sum = 0.0;
+    result.compensation = 0.0;
+    result.min = Infinity;
+    result.max = -Infinity;
+    result.count = 0;
+    return result;
+}
+
+HierarchicalHeaderAggregates::HierarchicalHeaderAggregates(QObject *parent) :
+    QObject(parent),
+    m_role(Qt::DisplayRole),
+    m_revision(0)
+{
+}
+
+void HierarchicalHeaderAggregates::setSourceModel(QAbstractItemModel *model, int role)
+{
+    if (!m_model.isNull())
+        m_model->disconnect(this);
+    m_model = model;
+    m_role = role;
+    if (!m_model.isNull()) {
+        connect(model, SIGNAL(modelReset()), this, SLOT(slotReset()));
+        connect(model, SIGNAL(layoutChanged()), this, SLOT(slotReset()));
+        connect(model, SIGNAL(columnsInserted(QModelIndex, int, int)), this, SLOT(slotReset()));
+        connect(model, SIGNAL(columnsRemoved(QModelIndex, int, int)), this, SLOT(slotReset()));
+        connect(model, SIGNAL(columnsMoved(QModelIndex, int, int, QModelIndex, int)), this, SLOT(slotReset()));
+        connect(model, SIGNAL(rowsMoved(QModelIndex, int, int, QModelIndex, int)), this, SLOT(slotReset()));
+        connect(model, SIGNAL(dataChanged(QModelIndex, QModelIndex, QVector<int>)),
+                this, SLOT(slotDataChanged(QModelIndex, QModelIndex, QVector<int>)));
+        connect(model, SIGNAL(rowsInserted(QModelIndex, int, int)), this, SLOT(slotRowsInserted(QModelIndex, int, int)));
+        connect(model, SIGNAL(rowsAboutToBeRemoved(QModelIndex, int, int)),
+                this, SLOT(slotRowsAboutToBeRemoved(QModelIndex, int, int)));
+    }
+    slotReset();
+}
+
+QAbstractItemModel *HierarchicalHeaderAggregates::sourceModel() const
+{
+    return m_model.data();
+}
+
+int HierarchicalHeaderAggregates::columnCount() const
+{
+    return m_aggregates.size();
+}
+
+HierarchicalHeaderAggregates::Aggregate HierarchicalHeaderAggregates::aggregate(int column) const
+{
+    if (column < 0 || column >= m_aggregates.size())
+        return Aggregate::empty();
+
+    // the rescan also starts the sum afresh from the stored values
+    if (m_extremesDirty.testBit(column)) {
+        m_aggregates[column] = scanValues(m_values.at(column).constData(), m_values.at(column).size());
+        m_extremesDirty.clearBit(column);
+    }
+    Aggregate result = m_aggregates.at(column);
+    result.sum += result.compensation;
+    result.compensation = 0.0;
+    return result;
+}
+
+quint64 HierarchicalHeaderAggregates::revision() const
+{
+    return m_revision;
+}
+
+double HierarchicalHeaderAggregates::value(int row, int column) const
+{
+    bool ok = false;
+    const double result = m_model->index(row, column).data(m_role).toDouble(&ok);
+    return ok ? result : qQNaN();
+}
+
+void HierarchicalHeaderAggregates::changed()
+{
+    ++m_revision;
+    emit signalAggregatesChanged();
+}
+
+void HierarchicalHeaderAggregates::slotReset()
+{
+    m_values.clear();
+    m_aggregates.clear();
+    m_extremesDirty.clear();
+    if (!m_model.isNull()) {
+        const int rows = m_model->rowCount();
+        const int columns = m_model->columnCount();
+        m_values.resize(columns);
+        m_aggregates.resize(columns);
+        m_extremesDirty.resize(columns);
+        for (int column = 0; column < columns; ++column) {
+            QVector<double> &values = m_values[column];
+            values.resize(rows);
+            for (int row = 0; row < rows; ++row)
+                values[row] = value(row, column);
+            m_aggregates[column] = scanValues(values.constData(), rows);
+        }
+    }
+    changed();
+}
+
+// false when the stored aggregate of column is left as it was
+bool HierarchicalHeaderAggregates::applyChange(int column, double oldValue, double newValue)
+{
+    if (oldValue == newValue || (qIsNaN(oldValue) && qIsNaN(newValue)))
+        return false;
+    Aggregate &aggregate = m_aggregates[column];
+    bool dirty = m_extremesDirty.testBit(column);
+    if (!qIsNaN(oldValue)) {
+        aggregate.add(-oldValue);
+        --aggregate.count;
+        // the extreme may be gone, find it again when it is read
+        if (!dirty && (oldValue <= aggregate.min || oldValue >= aggregate.max)) {
+            dirty = true;
+            m_extremesDirty.setBit(column);
+        }
+    }
+    if (!qIsNaN(newValue)) {
+        aggregate.add(newValue);
+        ++aggregate.count;
+        if (!dirty) {
+            aggregate.min = qMin(aggregate.min, newValue);
+            aggregate.max = qMax(aggregate.max, newValue);
+        }
+    }
+    return true;
+}
+
+void HierarchicalHeaderAggregates::slotDataChanged(const QModelIndex &topLeft, const QModelIndex &bottomRight,
+                                                   const QVector<int> &roles)
+{
+    if (topLeft.parent().isValid() || (!roles.isEmpty() && !roles.contains(m_role)))
+        return;
+
+    // high rate updates that leave the aggregates alone must not repaint the header
+    bool modified = false;
+    const int lastColumn = qMin(bottomRight.column(), m_values.size() - 1);
+    for (int column = topLeft.column(); column <= lastColumn; ++column) {
+        QVector<double> &values = m_values[column];
+        const int lastRow = qMin(bottomRight.row(), values.size() - 1);
+        for (int row = topLeft.row(); row <= lastRow; ++row) {
+            const double newValue = value(row, column);
+            const double oldValue = values.at(row);
+            if (newValue == oldValue || (qIsNaN(newValue) && qIsNaN(oldValue)))
+                continue;
+            values[row] = newValue;
+            modified |= applyChange(column, oldValue, newValue);
+        }
+    }
+    if (modified)
+        changed();
+}
+
+void HierarchicalHeaderAggregates::slotRowsInserted(const QModelIndex &parent, int first, int last)
+{
+    if (parent.isValid())
+        return;
+
+    bool modified = false;
+    const int count = last - first + 1;
+    for (int column = 0; column < m_values.size(); ++column) {
+        QVector<double> &values = m_values[column];
+        values.insert(first, count, qQNaN());
+        for (int row = first; row <= last; ++row) {
+            values[row] = value(row, column);
+            modified |= applyChange(column, qQNaN(), values.at(row));
+        }
+    }
+    if (modified)
+        changed();
+}
+
+void HierarchicalHeaderAggregates::slotRowsAboutToBeRemoved(const QModelIndex &parent, int first, int last)
+{
+    if (parent.isValid())
+        return;
+
+    bool modified = false;
+    for (int column = 0; column < m_values.size(); ++column) {
+        QVector<double> &values = m_values[column];
+        const int end = qMin(last, values.size() - 1);
+        for (int row = first; row <= end; ++row)
+            modified |= applyChange(column, values.at(row), qQNaN());
+        if (end >= first)
+            values.remove(first, end - first + 1);
+    }
+    if (modified)
+        changed();
+}
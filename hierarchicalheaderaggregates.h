@@ -0,0 +1,67 @@
+#ifndef HIERARCHICAL_HEADER_AGGREGATES_H
+#define HIERARCHICAL_HEADER_AGGREGATES_H
+
+#include <QObject>
+#include <QPointer>
+#include <QAbstractItemModel>
+#include <QBitArray>
+#include <QVector>
+
+/**
+ * @brief The HierarchicalHeaderAggregates class sum, min, max and mean of every column of a table
+ * model, kept up to date from dataChanged / rowsInserted / rowsRemoved without rescanning rows.
+ * A column major copy of the values gives the old value of a changed cell; min and max are only
+ * rescanned when the current extreme itself changes, and then lazily on the next read. The sum is
+ * kept with compensated summation so a long stream of changes does not drift from the column total.
+ */
+class HierarchicalHeaderAggregates : public QObject
+{
+    Q_OBJECT
+public:
+    struct Aggregate
+    {
+        double sum;
+        double compensation;   // low order bits lost from sum, see add()
+        double min;
+        double max;
+        qint64 count;   // numeric cells
+
+        double mean() const;
+        void add(double value);
+        void combine(const Aggregate &other);
+        static Aggregate empty();
+    };
+
+    explicit HierarchicalHeaderAggregates(QObject *parent = Q_NULLPTR);
+
+    void setSourceModel(QAbstractItemModel *model, int role = Qt::DisplayRole);
+    QAbstractItemModel *sourceModel() const;
+
+    int columnCount() const;
+    Aggregate aggregate(int column) const;
+    // bumped whenever an aggregate may have changed
+    quint64 revision() const;
+
+signals:
+    void signalAggregatesChanged();
+
+private slots:
+    void slotReset();
+    void slotDataChanged(const QModelIndex &topLeft, const QModelIndex &bottomRight, const QVector<int> &roles);
+    void slotRowsInserted(const QModelIndex &parent, int first, int last);
+    void slotRowsAboutToBeRemoved(const QModelIndex &parent, int first, int last);
+
+private:
+    double value(int row, int column) const;
+    bool applyChange(int column, double oldValue, double newValue);
+    void changed();
+
+    QPointer<QAbstractItemModel> m_model;
+    int m_role;
+    QVector<QVector<double> > m_values;   // NaN for cells that are not numeric
+    mutable QVector<Aggregate> m_aggregates;
+    mutable QBitArray m_extremesDirty;
+    quint64 m_revision;
+};
+
+#endif // HIERARCHICAL_HEADER_AGGREGATES_H
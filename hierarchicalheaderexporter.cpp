@@ -0,0 +1,629 @@
+#include "hierarchicalheaderexporter.h"
+#include "hierarchicalheadertrace.h"
+#include "hierarchicalheaderview.h"
+
+#include <QBitArray>
+#include <QSaveFile>
+#include <QThread>
+#include <algorithm>
+
+namespace {
+
+// the writer hands the buffer to the file once it grows past this
+const int WriteBufferSize = 1 << 20;
+
+bool isNumeric(const QVariant &value)
+{
+    switch (int(value.type())) {
+    case QVariant::Int:
+    case QVariant::UInt:
+    case QVariant::LongLong:
+    case QVariant::ULongLong:
+    case QVariant::Double:
+    case QMetaType::Float:
+        return true;
+    default:
+        return false;
+    }
+}
+
+bool cellLessThan(const HierarchicalHeaderExporter::HeaderCell &a, const HierarchicalHeaderExporter::HeaderCell &b)
+{
+    return a.row != b.row ? a.row < b.row : a.column < b.column;
+}
+
+// returns the leaf count below parent, cells get their rows from depth
+int collectCells(const QAbstractItemModel *tree, const QModelIndex &parent, int depth, int firstLeaf,
+                 QVector<HierarchicalHeaderExporter::HeaderCell> &cells, QVector<int> &leafCells, int &depthCount)
+{
+    int leaves = 0;
+    for (int i = 0; i < tree->columnCount(parent); ++i) {
+        const QModelIndex &index = tree->index(0, i, parent);
+        const int cell = cells.size();
+        HierarchicalHeaderExporter::HeaderCell headerCell = { index.data().toString(), depth, firstLeaf + leaves, 1, 1 };
+        cells.append(headerCell);
+
+        int span = 1;
+        if (tree->columnCount(index) > 0)
+            span = qMax(1, collectCells(tree, index, depth + 1, firstLeaf + leaves, cells, leafCells, depthCount));
+        else
+            leafCells.append(cell);
+        cells[cell].columnSpan = span;
+        leaves += span;
+        depthCount = qMax(depthCount, depth + 1);
+    }
+    return leaves;
+}
+
+} // namespace
+
+struct HierarchicalHeaderExporter::Chunk
+{
+    int rows;
+    int columns;
+    QVector<QString> cells; // row major
+    QBitArray numeric;
+};
+
+/**
+ * @brief The HierarchicalHeaderExporter::Writer class lives on the export thread and owns the
+ * file; every call comes in as a queued call from the exporter, in order
+ */
+class HierarchicalHeaderExporter::Writer : public QObject
+{
+public:
+    Writer(Format format, SpanMode spanMode, const QAtomicInt *cancelled) :
+        m_file(new QSaveFile(this)),
+        m_format(format),
+        m_spanMode(spanMode),
+        m_cancelled(cancelled),
+        m_fields(0),
+        m_failed(false)
+    {
+        m_buffer.reserve(WriteBufferSize + (WriteBufferSize >> 2));
+    }
+
+    bool open(const QString &fileName, const QVector<HeaderCell> &cells, int headerRows, int columns)
+    {
+        HIERARCHICAL_HEADER_TRACE("exportOpen");
+        m_file->setFileName(fileName);
+        if (!m_file->open(QIODevice::WriteOnly)) {
+            m_failed = true;
+            return false;
+        }
+
+        if (m_format == SpreadsheetXml) {
+            m_buffer += "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+                        "<?mso-application progid=\"Excel.Sheet\"?>\n"
+                        "<Workbook xmlns=\"urn:schemas-microsoft-com:office:spreadsheet\""
+                        " xmlns:ss=\"urn:schemas-microsoft-com:office:spreadsheet\">\n"
+                        "<Styles><Style ss:ID=\"header\"><Alignment ss:Horizontal=\"Center\" ss:Vertical=\"Center\"/>"
+                        "<Font ss:Bold=\"1\"/></Style></Styles>\n"
+                        "<Worksheet ss:Name=\"Sheet1\"><Table>\n";
+        }
+
+        if (m_format == SpreadsheetXml && m_spanMode == MergedSpans) {
+            // covered cells are left out, every written cell says where it is
+            QVector<HeaderCell> sorted(cells);
+            std::sort(sorted.begin(), sorted.end(), cellLessThan);
+            int cell = 0;
+            for (int row = 0; row < headerRows; ++row) {
+                beginRow();
+                for (; cell < sorted.size() && sorted.at(cell).row == row; ++cell) {
+                    const HeaderCell &headerCell = sorted.at(cell);
+                    appendXmlCell(headerCell.title, false, true, headerCell.column + 1,
+                                  headerCell.columnSpan - 1, headerCell.rowSpan - 1);
+                }
+                endRow();
+            }
+        } else {
+            QVector<QString> grid(headerRows * columns);
+            for (int i = 0; i < cells.size(); ++i) {
+                const HeaderCell &headerCell = cells.at(i);
+                const int rowEnd = m_spanMode == MergedSpans ? headerCell.row + 1 : headerCell.row + headerCell.rowSpan;
+                const int columnEnd = m_spanMode == MergedSpans ? headerCell.column + 1 : headerCell.column + headerCell.columnSpan;
+                for (int row = headerCell.row; row < rowEnd; ++row) {
+                    for (int column = headerCell.column; column < columnEnd; ++column)
+                        grid[row * columns + column] = headerCell.title;
+                }
+            }
+            for (int row = 0; row < headerRows; ++row) {
+                beginRow();
+                for (int column = 0; column < columns; ++column) {
+                    if (m_format == SpreadsheetXml)
+                        appendXmlCell(grid.at(row * columns + column), false, true);
+                    else
+                        appendField(grid.at(row * columns + column));
+                }
+                endRow();
+            }
+        }
+        return flush(false);
+    }
+
+    bool write(const Chunk &chunk)
+    {
+        if (m_failed || m_cancelled->loadAcquire() != 0)
+            return !m_failed;
+
+        HIERARCHICAL_HEADER_TRACE("exportChunk");
+        for (int row = 0; row < chunk.rows; ++row) {
+            beginRow();
+            for (int column = 0; column < chunk.columns; ++column) {
+                const int cell = row * chunk.columns + column;
+                if (m_format == SpreadsheetXml)
+                    appendXmlCell(chunk.cells.at(cell), chunk.numeric.testBit(cell));
+                else
+                    appendField(chunk.cells.at(cell));
+            }
+            endRow();
+            if (!flush(false))
+                return false;
+        }
+        return true;
+    }
+
+    bool close(bool commit)
+    {
+        HIERARCHICAL_HEADER_TRACE("exportClose");
+        if (commit && !m_failed) {
+            if (m_format == SpreadsheetXml)
+                m_buffer += "</Table></Worksheet>\n</Workbook>\n";
+            if (flush(true) && m_file->commit())
+                return true;
+            m_failed = true;
+            return false;
+        }
+        m_buffer.clear();
+        m_file->cancelWriting();
+        if (m_file->isOpen())
+            m_file->commit();
+        return false;
+    }
+
+    QString errorString() const
+    {
+        return m_file->errorString();
+    }
+
+private:
+    void beginRow()
+    {
+        m_fields = 0;
+        if (m_format == SpreadsheetXml)
+            m_buffer += "<Row>";
+    }
+
+    void endRow()
+    {
+        if (m_format == SpreadsheetXml)
+            m_buffer += "</Row>\n";
+        else if (m_format == Csv)
+            m_buffer += "\r\n";
+        else
+            m_buffer += '\n';
+    }
+
+    // RFC 4180 quoting for CSV; TSV has no quoting, tabs and line breaks become spaces
+    void appendField(const QString &text)
+    {
+        if (m_fields++ > 0)
+            m_buffer += m_format == Csv ? ',' : '\t';
+
+        const QByteArray &utf8 = text.toUtf8();
+        if (m_format == Tsv) {
+            const int begin = m_buffer.size();
+            m_buffer += utf8;
+            for (int i = begin; i < m_buffer.size(); ++i) {
+                const char c = m_buffer.at(i);
+                if (c == '\t' || c == '\n' || c == '\r')
+                    m_buffer[i] = ' ';
+            }
+            return;
+        }
+
+        bool quote = false;
+        for (int i = 0; i < utf8.size() && !quote; ++i) {
+            const char c = utf8.at(i);
+            quote = c == ',' || c == '"' || c == '\n' || c == '\r';
+        }
+        if (!quote) {
+            m_buffer += utf8;
+            return;
+        }
+        m_buffer += '"';
+        for (int i = 0; i < utf8.size(); ++i) {
+            if (utf8.at(i) == '"')
+                m_buffer += '"';
+            m_buffer += utf8.at(i);
+        }
+        m_buffer += '"';
+    }
+
+    // index is 1 based, -1 for the cell right after the previous one
+    void appendXmlCell(const QString &text, bool numeric, bool header = false, int index = -1, int mergeAcross = 0, int mergeDown = 0)
+    {
+        m_buffer += "<Cell";
+        if (header)
+            m_buffer += " ss:StyleID=\"header\"";
+        if (index > 0)
+            m_buffer += " ss:Index=\"" + QByteArray::number(index) + '"';
+        if (mergeAcross > 0)
+            m_buffer += " ss:MergeAcross=\"" + QByteArray::number(mergeAcross) + '"';
+        if (mergeDown > 0)
+            m_buffer += " ss:MergeDown=\"" + QByteArray::number(mergeDown) + '"';
+        if (text.isEmpty()) {
+            m_buffer += "/>";
+            return;
+        }
+        m_buffer += numeric ? "><Data ss:Type=\"Number\">" : "><Data ss:Type=\"String\">";
+
+        const QByteArray &utf8 = text.toUtf8();
+        for (int i = 0; i < utf8.size(); ++i) {
+            const char c = utf8.at(i);
+            switch (c) {
+            case '&': m_buffer += "&amp;"; break;
+            case '<': m_buffer += "&lt;"; break;
+            case '>': m_buffer += "&gt;"; break;
+            case '"': m_buffer += "&quot;"; break;
+            case '\n': m_buffer += "&#10;"; break;
+            case '\r': m_buffer += "&#13;"; break;
+            case '\t': m_buffer += c; break;
+            default:
+                // other control characters are not allowed in XML 1.0
+                if (uchar(c) >= 0x20)
+                    m_buffer += c;
+                break;
+            }
+        }
+        m_buffer += "</Data></Cell>";
+    }
+
+    bool flush(bool force)
+    {
+        if (m_buffer.isEmpty() || (!force && m_buffer.size() < WriteBufferSize))
+            return true;
+        if (m_file->write(m_buffer) != m_buffer.size()) {
+            m_failed = true;
+            return false;
+        }
+        m_buffer.resize(0);
+        return true;
+    }
+
+    QSaveFile *m_file;
+    QByteArray m_buffer;
+    Format m_format;
+    SpanMode m_spanMode;
+    const QAtomicInt *m_cancelled;
+    int m_fields;
+    bool m_failed;
+};
+
+HierarchicalHeaderExporter::HierarchicalHeaderExporter(QObject *parent) :
+    QObject(parent),
+    m_role(Qt::DisplayRole),
+    m_format(Csv),
+    m_spanMode(MergedSpans),
+    m_chunkRows(1024),
+    m_maxPendingChunks(4),
+    m_thread(new QThread(this)),
+    m_writer(Q_NULLPTR),
+    m_cancelled(0),
+    m_running(false),
+    m_closing(false),
+    m_pendingChunks(0),
+    m_rowCount(0),
+    m_columnCount(0),
+    m_nextRow(0),
+    m_rowsWritten(0)
+{
+    m_thread->setObjectName("HierarchicalHeaderExporter");
+    m_readTimer.setSingleShot(true);
+    m_readTimer.setInterval(0);
+    connect(&m_readTimer, SIGNAL(timeout()), this, SLOT(slotReadChunk()));
+}
+
+HierarchicalHeaderExporter::~HierarchicalHeaderExporter()
+{
+    if (m_writer != Q_NULLPTR) {
+        m_cancelled.storeRelease(1);
+        // runs after the calls already queued, nothing calls back into this object any more
+        Writer *writer = m_writer;
+        QMetaObject::invokeMethod(writer, [writer]() {
+            writer->close(false);
+            delete writer;
+        }, Qt::BlockingQueuedConnection);
+        m_writer = Q_NULLPTR;
+    }
+    m_thread->quit();
+    m_thread->wait();
+}
+
+void HierarchicalHeaderExporter::setSourceModel(QAbstractItemModel *model, int role)
+{
+    if (!m_model.isNull())
+        m_model->disconnect(this);
+    m_model = model;
+    m_role = role;
+    if (model == Q_NULLPTR)
+        return;
+
+    connect(model, SIGNAL(modelAboutToBeReset()), this, SLOT(slotSourceChanged()));
+    connect(model, SIGNAL(layoutAboutToBeChanged()), this, SLOT(slotSourceChanged()));
+    connect(model, SIGNAL(rowsAboutToBeRemoved(QModelIndex, int, int)), this, SLOT(slotSourceChanged()));
+    connect(model, SIGNAL(rowsMoved(QModelIndex, int, int, QModelIndex, int)), this, SLOT(slotSourceChanged()));
+    connect(model, SIGNAL(columnsInserted(QModelIndex, int, int)), this, SLOT(slotSourceChanged()));
+    connect(model, SIGNAL(columnsRemoved(QModelIndex, int, int)), this, SLOT(slotSourceChanged()));
+    connect(model, SIGNAL(columnsMoved(QModelIndex, int, int, QModelIndex, int)), this, SLOT(slotSourceChanged()));
+    connect(model, SIGNAL(rowsInserted(QModelIndex, int, int)), this, SLOT(slotSourceRowsInserted(QModelIndex, int, int)));
+    connect(model, SIGNAL(destroyed()), this, SLOT(slotSourceDestroyed()));
+}
+
+QAbstractItemModel *HierarchicalHeaderExporter::sourceModel() const
+{
+    return m_model.data();
+}
+
+void HierarchicalHeaderExporter::setHeaderModel(QAbstractItemModel *headerModel)
+{
+    m_headerModel = headerModel;
+}
+
+void HierarchicalHeaderExporter::setFormat(Format format)
+{
+    m_format = format;
+}
+
+HierarchicalHeaderExporter::Format HierarchicalHeaderExporter::format() const
+{
+    return m_format;
+}
+
+void HierarchicalHeaderExporter::setSpanMode(SpanMode mode)
+{
+    m_spanMode = mode;
+}
+
+HierarchicalHeaderExporter::SpanMode HierarchicalHeaderExporter::spanMode() const
+{
+    return m_spanMode;
+}
+
+void HierarchicalHeaderExporter::setChunkRows(int rows)
+{
+    m_chunkRows = qMax(1, rows);
+}
+
+void HierarchicalHeaderExporter::setMaxPendingChunks(int chunks)
+{
+    m_maxPendingChunks = qMax(1, chunks);
+}
+
+/**
+ * @brief HierarchicalHeaderExporter::headerCells one cell per node of the header tree, in tree order.
+ * Nodes starting past columnCount are dropped and spans are cut at columnCount
+ */
+QVector<HierarchicalHeaderExporter::HeaderCell> HierarchicalHeaderExporter::headerCells(
+        const QAbstractItemModel *headerTree, const QAbstractItemModel *model, int columnCount, int *headerRows)
+{
+    QVector<HeaderCell> cells;
+    int rows = 0;
+    if (headerTree != Q_NULLPTR && headerTree->columnCount() > 0) {
+        QVector<HeaderCell> all;
+        QVector<int> leafCells;
+        collectCells(headerTree, QModelIndex(), 0, 0, all, leafCells, rows);
+        for (int i = 0; i < leafCells.size(); ++i) {
+            HeaderCell &leaf = all[leafCells.at(i)];
+            leaf.rowSpan = rows - leaf.row;
+        }
+        for (int i = 0; i < all.size(); ++i) {
+            HeaderCell cell = all.at(i);
+            if (cell.column >= columnCount)
+                continue;
+            cell.columnSpan = qMin(cell.columnSpan, columnCount - cell.column);
+            cells.append(cell);
+        }
+    } else if (model != Q_NULLPTR && columnCount > 0) {
+        rows = 1;
+        cells.reserve(columnCount);
+        for (int column = 0; column < columnCount; ++column) {
+            HeaderCell cell = { model->headerData(column, Qt::Horizontal).toString(), 0, column, 1, 1 };
+            cells.append(cell);
+        }
+    }
+    if (headerRows != Q_NULLPTR)
+        *headerRows = rows;
+    return cells;
+}
+
+/**
+ * @brief HierarchicalHeaderExporter::start begin exporting the source model to fileName,
+ * signalFinished() tells how it ended. The file only replaces an existing one once complete
+ * @return false if an export is running or there is nothing to export
+ */
+bool HierarchicalHeaderExporter::start(const QString &fileName)
+{
+    if (m_running || m_model.isNull() || fileName.isEmpty())
+        return false;
+
+    m_rowCount = m_model->rowCount();
+    m_columnCount = m_model->columnCount();
+    int headerRows = 0;
+    const QVector<HeaderCell> &cells = headerCells(headerTree(), m_model, m_columnCount, &headerRows);
+
+    m_cancelled.storeRelease(0);
+    m_running = true;
+    m_closing = false;
+    m_pendingChunks = 0;
+    m_nextRow = 0;
+    m_rowsWritten = 0;
+    m_error.clear();
+
+    m_writer = new Writer(m_format, m_spanMode, &m_cancelled);
+    m_writer->moveToThread(m_thread);
+    if (!m_thread->isRunning())
+        m_thread->start();
+
+    Writer *writer = m_writer;
+    const int columns = m_columnCount;
+    QMetaObject::invokeMethod(writer, [this, writer, fileName, cells, headerRows, columns]() {
+        if (!writer->open(fileName, cells, headerRows, columns)) {
+            const QString &error = writer->errorString();
+            QMetaObject::invokeMethod(this, [this, error]() { fail(error); }, Qt::QueuedConnection);
+        }
+    }, Qt::QueuedConnection);
+
+    emit signalProgress(0, m_rowCount);
+    m_readTimer.start();
+    return true;
+}
+
+void HierarchicalHeaderExporter::cancel()
+{
+    if (!m_running || m_closing)
+        return;
+    m_cancelled.storeRelease(1);
+    m_error = tr("Export cancelled");
+    close(false);
+}
+
+bool HierarchicalHeaderExporter::isRunning() const
+{
+    return m_running;
+}
+
+QString HierarchicalHeaderExporter::errorString() const
+{
+    return m_error;
+}
+
+/**
+ * @brief HierarchicalHeaderExporter::slotReadChunk read the next rows on this thread and queue them
+ * to the writer; stops while maxPendingChunks chunks are not written yet
+ */
+void HierarchicalHeaderExporter::slotReadChunk()
+{
+    if (!m_running || m_closing)
+        return;
+    if (m_model.isNull()) {
+        slotSourceDestroyed();
+        return;
+    }
+    if (m_pendingChunks >= m_maxPendingChunks)
+        return;
+
+    HIERARCHICAL_HEADER_TRACE("exportReadChunk");
+    Chunk chunk;
+    chunk.rows = qMin(m_chunkRows, m_rowCount - m_nextRow);
+    chunk.columns = m_columnCount;
+    chunk.cells.resize(chunk.rows * chunk.columns);
+    chunk.numeric.resize(chunk.rows * chunk.columns);
+    for (int row = 0; row < chunk.rows; ++row) {
+        for (int column = 0; column < chunk.columns; ++column) {
+            const QVariant &value = m_model->data(m_model->index(m_nextRow + row, column), m_role);
+            const int cell = row * chunk.columns + column;
+            chunk.cells[cell] = value.toString();
+            if (isNumeric(value))
+                chunk.numeric.setBit(cell);
+        }
+    }
+    m_nextRow += chunk.rows;
+
+    if (chunk.rows > 0) {
+        ++m_pendingChunks;
+        Writer *writer = m_writer;
+        QMetaObject::invokeMethod(writer, [this, writer, chunk]() {
+            if (writer->write(chunk)) {
+                const int rows = chunk.rows;
+                QMetaObject::invokeMethod(this, [this, rows]() { chunkWritten(rows); }, Qt::QueuedConnection);
+            } else {
+                const QString &error = writer->errorString();
+                QMetaObject::invokeMethod(this, [this, error]() { fail(error); }, Qt::QueuedConnection);
+            }
+        }, Qt::QueuedConnection);
+    }
+
+    if (m_nextRow >= m_rowCount)
+        close(true);
+    else
+        m_readTimer.start();
+}
+
+void HierarchicalHeaderExporter::slotSourceChanged()
+{
+    if (m_running)
+        fail(tr("The model changed during the export"));
+}
+
+// an export left running would keep every later start() from running
+void HierarchicalHeaderExporter::slotSourceDestroyed()
+{
+    if (m_running)
+        fail(tr("The model was destroyed during the export"));
+}
+
+// rows appended after the exported range are fine, anything earlier shifts the rows not read yet
+void HierarchicalHeaderExporter::slotSourceRowsInserted(const QModelIndex &parent, int first, int /*last*/)
+{
+    if (m_running && !parent.isValid() && first < m_rowCount)
+        fail(tr("The model changed during the export"));
+}
+
+QAbstractItemModel *HierarchicalHeaderExporter::headerTree() const
+{
+    const QAbstractItemModel *model = !m_headerModel.isNull() ? m_headerModel.data() : m_model.data();
+    if (model == Q_NULLPTR)
+        return Q_NULLPTR;
+    const QVariant &v = model->data(QModelIndex(), HierarchicalHeaderView::HorizontalHeaderDataRole);
+    if (!v.isValid())
+        return Q_NULLPTR;
+    return qobject_cast<QAbstractItemModel *>(v.value<QObject *>());
+}
+
+void HierarchicalHeaderExporter::chunkWritten(int rows)
+{
+    // the writer skips what is left once cancelled
+    if (!m_running || m_cancelled.loadAcquire() != 0)
+        return;
+    --m_pendingChunks;
+    m_rowsWritten += rows;
+    emit signalProgress(m_rowsWritten, m_rowCount);
+    if (!m_closing && !m_readTimer.isActive())
+        m_readTimer.start();
+}
+
+void HierarchicalHeaderExporter::fail(const QString &error)
+{
+    if (!m_running || m_closing)
+        return;
+    m_error = error;
+    m_cancelled.storeRelease(1);
+    close(false);
+}
+
+// queued behind the chunks already handed to the writer
+void HierarchicalHeaderExporter::close(bool commit)
+{
+    m_closing = true;
+    m_readTimer.stop();
+    Writer *writer = m_writer;
+    QMetaObject::invokeMethod(writer, [this, writer, commit]() {
+        const bool ok = writer->close(commit);
+        const QString &error = ok || !commit ? QString() : writer->errorString();
+        QMetaObject::invokeMethod(this, [this, ok, error]() { finished(ok, error); }, Qt::QueuedConnection);
+    }, Qt::QueuedConnection);
+}
+
+void HierarchicalHeaderExporter::finished(bool ok, const QString &error)
+{
+    if (m_writer == Q_NULLPTR)
+        return;
+    m_writer->deleteLater();
+    m_writer = Q_NULLPTR;
+    m_running = false;
+    m_closing = false;
+    if (!error.isEmpty())
+        m_error = error;
+    emit signalFinished(ok);
+}
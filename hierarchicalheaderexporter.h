@@ -0,0 +1,115 @@
+#ifndef HIERARCHICAL_HEADER_EXPORTER_H
+#define HIERARCHICAL_HEADER_EXPORTER_H
+
+#include <QAtomicInt>
+#include <QObject>
+#include <QPointer>
+#include <QAbstractItemModel>
+#include <QTimer>
+#include <QVector>
+
+class QThread;
+
+/**
+ * @brief The HierarchicalHeaderExporter class writes a table model with its header tree to CSV,
+ * TSV or SpreadsheetML (Excel 2003 XML). The header tree gives one header line per level, a
+ * parent spans its leaves either as a merged cell or with its title repeated in every cell.
+ * Rows are read from the model in chunks on the thread owning the model, a few at a time, and
+ * formatted and written to the file by a worker thread through a buffered writer: the UI keeps
+ * running and memory stays bounded by chunkRows * maxPendingChunks rows whatever the export size.
+ * The model must not change structure while exporting, the export fails if it does.
+ */
+class HierarchicalHeaderExporter : public QObject
+{
+    Q_OBJECT
+public:
+    enum Format
+    {
+        Csv,
+        Tsv,
+        SpreadsheetXml
+    };
+
+    enum SpanMode
+    {
+        MergedSpans,    // title in the first cell, the others empty (merged in SpreadsheetXml)
+        RepeatedSpans   // title in every cell under the parent
+    };
+
+    struct HeaderCell
+    {
+        QString title;
+        int row;
+        int column;
+        int rowSpan;    // a leaf reaches down to the last header line
+        int columnSpan;
+    };
+
+    explicit HierarchicalHeaderExporter(QObject *parent = Q_NULLPTR);
+    ~HierarchicalHeaderExporter();
+
+    void setSourceModel(QAbstractItemModel *model, int role = Qt::DisplayRole);
+    QAbstractItemModel *sourceModel() const;
+    // a HierarchicalHeaderModel, or any model serving the tree through HorizontalHeaderDataRole;
+    // the source model is asked for the tree when unset
+    void setHeaderModel(QAbstractItemModel *headerModel);
+
+    void setFormat(Format format);
+    Format format() const;
+    void setSpanMode(SpanMode mode);
+    SpanMode spanMode() const;
+    void setChunkRows(int rows);
+    void setMaxPendingChunks(int chunks);
+
+    // the header lines for columnCount columns, flat headerData() titles without a header tree
+    static QVector<HeaderCell> headerCells(const QAbstractItemModel *headerTree, const QAbstractItemModel *model,
+                                           int columnCount, int *headerRows = Q_NULLPTR);
+
+    bool start(const QString &fileName);
+    void cancel();
+    bool isRunning() const;
+    QString errorString() const;
+
+signals:
+    void signalProgress(qint64 rowsWritten, qint64 rowCount);
+    void signalFinished(bool ok);
+
+private slots:
+    void slotReadChunk();
+    void slotSourceChanged();
+    void slotSourceDestroyed();
+    void slotSourceRowsInserted(const QModelIndex &parent, int first, int last);
+
+private:
+    class Writer;
+    struct Chunk;
+
+    QAbstractItemModel *headerTree() const;
+    void chunkWritten(int rows);
+    void fail(const QString &error);
+    void close(bool commit);
+    void finished(bool ok, const QString &error);
+
+    QPointer<QAbstractItemModel> m_model;
+    QPointer<QAbstractItemModel> m_headerModel;
+    int m_role;
+    Format m_format;
+    SpanMode m_spanMode;
+    int m_chunkRows;
+    int m_maxPendingChunks;
+
+    QThread *m_thread;
+    Writer *m_writer;
+    QTimer m_readTimer;
+    QAtomicInt m_cancelled;
+    bool m_running;
+    bool m_closing;
+    int m_pendingChunks;
+    int m_rowCount;
+    int m_columnCount;
+    int m_nextRow;
+    qint64 m_rowsWritten;
+    QString m_error;
+};
+
+#endif // HIERARCHICAL_HEADER_EXPORTER_H
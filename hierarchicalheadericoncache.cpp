@@ -0,0 +1,143 @@
+#include "hierarchicalheadericoncache.h"
+#include "hierarchicalheadertrace.h"
+
+#include <QCoreApplication>
+#include <QImageReader>
+#include <QPointer>
+#include <QRunnable>
+#include <QtMath>
+
+class HierarchicalHeaderIconCache::DecodeJob : public QRunnable
+{
+public:
+    DecodeJob(HierarchicalHeaderIconCache *cache, const QString &key, const QString &name,
+              const QSize &pixelSize, qreal devicePixelRatio) :
+        m_cache(cache), m_key(key), m_name(name), m_pixelSize(pixelSize), m_devicePixelRatio(devicePixelRatio)
+    {
+    }
+
+    void run() override
+    {
+        HIERARCHICAL_HEADER_TRACE("decodeIcon");
+        QImageReader reader(m_name);
+        // vector and large formats decode straight to the target size
+        const QSize &sourceSize = reader.size();
+        if (sourceSize.isValid())
+            reader.setScaledSize(sourceSize.scaled(m_pixelSize, Qt::KeepAspectRatio));
+        QImage image = reader.read();
+        if (!image.isNull() && (image.width() > m_pixelSize.width() || image.height() > m_pixelSize.height()))
+            image = image.scaled(m_pixelSize, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+        if (!image.isNull()) {
+            image = image.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+            image.setDevicePixelRatio(m_devicePixelRatio);
+        }
+
+        // the cache waits for its jobs before it goes away
+        HierarchicalHeaderIconCache *cache = m_cache;
+        const QString key = m_key;
+        const QString name = m_name;
+        QMetaObject::invokeMethod(cache, [cache, key, name, image]() { cache->decoded(key, name, image); },
+                                  Qt::QueuedConnection);
+    }
+
+private:
+    HierarchicalHeaderIconCache *m_cache;
+    QString m_key;
+    QString m_name;
+    QSize m_pixelSize;
+    qreal m_devicePixelRatio;
+};
+
+HierarchicalHeaderIconCache::HierarchicalHeaderIconCache(QObject *parent) :
+    QObject(parent),
+    m_pixmaps(8 << 20)
+{
+    m_pool.setMaxThreadCount(2);
+}
+
+HierarchicalHeaderIconCache::~HierarchicalHeaderIconCache()
+{
+    // running decodes post to this object, they have to end first
+    m_pool.clear();
+    m_pool.waitForDone();
+}
+
+/**
+ * @brief HierarchicalHeaderIconCache::instance cache shared by the header views, owned by the application
+ */
+HierarchicalHeaderIconCache *HierarchicalHeaderIconCache::instance()
+{
+    static QPointer<HierarchicalHeaderIconCache> cache;
+    if (cache.isNull())
+        cache = new HierarchicalHeaderIconCache(QCoreApplication::instance());
+    return cache.data();
+}
+
+/**
+ * @brief HierarchicalHeaderIconCache::pixmap icon of size (device independent pixels) for devicePixelRatio
+ * @return a null pixmap while the icon is decoded, or when it can not be decoded
+ */
+QPixmap HierarchicalHeaderIconCache::pixmap(const QString &name, const QSize &size, qreal devicePixelRatio)
+{
+    if (name.isEmpty() || size.isEmpty() || m_failed.contains(name))
+        return QPixmap();
+
+    const QString &key = cacheKey(name, size, devicePixelRatio);
+    if (QPixmap *cached = m_pixmaps.object(key))
+        return *cached;
+    if (m_pending.contains(key))
+        return QPixmap();
+
+    m_pending.insert(key);
+    const QSize pixelSize(qCeil(size.width() * devicePixelRatio), qCeil(size.height() * devicePixelRatio));
+    m_pool.start(new DecodeJob(this, key, name, pixelSize, devicePixelRatio));
+    return QPixmap();
+}
+
+bool HierarchicalHeaderIconCache::isFailed(const QString &name) const
+{
+    return m_failed.contains(name);
+}
+
+void HierarchicalHeaderIconCache::setMaxCost(int bytes)
+{
+    m_pixmaps.setMaxCost(qMax(0, bytes));
+}
+
+int HierarchicalHeaderIconCache::maxCost() const
+{
+    return m_pixmaps.maxCost();
+}
+
+void HierarchicalHeaderIconCache::setThreadCount(int count)
+{
+    m_pool.setMaxThreadCount(qMax(1, count));
+}
+
+void HierarchicalHeaderIconCache::clear()
+{
+    m_pixmaps.clear();
+    m_failed.clear();
+}
+
+// the pixmap is made here, on the GUI thread, from the image decoded by the worker
+void HierarchicalHeaderIconCache::decoded(const QString &key, const QString &name, const QImage &image)
+{
+    m_pending.remove(key);
+    if (image.isNull()) {
+        m_failed.insert(name);
+        return;
+    }
+    QPixmap *pixmap = new QPixmap(QPixmap::fromImage(image));
+    // an icon bigger than the whole cache would be decoded again on every paint
+    if (!m_pixmaps.insert(key, pixmap, qMax(1, pixmap->width() * pixmap->height() * 4))) {
+        m_failed.insert(name);
+        return;
+    }
+    emit signalIconReady(name);
+}
+
+QString HierarchicalHeaderIconCache::cacheKey(const QString &name, const QSize &size, qreal devicePixelRatio)
+{
+    return QString("%1|%2x%3@%4").arg(name).arg(size.width()).arg(size.height()).arg(devicePixelRatio);
+}
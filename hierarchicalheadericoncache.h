@@ -0,0 +1,51 @@
+#ifndef HIERARCHICAL_HEADER_ICON_CACHE_H
+#define HIERARCHICAL_HEADER_ICON_CACHE_H
+
+#include <QCache>
+#include <QImage>
+#include <QObject>
+#include <QPixmap>
+#include <QSet>
+#include <QThreadPool>
+
+/**
+ * @brief The HierarchicalHeaderIconCache class header cell icons by name (a file or resource path),
+ * decoded and scaled on worker threads, cached per logical size and device pixel ratio.
+ * pixmap() never touches the disk: it returns what is cached, or a null pixmap after queueing the
+ * decode, and signalIconReady() follows once the icon can be painted. The cache is bounded by
+ * the byte size of the pixmaps; names that fail to decode are remembered and not retried.
+ * Use it from the GUI thread only, instance() is shared by all header views.
+ */
+class HierarchicalHeaderIconCache : public QObject
+{
+    Q_OBJECT
+public:
+    explicit HierarchicalHeaderIconCache(QObject *parent = Q_NULLPTR);
+    ~HierarchicalHeaderIconCache();
+
+    static HierarchicalHeaderIconCache *instance();
+
+    QPixmap pixmap(const QString &name, const QSize &size, qreal devicePixelRatio);
+    bool isFailed(const QString &name) const;
+
+    void setMaxCost(int bytes);
+    int maxCost() const;
+    void setThreadCount(int count);
+    void clear();
+
+signals:
+    void signalIconReady(const QString &name);
+
+private:
+    class DecodeJob;
+
+    void decoded(const QString &key, const QString &name, const QImage &image);
+    static QString cacheKey(const QString &name, const QSize &size, qreal devicePixelRatio);
+
+    QCache<QString, QPixmap> m_pixmaps;
+    QSet<QString> m_pending;
+    QSet<QString> m_failed;
+    QThreadPool m_pool;
+};
+
+#endif // HIERARCHICAL_HEADER_ICON_CACHE_H
@@ -0,0 +1,100 @@
+#include "hierarchicalheaderlayout.h"
+
+HierarchicalHeaderLayout::HierarchicalHeaderLayout()
+{
+}
+
+HierarchicalHeaderLayout::HierarchicalHeaderLayout(HierarchicalHeaderLayoutData *data) :
+    d(data)
+{
+}
+
+HierarchicalHeaderLayout::HierarchicalHeaderLayout(const HierarchicalHeaderLayout &other) :
+    d(other.d)
+{
+}
+
+HierarchicalHeaderLayout &HierarchicalHeaderLayout::operator=(const HierarchicalHeaderLayout &other)
+{
+    d = other.d;
+    return *this;
+}
+
+HierarchicalHeaderLayout::~HierarchicalHeaderLayout()
+{
+}
+
+bool HierarchicalHeaderLayout::isNull() const
+{
+    return !d;
+}
+
+quint64 HierarchicalHeaderLayout::version() const
+{
+    return d ? d->version : 0;
+}
+
+Qt::Orientation HierarchicalHeaderLayout::orientation() const
+{
+    return d ? d->orientation : Qt::Horizontal;
+}
+
+int HierarchicalHeaderLayout::length() const
+{
+    return d ? d->length : 0;
+}
+
+int HierarchicalHeaderLayout::thickness() const
+{
+    return d ? d->thickness : 0;
+}
+
+int HierarchicalHeaderLayout::nodeCount() const
+{
+    return d ? d->nodes.size() : 0;
+}
+
+const HierarchicalHeaderLayout::Node &HierarchicalHeaderLayout::node(int id) const
+{
+    return d->nodes.at(id);
+}
+
+int HierarchicalHeaderLayout::sectionCount() const
+{
+    return d ? d->sections.size() : 0;
+}
+
+const HierarchicalHeaderLayout::Section &HierarchicalHeaderLayout::section(int logicalIndex) const
+{
+    return d->sections.at(logicalIndex);
+}
+
+int HierarchicalHeaderLayout::leafNode(int logicalIndex) const
+{
+    if (!d || logicalIndex < 0 || logicalIndex >= d->leafNodes.size())
+        return -1;
+    return d->leafNodes.at(logicalIndex);
+}
+
+int HierarchicalHeaderLayout::logicalIndex(int visualIndex) const
+{
+    if (!d || visualIndex < 0 || visualIndex >= d->logicalIndexes.size())
+        return -1;
+    return d->logicalIndexes.at(visualIndex);
+}
+
+/**
+ * @brief HierarchicalHeaderLayout::cellRect rect of a cell in header coordinates,
+ * leaves and collapsed groups reach to the far edge of the header
+ */
+QRect HierarchicalHeaderLayout::cellRect(int id) const
+{
+    if (!d || id < 0 || id >= d->nodes.size())
+        return QRect();
+
+    const Node &cell = d->nodes.at(id);
+    int extent = (cell.extent == 0 || cell.collapsed) ? d->thickness - cell.offset : cell.extent;
+    if (d->orientation == Qt::Horizontal)
+        return QRect(cell.begin, cell.offset, cell.end - cell.begin, extent);
+    return QRect(cell.offset, cell.begin, extent, cell.end - cell.begin);
+}
@@ -0,0 +1,97 @@
+#ifndef HIERARCHICAL_HEADER_LAYOUT_H
+#define HIERARCHICAL_HEADER_LAYOUT_H
+
+#include <QSharedData>
+#include <QSharedDataPointer>
+#include <QString>
+#include <QVector>
+#include <QRect>
+#include <QMetaType>
+
+class HierarchicalHeaderLayoutData;
+
+/**
+ * @brief The HierarchicalHeaderLayout class immutable snapshot of a HierarchicalHeaderView:
+ * header tree, titles, spans, section geometry and the state roles of every cell.
+ * Copies share the data, a snapshot may be read from any thread while the view keeps changing.
+ */
+class HierarchicalHeaderLayout
+{
+public:
+    struct Node
+    {
+        QString title;
+        int parent;
+        int depth;
+        int firstLeaf;   // logical index of the first leaf below the node
+        int leafCount;
+        int begin;       // pixel span along the header, in header coordinates
+        int end;
+        int offset;      // distance from the top (left) of the header
+        int extent;      // row height (column width) of parent cells, 0 for leaves
+        bool collapsed;
+        int selected;
+        int arrow;
+        int filterBtnState;
+        int canFilter;
+    };
+
+    struct Section
+    {
+        int position;
+        int size;
+        int visualIndex;
+        bool hidden;
+    };
+
+    HierarchicalHeaderLayout();
+    HierarchicalHeaderLayout(const HierarchicalHeaderLayout &other);
+    HierarchicalHeaderLayout &operator=(const HierarchicalHeaderLayout &other);
+    ~HierarchicalHeaderLayout();
+
+    bool isNull() const;
+    quint64 version() const;
+    Qt::Orientation orientation() const;
+    int length() const;
+    int thickness() const;
+
+    int nodeCount() const;
+    const Node &node(int id) const;
+    int sectionCount() const;
+    const Section &section(int logicalIndex) const;
+    int leafNode(int logicalIndex) const;
+    int logicalIndex(int visualIndex) const;
+
+    QRect cellRect(int id) const;
+
+private:
+    friend class HierarchicalHeaderView;
+    explicit HierarchicalHeaderLayout(HierarchicalHeaderLayoutData *data);
+
+    QSharedDataPointer<HierarchicalHeaderLayoutData> d;
+};
+
+class HierarchicalHeaderLayoutData : public QSharedData
+{
+public:
+    HierarchicalHeaderLayoutData() :
+        version(0),
+        orientation(Qt::Horizontal),
+        length(0),
+        thickness(0)
+    {
+    }
+
+    quint64 version;
+    Qt::Orientation orientation;
+    int length;
+    int thickness;
+    QVector<HierarchicalHeaderLayout::Node> nodes;
+    QVector<HierarchicalHeaderLayout::Section> sections;
+    QVector<int> leafNodes;
+    QVector<int> logicalIndexes;
+};
+
+Q_DECLARE_METATYPE(HierarchicalHeaderLayout)
+
+#endif // HIERARCHICAL_HEADER_LAYOUT_H
@@ -1,12 +1,28 @@
 ﻿#include "hierarchicalheadermodel.h"
 #include <QDebug>
 #include <QStandardItem>
+#include <QTimer>
+#include <QHash>
+#include <QPair>
+#include <QDataStream>
+#include <QSet>
+#include <climits>
+#include <algorithm>
+#include "hierarchicalheadertrace.h"
+
+static const quint32 HeaderModelStateMagic = 0x514d4853; // "QMHS"
+static const quint8 HeaderModelStateVersion = 1;
 
 HierarchicalHeaderModel::HierarchicalHeaderModel(QStandardItemModel *model, QObject *parent) :
     QAbstractTableModel(parent),
-    m_curSelectedIndex(QModelIndex()),
+    m_currentColumn(-1),
     m_curArrowIndex(QModelIndex()),
-    m_headerModel(Q_NULLPTR)
+    m_headerModel(Q_NULLPTR),
+    m_schemaModel(Q_NULLPTR),
+    m_drainScheduled(0),
+    m_mutationBatchSize(256),
+    m_mutationInterval(16),
+    m_applyingBatch(false)
 {
     m_headerModel = model;
     if (m_headerModel != Q_NULLPTR) {
@@ -19,9 +35,14 @@ HierarchicalHeaderModel::HierarchicalHeaderModel(QStandardItemModel *model, QObj
 
 HierarchicalHeaderModel::HierarchicalHeaderModel(const QStringList &headerList, QObject *parent) :
     QAbstractTableModel(parent),
-    m_curSelectedIndex(QModelIndex()),
+    m_currentColumn(-1),
     m_curArrowIndex(QModelIndex()),
-    m_headerModel(Q_NULLPTR)
+    m_headerModel(Q_NULLPTR),
+    m_schemaModel(Q_NULLPTR),
+    m_drainScheduled(0),
+    m_mutationBatchSize(256),
+    m_mutationInterval(16),
+    m_applyingBatch(false)
 {
     m_headerModel = new QStandardItemModel(this);
     connect(m_headerModel, &QStandardItemModel::dataChanged, this, &HierarchicalHeaderModel::slotDataChanged);
@@ -34,31 +55,98 @@ HierarchicalHeaderModel::HierarchicalHeaderModel(const QStringList &headerList,
     m_headerList = headerList;
 }
 
+HierarchicalHeaderModel::HierarchicalHeaderModel(HierarchicalHeaderSchemaModel *schema, QObject *parent) :
+    QAbstractTableModel(parent),
+    m_currentColumn(-1),
+    m_curArrowIndex(QModelIndex()),
+    m_headerModel(Q_NULLPTR),
+    m_schemaModel(schema),
+    m_drainScheduled(0),
+    m_mutationBatchSize(256),
+    m_mutationInterval(16),
+    m_applyingBatch(false)
+{
+    m_schemaModel->setParent(this);
+    connect(m_schemaModel, &QAbstractItemModel::dataChanged, this, &HierarchicalHeaderModel::slotDataChanged);
+}
+
 HierarchicalHeaderModel::~HierarchicalHeaderModel()
 {
-    m_headerModel->deleteLater();
+    if (m_headerModel != Q_NULLPTR)
+        m_headerModel->deleteLater();
+}
+
+/**
+ * @brief HierarchicalHeaderModel::fromSchemaFile open a schema written by saveSchemaFile(),
+ * nothing is copied out of the file so this is cheap for any header size.
+ * The returned header is read-only, the column mutators do nothing on it.
+ * @return Q_NULLPTR if the file can not be mapped or is not a schema file
+ */
+HierarchicalHeaderModel *HierarchicalHeaderModel::fromSchemaFile(const QString &fileName, QObject *parent)
+{
+    HierarchicalHeaderSchemaModel *schema = new HierarchicalHeaderSchemaModel;
+    if (!schema->open(fileName)) {
+        delete schema;
+        return Q_NULLPTR;
+    }
+    return new HierarchicalHeaderModel(schema, parent);
+}
+
+/**
+ * @brief HierarchicalHeaderModel::fromStaticSchema header over tables generated at compile time,
+ * e.g. fromStaticSchema(QuoteHeader::tables()); nothing is allocated per node.
+ * Read-only like fromSchemaFile()
+ */
+HierarchicalHeaderModel *HierarchicalHeaderModel::fromStaticSchema(const HierarchicalHeaderSchemaModel::StaticTables &tables, QObject *parent)
+{
+    HierarchicalHeaderSchemaModel *schema = new HierarchicalHeaderSchemaModel;
+    if (!schema->openStatic(tables)) {
+        delete schema;
+        return Q_NULLPTR;
+    }
+    return new HierarchicalHeaderModel(schema, parent);
+}
+
+bool HierarchicalHeaderModel::saveSchemaFile(const QString &fileName) const
+{
+    return HierarchicalHeaderSchemaModel::write(sourceModel(), fileName);
+}
+
+QAbstractItemModel *HierarchicalHeaderModel::sourceModel() const
+{
+    if (m_schemaModel != Q_NULLPTR)
+        return m_schemaModel;
+    return m_headerModel;
 }
 
 int HierarchicalHeaderModel::modelCount()
 {
-    if (m_headerModel != Q_NULLPTR)
-        return m_headerModel->columnCount();
+    if (sourceModel() != Q_NULLPTR)
+        return sourceModel()->columnCount();
 
     return 0;
 }
 
+QStringList HierarchicalHeaderModel::headerList() const
+{
+    // built on demand for schema files, keeping open() independent of the header size
+    if (m_schemaModel != Q_NULLPTR) {
+        QStringList list;
+        getSchemaHeaderList(list);
+        return list;
+    }
+    return m_headerList;
+}
+
 void HierarchicalHeaderModel::appendColumnItem(QStandardItem *item)
 {
     if (item == Q_NULLPTR || m_headerModel == Q_NULLPTR)
         return;
 
-    int column = m_headerModel->columnCount();
-    beginInsertColumns(QModelIndex(), column, column + item->columnCount() - 1);
-    m_headerModel->appendColumn({item});
-
-    for (int i = 0; i < item->columnCount(); ++i) {
-        m_headerList.append(item->child(0, i)->text());
-    }
+    // the columns of this model are the leaves, a childless item is a leaf itself
+    const int column = count();
+    beginInsertColumns(QModelIndex(), column, column + qMax(1, leafTitles(item).count()) - 1);
+    appendItem(item);
     endInsertColumns();
 }
 
@@ -67,39 +155,9 @@ void HierarchicalHeaderModel::removeColumnItem(int preIndex, int startIndex, int
     if (m_headerModel == Q_NULLPTR || preIndex < 0)
         return;
 
-    int count = endIndex > 0 ? endIndex - startIndex + 1 : 1;
-    if (count > m_headerList.count() - 2)
-        return;
-
-    QStandardItem *childItem = m_headerModel->item(0, preIndex);
-    if (childItem == Q_NULLPTR)
-        return;
-
-    const int &childCount = childItem->columnCount();
-    int listStart = 0;
-
-    for (int i = 0; i < preIndex; ++i) {
-        QStandardItem *item = m_headerModel->item(0, i);
-        if (item->columnCount() == 0) {
-            ++listStart;
-        } else {
-            listStart += item->columnCount();
-        }
-    }
-
-    int start = listStart + (startIndex - 1) * childCount;
-    int end = start + count * childCount;
-
-    const int &prevSelectedColumn = getActualColumnIndex(m_curSelectedIndex);
-    if (prevSelectedColumn >= start && prevSelectedColumn < end) {
-        m_curSelectedIndex = QModelIndex();
-    }
-
     beginResetModel();
 //    beginRemoveColumns(QModelIndex(), start, start + count * childCount);
-    m_headerModel->removeColumns(preIndex + startIndex - 1, count);
-    m_headerList.erase(m_headerList.begin() + start,
-        m_headerList.begin() + end);
+    removeItems(preIndex, startIndex, endIndex);
     endResetModel();
 //    endRemoveColumns();
 }
@@ -111,31 +169,93 @@ void HierarchicalHeaderModel::removeColumnItem(int preIndex, int startIndex, int
  */
 void HierarchicalHeaderModel::setColumnItemValue(int column, const QString &value)
 {
+    if (m_headerModel == Q_NULLPTR)
+        return;
+
     beginResetModel();
+    setItemValue(column, value);
+    endResetModel();
+}
 
-    if (m_headerModel == Q_NULLPTR)
+void HierarchicalHeaderModel::setSectionTitle(int column, const QString &value, int sonColumn)
+{
+    if (m_headerModel == Q_NULLPTR || column < 0 || column >= m_headerModel->columnCount())
         return;
 
+    beginResetModel();
+    setTitle(column, value, sonColumn);
+    endResetModel();
+}
+
+void HierarchicalHeaderModel::appendItem(QStandardItem *item)
+{
+    m_headerModel->appendColumn({item});
+    m_headerList.append(leafTitles(item));
+}
+
+// leaf titles of a top level item, named like getHeaderList names them
+QStringList HierarchicalHeaderModel::leafTitles(QStandardItem *item)
+{
+    QStringList titles;
+    if (item->hasChildren())
+        getHeaderList(titles, item);
+    else
+        titles.append(item->text());
+    return titles;
+}
+
+bool HierarchicalHeaderModel::removeItems(int preIndex, int startIndex, int endIndex)
+{
+    int count = endIndex > 0 ? endIndex - startIndex + 1 : 1;
+    if (count > m_headerList.count() - 2)
+        return false;
+
+    const int first = preIndex + startIndex - 1;
+    if (first < 0 || count <= 0 || first + count > m_headerModel->columnCount())
+        return false;
+
+    // the leaves of the top items in front and of the removed ones, each item at least one leaf
+    int start = 0;
+    for (int i = 0; i < first; ++i)
+        start += qMax(1, leafTitles(m_headerModel->item(0, i)).count());
+    int end = start;
+    for (int i = first; i < first + count; ++i)
+        end += qMax(1, leafTitles(m_headerModel->item(0, i)).count());
+
+    // removal runs under a reset, no selection signals needed
+    m_selection.removeColumns(start, end - start);
+    if (m_currentColumn >= end)
+        m_currentColumn -= end - start;
+    else if (m_currentColumn >= start)
+        m_currentColumn = -1;
+
+    m_headerModel->removeColumns(first, count);
+    m_headerList.erase(m_headerList.begin() + start,
+        m_headerList.begin() + end);
+    return true;
+}
+
+bool HierarchicalHeaderModel::setItemValue(int column, const QString &value)
+{
     QStandardItem *item = m_headerModel->item(0, column);
     if (item == Q_NULLPTR)
-        return;
+        return false;
 
     item->setText(value);
 
     if (column >= 0 && column < m_headerList.count()) {
         m_headerList[column] = value;
     }
-    endResetModel();
+    return true;
 }
 
-void HierarchicalHeaderModel::setSectionTitle(int column, const QString &value, int sonColumn)
+bool HierarchicalHeaderModel::setTitle(int column, const QString &value, int sonColumn)
 {
     if (column < 0 || column >= m_headerModel->columnCount())
-        return;
+        return false;
 
     int index = 0;
 
-    beginResetModel();
     QStandardItem *headerItem = m_headerModel->item(0, column);
     if (sonColumn < 0) {
         headerItem->setText(value);
@@ -143,7 +263,7 @@ void HierarchicalHeaderModel::setSectionTitle(int column, const QString &value,
     } else {
         if (headerItem == Q_NULLPTR ||
             sonColumn >= headerItem->columnCount())
-            return;
+            return false;
 
         QStandardItem *sonItem = headerItem->child(0, sonColumn);
         if (sonItem != Q_NULLPTR) {
@@ -155,22 +275,557 @@ void HierarchicalHeaderModel::setSectionTitle(int column, const QString &value,
     if (index >= 0 && index < m_headerList.count()) {
         m_headerList[index] = value;
     }
+    return true;
+}
+
+void HierarchicalHeaderModel::queueAppendColumn(const QString &title, const QStringList &children)
+{
+    HierarchicalHeaderMutation mutation;
+    mutation.type = HierarchicalHeaderMutation::AppendColumn;
+    mutation.column = -1;
+    mutation.sonColumn = -1;
+    mutation.endIndex = -1;
+    mutation.title = title;
+    mutation.children = children;
+    queueMutation(mutation);
+}
+
+void HierarchicalHeaderModel::queueRemoveColumn(int preIndex, int startIndex, int endIndex)
+{
+    HierarchicalHeaderMutation mutation;
+    mutation.type = HierarchicalHeaderMutation::RemoveColumn;
+    mutation.column = preIndex;
+    mutation.sonColumn = startIndex;
+    mutation.endIndex = endIndex;
+    queueMutation(mutation);
+}
+
+void HierarchicalHeaderModel::queueSetSectionTitle(int column, const QString &value, int sonColumn)
+{
+    HierarchicalHeaderMutation mutation;
+    mutation.type = HierarchicalHeaderMutation::SetSectionTitle;
+    mutation.column = column;
+    mutation.sonColumn = sonColumn;
+    mutation.endIndex = -1;
+    mutation.title = value;
+    queueMutation(mutation);
+}
+
+void HierarchicalHeaderModel::queueSetColumnItemValue(int column, const QString &value)
+{
+    HierarchicalHeaderMutation mutation;
+    mutation.type = HierarchicalHeaderMutation::SetColumnItemValue;
+    mutation.column = column;
+    mutation.sonColumn = -1;
+    mutation.endIndex = -1;
+    mutation.title = value;
+    queueMutation(mutation);
+}
+
+/**
+ * @brief HierarchicalHeaderModel::setMutationRate bound how fast queued mutations are applied
+ * @param maxPerBatch : mutations taken from the queue per batch
+ * @param intervalMs : pause before the next batch while the queue is not empty
+ */
+void HierarchicalHeaderModel::setMutationRate(int maxPerBatch, int intervalMs)
+{
+    m_mutationBatchSize = qMax(1, maxPerBatch);
+    m_mutationInterval = qMax(0, intervalMs);
+}
+
+void HierarchicalHeaderModel::queueMutation(const HierarchicalHeaderMutation &mutation)
+{
+    m_mutations.push(mutation);
+    // only the first push of a burst posts an event to the model thread
+    if (m_drainScheduled.testAndSetOrdered(0, 1))
+        QMetaObject::invokeMethod(this, "slotDrainMutations", Qt::QueuedConnection);
+}
+
+void HierarchicalHeaderModel::slotDrainMutations()
+{
+    HIERARCHICAL_HEADER_TRACE("drainMutations");
+    QVector<HierarchicalHeaderMutation> batch;
+    HierarchicalHeaderMutation mutation;
+    while (batch.size() < m_mutationBatchSize && m_mutations.pop(mutation))
+        batch.append(mutation);
+
+    // renames of the same cell collapse to the last one, structural changes shift
+    // the columns so they end the coalescing window
+    QHash<QPair<int, int>, int> lastRename;
+    QVector<bool> dropped(batch.size(), false);
+    for (int i = 0; i < batch.size(); ++i) {
+        const HierarchicalHeaderMutation &current = batch.at(i);
+        if (current.type == HierarchicalHeaderMutation::AppendColumn
+                || current.type == HierarchicalHeaderMutation::RemoveColumn) {
+            lastRename.clear();
+            continue;
+        }
+        QPair<int, int> key(current.column, current.sonColumn);
+        if (lastRename.contains(key))
+            dropped[lastRename.value(key)] = true;
+        lastRename.insert(key, i);
+    }
+
+    int applied = 0;
+    if (!batch.isEmpty() && m_headerModel != Q_NULLPTR) {
+        beginResetModel();
+        m_applyingBatch = true;
+        for (int i = 0; i < batch.size(); ++i) {
+            if (dropped.at(i))
+                continue;
+
+            const HierarchicalHeaderMutation &current = batch.at(i);
+            switch (current.type) {
+            case HierarchicalHeaderMutation::AppendColumn: {
+                QStandardItem *item = new QStandardItem(current.title);
+                for (int j = 0; j < current.children.count(); ++j)
+                    item->appendColumn({new QStandardItem(current.children.at(j))});
+                appendItem(item);
+                break;
+            }
+            case HierarchicalHeaderMutation::RemoveColumn:
+                if (current.column >= 0)
+                    removeItems(current.column, current.sonColumn, current.endIndex);
+                break;
+            case HierarchicalHeaderMutation::SetSectionTitle:
+                setTitle(current.column, current.title, current.sonColumn);
+                break;
+            case HierarchicalHeaderMutation::SetColumnItemValue:
+                setItemValue(current.column, current.title);
+                break;
+            }
+            ++applied;
+        }
+        m_applyingBatch = false;
+        endResetModel();
+    }
+
+    m_drainScheduled.fetchAndStoreOrdered(0);
+    // a producer may have pushed after the queue looked empty
+    if (!m_mutations.isEmpty() && m_drainScheduled.testAndSetOrdered(0, 1))
+        QTimer::singleShot(m_mutationInterval, this, SLOT(slotDrainMutations()));
+
+    if (applied > 0)
+        emit signalMutationsApplied(applied);
+}
+
+/**
+ * @brief HierarchicalHeaderModel::saveState header tree, titles and state roles in a compact binary form
+ */
+QByteArray HierarchicalHeaderModel::saveState() const
+{
+    QByteArray state;
+    if (m_headerModel == Q_NULLPTR)
+        return state;
+
+    QDataStream stream(&state, QIODevice::WriteOnly);
+    stream.setVersion(QDataStream::Qt_5_0);
+    stream << HeaderModelStateMagic << HeaderModelStateVersion;
+    stream << quint32(m_headerModel->columnCount());
+    int leaf = 0;
+    for (int i = 0; i < m_headerModel->columnCount(); ++i)
+        writeItem(stream, m_headerModel->item(0, i), leaf);
+    return state;
+}
+
+/**
+ * @brief HierarchicalHeaderModel::restoreState rebuild the header from saveState() data,
+ * the whole tree is inserted at once and attached views see a single reset
+ */
+bool HierarchicalHeaderModel::restoreState(const QByteArray &state)
+{
+    if (m_headerModel == Q_NULLPTR)
+        return false;
+
+    QDataStream stream(state);
+    stream.setVersion(QDataStream::Qt_5_0);
+    quint32 magic = 0;
+    quint8 version = 0;
+    quint32 count = 0;
+    stream >> magic >> version >> count;
+    if (magic != HeaderModelStateMagic || version != HeaderModelStateVersion || stream.status() != QDataStream::Ok)
+        return false;
+
+    QList<QStandardItem *> items;
+    int leaf = 0;
+    QVector<int> selectedLeaves;
+    QStandardItem *arrowItem = Q_NULLPTR;
+    for (quint32 i = 0; i < count && stream.status() == QDataStream::Ok; ++i)
+        items.append(readItem(stream, leaf, selectedLeaves, arrowItem));
+    if (stream.status() != QDataStream::Ok) {
+        qDeleteAll(items);
+        return false;
+    }
+
+    beginResetModel();
+    m_applyingBatch = true;
+    m_headerModel->clear();
+    if (!items.isEmpty())
+        m_headerModel->appendRow(items);
+    m_headerList.clear();
+    getHeaderList(m_headerList);
+    m_selection.clear();
+    for (int i = 0; i < selectedLeaves.size(); ++i)
+        m_selection.select(selectedLeaves.at(i), selectedLeaves.at(i));
+    m_currentColumn = m_selection.firstColumn();
+    m_curArrowIndex = arrowItem != Q_NULLPTR ? arrowItem->index() : QModelIndex();
+    m_applyingBatch = false;
     endResetModel();
+    return true;
+}
+
+// the selected flag is written on the leaves from the selection, leaf counts them
+void HierarchicalHeaderModel::writeItem(QDataStream &stream, const QStandardItem *item, int &leaf) const
+{
+    qint8 selectedState = 0;
+    if (item->columnCount() == 0)
+        selectedState = m_selection.contains(leaf++) ? 1 : 0;
+    stream << item->text()
+           << selectedState
+           << qint8(item->data(Arrow).toInt())
+           << qint8(item->data(FilterBtnState).toInt())
+           << qint8(item->data(CanFilter).toInt())
+           << quint32(item->columnCount());
+    for (int i = 0; i < item->columnCount(); ++i)
+        writeItem(stream, item->child(0, i), leaf);
+}
+
+QStandardItem *HierarchicalHeaderModel::readItem(QDataStream &stream, int &leaf, QVector<int> &selectedLeaves, QStandardItem *&arrowItem) const
+{
+    QString text;
+    qint8 selectedState = 0;
+    qint8 arrow = 0;
+    qint8 filterBtnState = 0;
+    qint8 canFilter = 0;
+    quint32 childCount = 0;
+    stream >> text >> selectedState >> arrow >> filterBtnState >> canFilter >> childCount;
+
+    QStandardItem *item = new QStandardItem(text);
+    // only roles that differ from the defaults are stored on the item, the selection is not
+    if (childCount == 0 && selectedState > 0)
+        selectedLeaves.append(leaf);
+    if (childCount == 0)
+        ++leaf;
+    if (arrow != 0) {
+        item->setData(QVariant(int(arrow)), Arrow);
+        if (arrow > 0)
+            arrowItem = item;
+    }
+    if (filterBtnState != 0)
+        item->setData(QVariant(int(filterBtnState)), FilterBtnState);
+    if (canFilter != 0)
+        item->setData(QVariant(int(canFilter)), CanFilter);
+
+    QList<QStandardItem *> children;
+    for (quint32 i = 0; i < childCount && stream.status() == QDataStream::Ok; ++i)
+        children.append(readItem(stream, leaf, selectedLeaves, arrowItem));
+    if (!children.isEmpty())
+        item->appendRow(children);
+    return item;
+}
+
+struct HierarchicalHeaderModel::SchemaDiffState
+{
+    QSet<QStandardItem *> selectedItems;  // leaves
+    QStandardItem *currentItem;
+    QStandardItem *arrowItem;
+    int firstChanged;
+    int lastChanged;
+    int firstMoved;   // leaf columns inserted or moved, their selection state is repainted
+    int lastMoved;
+};
+
+static QList<QStandardItem *> childItems(const QStandardItemModel *model, const QStandardItem *parent)
+{
+    QList<QStandardItem *> items;
+    const int count = parent != Q_NULLPTR ? parent->columnCount() : model->columnCount();
+    for (int i = 0; i < count; ++i)
+        items.append(parent != Q_NULLPTR ? parent->child(0, i) : model->item(0, i));
+    return items;
+}
+
+static QStandardItem *takeChild(QStandardItemModel *model, QStandardItem *parent, int column)
+{
+    const QList<QStandardItem *> &taken = parent != Q_NULLPTR ? parent->takeColumn(column) : model->takeColumn(column);
+    return taken.isEmpty() ? Q_NULLPTR : taken.first();
+}
+
+static void insertChild(QStandardItemModel *model, QStandardItem *parent, int column, QStandardItem *item)
+{
+    if (parent != Q_NULLPTR)
+        parent->insertColumn(column, {item});
+    else
+        model->insertColumn(column, {item});
+}
+
+static QStandardItem *cloneSubtree(const QStandardItem *item)
+{
+    QStandardItem *copy = item->clone();
+    for (int i = 0; i < item->columnCount(); ++i)
+        copy->appendColumn({cloneSubtree(item->child(0, i))});
+    return copy;
+}
+
+static int subtreeLeafCount(const QStandardItem *item)
+{
+    if (item->columnCount() == 0)
+        return 1;
+
+    int count = 0;
+    for (int i = 0; i < item->columnCount(); ++i)
+        count += subtreeLeafCount(item->child(0, i));
+    return count;
+}
+
+// same naming as getHeaderList
+static QString leafTitle(const QStandardItem *item, const QStandardItem *parent)
+{
+    if (parent == Q_NULLPTR)
+        return item->text();
+    return item->text() + QString("(%1)").arg(parent->text());
+}
+
+static void appendLeafTitles(QStringList &str, const QStandardItem *item, const QStandardItem *parent)
+{
+    if (item->columnCount() == 0) {
+        str.append(leafTitle(item, parent));
+        return;
+    }
+    for (int i = 0; i < item->columnCount(); ++i)
+        appendLeafTitles(str, item->child(0, i), item);
+}
+
+static void appendLeafItems(QList<QStandardItem *> &leaves, QStandardItem *item)
+{
+    if (item->columnCount() == 0) {
+        leaves.append(item);
+        return;
+    }
+    for (int i = 0; i < item->columnCount(); ++i)
+        appendLeafItems(leaves, item->child(0, i));
+}
+
+static QList<QStandardItem *> leafItems(const QStandardItemModel *model)
+{
+    QList<QStandardItem *> leaves;
+    for (int i = 0; i < model->columnCount(); ++i)
+        appendLeafItems(leaves, model->item(0, i));
+    return leaves;
+}
+
+static bool isWithin(const QStandardItem *item, const QStandardItem *root)
+{
+    for (; item != Q_NULLPTR; item = item->parent()) {
+        if (item == root)
+            return true;
+    }
+    return false;
+}
+
+/**
+ * @brief siblingKeys key of each sibling, NodeKey or the title; groups and leaves never match
+ * and repeated keys are numbered so every sibling stays distinct
+ */
+static QStringList siblingKeys(const QList<QStandardItem *> &items)
+{
+    QStringList keys;
+    QHash<QString, int> seen;
+    for (const QStandardItem *item : items) {
+        const QVariant &nodeKey = item->data(HierarchicalHeaderModel::NodeKey);
+        QString key = nodeKey.isValid() ? nodeKey.toString() : item->text();
+        if (item->columnCount() > 0)
+            key += QChar(0x1e);
+        const int occurrence = seen.value(key, 0);
+        seen.insert(key, occurrence + 1);
+        if (occurrence > 0)
+            key += QChar(0x1f) + QString::number(occurrence);
+        keys.append(key);
+    }
+    return keys;
+}
+
+/**
+ * @brief HierarchicalHeaderModel::applySchema bring the header in line with newTree (same shape as
+ * the QStandardItemModel given to the constructor) without a reset.
+ * Nodes are matched among their siblings by NodeKey, or by title when no key is set. Only the leaf
+ * columns that really change are inserted, removed or moved, renames are reported through
+ * headerDataChanged. Matched nodes keep their items, so widths, sort arrow and filter state survive.
+ * A node that changes parent is removed and inserted again.
+ * @return false for schema file headers, they are read-only
+ */
+bool HierarchicalHeaderModel::applySchema(const QStandardItemModel *newTree)
+{
+    HIERARCHICAL_HEADER_TRACE("applySchema");
+    if (m_headerModel == Q_NULLPTR || newTree == Q_NULLPTR)
+        return false;
+
+    // the selection follows its leaves through the moves
+    SchemaDiffState state;
+    state.currentItem = Q_NULLPTR;
+    if (!m_selection.isEmpty()) {
+        const QList<QStandardItem *> &leaves = leafItems(m_headerModel);
+        const QVector<HierarchicalHeaderSelection::Range> &ranges = m_selection.ranges();
+        for (int i = 0; i < ranges.size(); ++i) {
+            for (int column = ranges.at(i).first; column <= ranges.at(i).last && column < leaves.size(); ++column)
+                state.selectedItems.insert(leaves.at(column));
+        }
+        if (m_currentColumn >= 0 && m_currentColumn < leaves.size())
+            state.currentItem = leaves.at(m_currentColumn);
+    }
+    state.arrowItem = m_headerModel->itemFromIndex(m_curArrowIndex);
+    state.firstChanged = INT_MAX;
+    state.lastChanged = -1;
+    state.firstMoved = INT_MAX;
+    state.lastMoved = -1;
+
+    // renames go through QStandardItem::setText, no reset for them
+    m_applyingBatch = true;
+    diffChildren(Q_NULLPTR, childItems(newTree, Q_NULLPTR), 0, state);
+    m_applyingBatch = false;
+
+    m_curArrowIndex = state.arrowItem != Q_NULLPTR ? state.arrowItem->index() : QModelIndex();
+    if (!m_selection.isEmpty()) {
+        const QList<QStandardItem *> &leaves = leafItems(m_headerModel);
+        m_selection.clear();
+        m_currentColumn = -1;
+        for (int column = 0; column < leaves.size(); ++column) {
+            if (state.selectedItems.contains(leaves.at(column)))
+                m_selection.select(column, column);
+            if (leaves.at(column) == state.currentItem)
+                m_currentColumn = column;
+        }
+        // columns that only shifted keep their selection, repaint where leaves were inserted or moved
+        if (state.lastMoved >= 0 && state.firstMoved < leaves.size())
+            emit signalSelectionChanged(state.firstMoved, qMin(state.lastMoved, leaves.size() - 1));
+    }
+    if (state.lastChanged >= 0)
+        emit headerDataChanged(Qt::Horizontal, state.firstChanged, state.lastChanged);
+    return true;
+}
+
+/**
+ * @brief HierarchicalHeaderModel::diffChildren match the children of parent (Q_NULLPTR for the top
+ * level) against newChildren, base is the leaf column of the first child
+ * @return leaf count of the updated children
+ */
+int HierarchicalHeaderModel::diffChildren(QStandardItem *parent, const QList<QStandardItem *> &newChildren, int base, SchemaDiffState &state)
+{
+    QList<QStandardItem *> oldChildren = childItems(m_headerModel, parent);
+    QStringList oldKeys = siblingKeys(oldChildren);
+    const QStringList &newKeys = siblingKeys(newChildren);
+    QSet<QString> newKeySet;
+    for (const QString &key : newKeys)
+        newKeySet.insert(key);
+
+    QVector<int> counts;
+    int end = base;
+    for (const QStandardItem *item : oldChildren) {
+        counts.append(subtreeLeafCount(item));
+        end += counts.last();
+    }
+
+    // drop nodes that are gone, from the back so the offsets in front stay valid
+    for (int i = oldChildren.size() - 1; i >= 0; --i) {
+        end -= counts.at(i);
+        if (newKeySet.contains(oldKeys.at(i)))
+            continue;
+
+        beginRemoveColumns(QModelIndex(), end, end + counts.at(i) - 1);
+        QStandardItem *removed = takeChild(m_headerModel, parent, i);
+        m_headerList.erase(m_headerList.begin() + end, m_headerList.begin() + end + counts.at(i));
+        endRemoveColumns();
+
+        QList<QStandardItem *> removedLeaves;
+        appendLeafItems(removedLeaves, removed);
+        for (QStandardItem *leaf : removedLeaves)
+            state.selectedItems.remove(leaf);
+        if (isWithin(state.currentItem, removed))
+            state.currentItem = Q_NULLPTR;
+        if (isWithin(state.arrowItem, removed))
+            state.arrowItem = Q_NULLPTR;
+        delete removed;
+        oldChildren.removeAt(i);
+        oldKeys.removeAt(i);
+        counts.remove(i);
+    }
+
+    int offset = base;
+    for (int j = 0; j < newChildren.size(); ++j) {
+        const QStandardItem *newChild = newChildren.at(j);
+        const int position = oldKeys.indexOf(newKeys.at(j), j);
+        if (position < 0) {
+            QStandardItem *item = cloneSubtree(newChild);
+            QStringList titles;
+            appendLeafTitles(titles, item, parent);
+            beginInsertColumns(QModelIndex(), offset, offset + titles.size() - 1);
+            insertChild(m_headerModel, parent, j, item);
+            for (int k = 0; k < titles.size(); ++k)
+                m_headerList.insert(offset + k, titles.at(k));
+            endInsertColumns();
+            state.firstMoved = qMin(state.firstMoved, offset);
+            state.lastMoved = qMax(state.lastMoved, offset + titles.size() - 1);
+
+            oldChildren.insert(j, item);
+            oldKeys.insert(j, newKeys.at(j));
+            counts.insert(j, titles.size());
+            offset += titles.size();
+            continue;
+        }
+
+        if (position != j) {
+            int source = offset;
+            for (int k = j; k < position; ++k)
+                source += counts.at(k);
+            beginMoveColumns(QModelIndex(), source, source + counts.at(position) - 1, QModelIndex(), offset);
+            insertChild(m_headerModel, parent, j, takeChild(m_headerModel, parent, position));
+            // source is behind offset, the block and everything it jumps over swap places in one pass
+            std::rotate(m_headerList.begin() + offset, m_headerList.begin() + source,
+                        m_headerList.begin() + source + counts.at(position));
+            endMoveColumns();
+            state.firstMoved = qMin(state.firstMoved, offset);
+            state.lastMoved = qMax(state.lastMoved, source + counts.at(position) - 1);
+
+            oldChildren.move(position, j);
+            oldKeys.move(position, j);
+            counts.move(position, j);
+        }
+
+        QStandardItem *item = oldChildren.at(j);
+        if (item->text() != newChild->text()) {
+            item->setText(newChild->text());
+            state.firstChanged = qMin(state.firstChanged, offset);
+            state.lastChanged = qMax(state.lastChanged, offset + counts.at(j) - 1);
+        }
+        if (item->columnCount() > 0) {
+            counts[j] = diffChildren(item, childItems(Q_NULLPTR, newChild), offset, state);
+        } else {
+            // a renamed parent changes the suffix of its leaves
+            const QString &title = leafTitle(item, parent);
+            if (m_headerList.at(offset) != title) {
+                m_headerList[offset] = title;
+                state.firstChanged = qMin(state.firstChanged, offset);
+                state.lastChanged = qMax(state.lastChanged, offset);
+            }
+        }
+        offset += counts.at(j);
+    }
+    return offset - base;
 }
 
 QString HierarchicalHeaderModel::getSectionTitle(int column, int sonColumn)
 {
-    if (column < 0 || column >= m_headerModel->columnCount())
+    QAbstractItemModel *model = sourceModel();
+    if (model == Q_NULLPTR || column < 0 || column >= model->columnCount())
         return "";
-    QStandardItem *headerItem = m_headerModel->item(0, column);
+    const QModelIndex &headerIndex = model->index(0, column);
     if (sonColumn < 0) {
-        return headerItem->text();
+        return headerIndex.data().toString();
     } else {
-        if (headerItem == Q_NULLPTR || sonColumn >= headerItem->columnCount())
+        if (sonColumn >= model->columnCount(headerIndex))
             return "";
-        QStandardItem *childItem = headerItem->child(0, sonColumn);
-        if (childItem != Q_NULLPTR) {
-            return childItem->text();
+        const QModelIndex &childIndex = model->index(0, sonColumn, headerIndex);
+        if (childIndex.isValid()) {
+            return childIndex.data().toString();
         }
     }
 
@@ -179,15 +834,23 @@ QString HierarchicalHeaderModel::getSectionTitle(int column, int sonColumn)
 
 int HierarchicalHeaderModel::getParentIndexByleafIndex(int leafIndex) const
 {
+    QAbstractItemModel *model = sourceModel();
     if (leafIndex < 0 ||
-        leafIndex >= m_headerList.count() ||
-        m_headerModel == Q_NULLPTR)
+        leafIndex >= count() ||
+        model == Q_NULLPTR)
         return -1;
 
+    if (m_schemaModel != Q_NULLPTR) {
+        // leaf and parent links are table reads
+        const HierarchicalHeaderSchemaModel::SchemaNode *node = m_schemaModel->node(m_schemaModel->leafNode(leafIndex));
+        while (node != Q_NULLPTR && node->parent >= 0)
+            node = m_schemaModel->node(node->parent);
+        return node != Q_NULLPTR ? int(node->column) : -1;
+    }
+
     int leafCount = 0;
-    for (int i = 0; i < m_headerModel->columnCount(); ++i) {
-        QStandardItem *headerItem = m_headerModel->item(0, i);
-        int childCount = headerItem->columnCount();
+    for (int i = 0; i < model->columnCount(); ++i) {
+        int childCount = model->columnCount(model->index(0, i));
         if (childCount == 0)
             childCount = 1;
 
@@ -201,7 +864,71 @@ int HierarchicalHeaderModel::getParentIndexByleafIndex(int leafIndex) const
 
 int HierarchicalHeaderModel::getSelectedColumn() const
 {
-    return m_curSelectedIndex.isValid() ? getActualColumnIndex(m_curSelectedIndex) : -1;
+    return m_selection.contains(m_currentColumn) ? m_currentColumn : m_selection.firstColumn();
+}
+
+/**
+ * @brief HierarchicalHeaderModel::selectColumns change the selection of the leaf columns first .. last,
+ * only the ranges that really change are reported through signalSelectionChanged, no reset
+ */
+void HierarchicalHeaderModel::selectColumns(int first, int last, SelectionCommand command)
+{
+    HIERARCHICAL_HEADER_TRACE("selectColumns");
+    const int columnCount = count();
+    if (columnCount == 0)
+        return;
+    first = qBound(0, first, columnCount - 1);
+    last = qBound(0, last, columnCount - 1);
+    const int low = qMin(first, last);
+    const int high = qMax(first, last);
+
+    switch (command) {
+    case Select:
+        emitSelectionChanged(m_selection.select(low, high));
+        break;
+    case Deselect:
+        emitSelectionChanged(m_selection.deselect(low, high));
+        break;
+    case Toggle:
+        emitSelectionChanged(m_selection.toggle(low, high));
+        break;
+    case ClearAndSelect:
+        if (low > 0)
+            emitSelectionChanged(m_selection.deselect(0, low - 1));
+        if (high < columnCount - 1)
+            emitSelectionChanged(m_selection.deselect(high + 1, columnCount - 1));
+        emitSelectionChanged(m_selection.select(low, high));
+        break;
+    }
+    if (command != Deselect)
+        m_currentColumn = last;
+}
+
+void HierarchicalHeaderModel::clearSelection()
+{
+    emitSelectionChanged(m_selection.clear());
+    m_currentColumn = -1;
+}
+
+bool HierarchicalHeaderModel::isColumnSelected(int column) const
+{
+    return m_selection.contains(column);
+}
+
+bool HierarchicalHeaderModel::isRangeSelected(int first, int last) const
+{
+    return m_selection.containsRange(first, last);
+}
+
+HierarchicalHeaderSelection HierarchicalHeaderModel::selection() const
+{
+    return m_selection;
+}
+
+void HierarchicalHeaderModel::emitSelectionChanged(const QVector<HierarchicalHeaderSelection::Range> &changed)
+{
+    for (int i = 0; i < changed.size(); ++i)
+        emit signalSelectionChanged(changed.at(i).first, changed.at(i).last);
 }
 
 int HierarchicalHeaderModel::getArrowIndex() const
@@ -211,25 +938,23 @@ int HierarchicalHeaderModel::getArrowIndex() const
 
 int HierarchicalHeaderModel::getArrowSortType() const
 {
-    QStandardItem *arrowItem = m_headerModel->itemFromIndex(m_curArrowIndex);
-    if (arrowItem != Q_NULLPTR) {
-        return arrowItem->data(ClickType::Arrow).toInt();
+    if (m_curArrowIndex.isValid()) {
+        return m_curArrowIndex.data(ClickType::Arrow).toInt();
     }
     return 0;
 }
 
 int HierarchicalHeaderModel::getActualColumnIndex(const QModelIndex &index) const
 {
-    if (!index.isValid())
+    QAbstractItemModel *model = sourceModel();
+    if (!index.isValid() || model == Q_NULLPTR)
         return -1;
 
     const int &end = index.parent().isValid() ? index.parent().column() : index.column();
     int result = 0;
     for (int i = 0; i < end; ++i) {
-        QStandardItem *headItem = m_headerModel->item(0, i);
-        if (headItem != Q_NULLPTR) {
-            result += headItem->columnCount() == 0 ? 1 : headItem->columnCount();
-        }
+        const int &childCount = model->columnCount(model->index(0, i));
+        result += childCount == 0 ? 1 : childCount;
     }
     if (index.parent().isValid()) {
         result += index.column();
@@ -239,13 +964,13 @@ int HierarchicalHeaderModel::getActualColumnIndex(const QModelIndex &index) cons
 
 int HierarchicalHeaderModel::rowCount(const QModelIndex &/*index*/) const
 {
-    return m_headerList.count();
+    return count();
 }
 
 int HierarchicalHeaderModel::columnCount(const QModelIndex &index) const
 {
     Q_UNUSED(index);
-    return m_headerList.count();
+    return count();
 }
 
 QVariant HierarchicalHeaderModel::data(const QModelIndex &/*index*/, int role) const
@@ -254,7 +979,10 @@ QVariant HierarchicalHeaderModel::data(const QModelIndex &/*index*/, int role) c
     {
         if (role == HierarchicalHeaderView::HorizontalHeaderDataRole || role == HierarchicalHeaderView::VerticalHeaderDataRole) {
             QVariant v;
-            v.setValue(m_headerModel);
+            if (m_schemaModel != Q_NULLPTR)
+                v.setValue(static_cast<QObject *>(m_schemaModel));
+            else
+                v.setValue(m_headerModel);
             return v;
         }
     }
@@ -266,40 +994,39 @@ bool HierarchicalHeaderModel::setData(const QModelIndex &index, const QVariant &
     return QAbstractTableModel::setData(index, value, role);
 }
 
-void HierarchicalHeaderModel::slotDataChanged(const QModelIndex &topLeft, const QModelIndex &/*bottomRight*/, const QVector<int> &/*roles*/)
+void HierarchicalHeaderModel::slotDataChanged(const QModelIndex &topLeft, const QModelIndex &/*bottomRight*/, const QVector<int> &roles)
 {
-    if (m_headerModel == Q_NULLPTR)
+    HIERARCHICAL_HEADER_TRACE("slotDataChanged");
+    QAbstractItemModel *model = sourceModel();
+    if (model == Q_NULLPTR)
         return;
 
-    beginResetModel();
-    const QVariant &selectData = m_headerModel->data(topLeft, selected);
-    if (!selectData.isNull()) {
-
-        if (selectData.toInt() > 0) {
-            if (m_curSelectedIndex.isValid() && topLeft != m_curSelectedIndex) {
-                QStandardItem *preItem = m_headerModel->itemFromIndex(m_curSelectedIndex);
-                if (preItem != Q_NULLPTR) {
-                    preItem->setData(QVariant(0), selected);
-                }
-            }
-            m_curSelectedIndex = topLeft;
+    // the selected role on a leaf is still honoured, it goes to the selection without a reset
+    if (roles.isEmpty() || roles.contains(selected)) {
+        const QVariant &selectData = model->data(topLeft, selected);
+        if (!selectData.isNull() && model->columnCount(topLeft) == 0) {
+            const int column = getActualColumnIndex(topLeft);
+            selectColumns(column, column, selectData.toInt() > 0 ? ClearAndSelect : Deselect);
         }
+        if (roles.size() == 1)
+            return;
     }
 
-    const QVariant &arrowData = m_headerModel->data(topLeft, Arrow);
+    if (!m_applyingBatch)
+        beginResetModel();
+
+    const QVariant &arrowData = model->data(topLeft, Arrow);
     if (!arrowData.isNull()) {
 
         if (arrowData.toInt() > 0) {
             if (m_curArrowIndex.isValid() && topLeft != m_curArrowIndex) {
-                QStandardItem *preItem = m_headerModel->itemFromIndex(m_curArrowIndex);
-                if (preItem != Q_NULLPTR) {
-                    preItem->setData(QVariant(0), Arrow);
-                }
+                model->setData(m_curArrowIndex, QVariant(0), Arrow);
             }
             m_curArrowIndex = topLeft;
         }
     }
-    endResetModel();
+    if (!m_applyingBatch)
+        endResetModel();
 
 }
 
@@ -329,3 +1056,17 @@ void HierarchicalHeaderModel::getHeaderList(QStringList &str, QStandardItem *chi
         }
     }
 }
+
+void HierarchicalHeaderModel::getSchemaHeaderList(QStringList &str, const QModelIndex &parent) const
+{
+    for (int i = 0; i < m_schemaModel->columnCount(parent); ++i) {
+        const QModelIndex &index = m_schemaModel->index(0, i, parent);
+        if (m_schemaModel->columnCount(index) > 0) {
+            getSchemaHeaderList(str, index);
+        } else if (parent.isValid()) {
+            str.append(index.data().toString() + QString("(%1)").arg(parent.data().toString()));
+        } else {
+            str.append(index.data().toString());
+        }
+    }
+}
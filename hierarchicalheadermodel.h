@@ -1,10 +1,15 @@
 ﻿#ifndef HIERARCHICALHEADERMODEL_H
 #define HIERARCHICALHEADERMODEL_H
 #include "hierarchicalheaderview.h"
+#include "hierarchicalheadermutationqueue.h"
+#include "hierarchicalheaderschema.h"
+#include "hierarchicalheaderselection.h"
 #include <QAbstractTableModel>
+#include <QAtomicInt>
 
 class QStandardItem;
 class QStandardItemModel;
+class QDataStream;
 
 class HierarchicalHeaderModel : public QAbstractTableModel
 {
@@ -15,17 +20,35 @@ public:
         selected = Qt::UserRole + 2,
         Arrow, /*= Qt::UserRole + 3*/ // 0 : noArrow , 1 : upArrow, 2 : downArrow
         FilterBtnState,
-        CanFilter // 0 : disabled, 1 : filter(过滤), 2 : Filtered(已过滤)
+        CanFilter, // 0 : disabled, 1 : filter(过滤), 2 : Filtered(已过滤)
+        NodeKey, // stable identity used by applySchema, the title is used when unset
+        IconName, // file or resource path of the cell icon, see HierarchicalHeaderIconCache
+        MinimumSize, // leaf size limits kept when a parent cell is resized, 0 : the view limits
+        MaximumSize
+    };
+
+    enum SelectionCommand
+    {
+        Select,
+        Deselect,
+        Toggle,
+        ClearAndSelect
     };
 public:
     HierarchicalHeaderModel(QStandardItemModel *model, QObject *parent = 0);
     HierarchicalHeaderModel(const QStringList &headerList, QObject *parent = 0);
     virtual ~HierarchicalHeaderModel();
 
-    inline int count() const { return m_headerList.count(); }
+    // read-only header served from a memory-mapped schema file
+    static HierarchicalHeaderModel *fromSchemaFile(const QString &fileName, QObject *parent = 0);
+    // header declared at compile time, see hierarchicalheaderstaticschema.h
+    static HierarchicalHeaderModel *fromStaticSchema(const HierarchicalHeaderSchemaModel::StaticTables &tables, QObject *parent = 0);
+    bool saveSchemaFile(const QString &fileName) const;
+
+    inline int count() const { return m_schemaModel != Q_NULLPTR ? m_schemaModel->leafCount() : m_headerList.count(); }
     int modelCount();
 
-    inline QStringList headerList() const { return m_headerList; }
+    QStringList headerList() const;
     void appendColumnItem(QStandardItem *item);
     void removeColumnItem(int preIndex, int startIndex, int endIndex = -1);
 
@@ -36,10 +59,35 @@ public:
     int getParentIndexByleafIndex(int leafIndex) const;
     int getActualColumnIndex(const QModelIndex &index) const;
 
+    // the current column: the last one selected when still selected, else the first selected
     int getSelectedColumn() const;
+
+    // header selection over leaf columns, kept as an interval set; last becomes the current column
+    void selectColumns(int first, int last, SelectionCommand command = ClearAndSelect);
+    void clearSelection();
+    bool isColumnSelected(int column) const;
+    bool isRangeSelected(int first, int last) const;
+    HierarchicalHeaderSelection selection() const;
     int getArrowIndex() const;
     int getArrowSortType() const;
 
+    // thread-safe, applied in batches on the thread owning the model
+    void queueAppendColumn(const QString &title, const QStringList &children = QStringList());
+    void queueRemoveColumn(int preIndex, int startIndex, int endIndex = -1);
+    void queueSetSectionTitle(int column, const QString &value, int sonColumn = -1);
+    void queueSetColumnItemValue(int column, const QString &value);
+    void setMutationRate(int maxPerBatch, int intervalMs);
+
+    QByteArray saveState() const;
+    bool restoreState(const QByteArray &state);
+
+    bool applySchema(const QStandardItemModel *newTree);
+
+signals:
+    void signalMutationsApplied(int count);
+    // one per range of columns whose selection state changed
+    void signalSelectionChanged(int first, int last);
+
 protected:
     int rowCount(const QModelIndex &index) const;
     int columnCount(const QModelIndex &index) const;
@@ -49,13 +97,39 @@ protected:
 private:
     void slotDataChanged(const QModelIndex &topLeft, const QModelIndex &bottomRight, const QVector<int> &roles);
 
+private slots:
+    void slotDrainMutations();
+
 private:
+    HierarchicalHeaderModel(HierarchicalHeaderSchemaModel *schema, QObject *parent);
+    QAbstractItemModel *sourceModel() const;
     void getHeaderList(QStringList &str, QStandardItem *childItem = Q_NULLPTR);
+    void getSchemaHeaderList(QStringList &str, const QModelIndex &parent = QModelIndex()) const;
+
+    void appendItem(QStandardItem *item);
+    QStringList leafTitles(QStandardItem *item);
+    bool removeItems(int preIndex, int startIndex, int endIndex);
+    bool setItemValue(int column, const QString &value);
+    bool setTitle(int column, const QString &value, int sonColumn);
+    void queueMutation(const HierarchicalHeaderMutation &mutation);
+    struct SchemaDiffState;
+    int diffChildren(QStandardItem *parent, const QList<QStandardItem *> &newChildren, int base, SchemaDiffState &state);
+    void writeItem(QDataStream &stream, const QStandardItem *item, int &leaf) const;
+    QStandardItem *readItem(QDataStream &stream, int &leaf, QVector<int> &selectedLeaves, QStandardItem *&arrowItem) const;
+    void emitSelectionChanged(const QVector<HierarchicalHeaderSelection::Range> &changed);
 
-    QModelIndex m_curSelectedIndex;
+    HierarchicalHeaderSelection m_selection;
+    int m_currentColumn;
     QModelIndex m_curArrowIndex;
     QStandardItemModel *m_headerModel;
+    HierarchicalHeaderSchemaModel *m_schemaModel;
     QStringList m_headerList;
+
+    HierarchicalHeaderMutationQueue m_mutations;
+    QAtomicInt m_drainScheduled;
+    int m_mutationBatchSize;
+    int m_mutationInterval;
+    bool m_applyingBatch;
 };
 
 #endif // HIERARCHICALHEADERMODEL_H
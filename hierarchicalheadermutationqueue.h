@@ -0,0 +1,109 @@
+#ifndef HIERARCHICAL_HEADER_MUTATION_QUEUE_H
+#define HIERARCHICAL_HEADER_MUTATION_QUEUE_H
+
+#include <QAtomicPointer>
+#include <QString>
+#include <QStringList>
+
+struct HierarchicalHeaderMutation
+{
+    enum Type
+    {
+        AppendColumn,
+        RemoveColumn,
+        SetSectionTitle,
+        SetColumnItemValue
+    };
+
+    Type type;
+    int column;      // top column, preIndex for RemoveColumn
+    int sonColumn;   // child column, startIndex for RemoveColumn
+    int endIndex;
+    QString title;
+    QStringList children;
+};
+
+/**
+ * @brief The HierarchicalHeaderMutationQueue class lock-free multi producer, single consumer
+ * queue (intrusive Vyukov queue). push() may be called from any thread, pop() only from the
+ * thread owning the model.
+ */
+class HierarchicalHeaderMutationQueue
+{
+public:
+    HierarchicalHeaderMutationQueue() :
+        m_tail(&m_stub)
+    {
+        m_stub.next.storeRelease(Q_NULLPTR);
+        m_head.storeRelease(&m_stub);
+    }
+
+    ~HierarchicalHeaderMutationQueue()
+    {
+        HierarchicalHeaderMutation mutation;
+        while (pop(mutation)) {
+        }
+    }
+
+    void push(const HierarchicalHeaderMutation &mutation)
+    {
+        Node *node = new Node;
+        node->value = mutation;
+        push(node);
+    }
+
+    bool pop(HierarchicalHeaderMutation &mutation)
+    {
+        Node *tail = m_tail;
+        Node *next = tail->next.loadAcquire();
+        if (tail == &m_stub) {
+            if (next == Q_NULLPTR)
+                return false;
+            m_tail = next;
+            tail = next;
+            next = next->next.loadAcquire();
+        }
+
+        if (next == Q_NULLPTR) {
+            // a producer swapped the head but did not link its node yet
+            if (tail != m_head.loadAcquire())
+                return false;
+            push(&m_stub);
+            next = tail->next.loadAcquire();
+            if (next == Q_NULLPTR)
+                return false;
+        }
+
+        m_tail = next;
+        mutation = tail->value;
+        delete tail;
+        return true;
+    }
+
+    bool isEmpty() const
+    {
+        return m_tail == &m_stub && m_stub.next.loadAcquire() == Q_NULLPTR;
+    }
+
+private:
+    struct Node
+    {
+        QAtomicPointer<Node> next;
+        HierarchicalHeaderMutation value;
+    };
+
+    void push(Node *node)
+    {
+        node->next.storeRelease(Q_NULLPTR);
+        Node *prev = m_head.fetchAndStoreAcqRel(node);
+        prev->next.storeRelease(node);
+    }
+
+    QAtomicPointer<Node> m_head;
+    Node *m_tail;
+    Node m_stub;
+
+    Q_DISABLE_COPY(HierarchicalHeaderMutationQueue)
+};
+
+#endif // HIERARCHICAL_HEADER_MUTATION_QUEUE_H
@@ -0,0 +1,339 @@
+#include "hierarchicalheaderrenderer.h"
+#include "hierarchicalheadertrace.h"
+
+#include <QPagedPaintDevice>
+#include <QPainter>
+#include <QPolygon>
+#include <QRunnable>
+#include <QThread>
+#include <QThreadPool>
+
+namespace {
+
+class TileJob : public QRunnable
+{
+public:
+    TileJob(const HierarchicalHeaderRenderer *renderer, const QRect &source, qreal scale, QImage *image) :
+        m_renderer(renderer), m_source(source), m_scale(scale), m_image(image)
+    {
+    }
+
+    void run() override
+    {
+        HIERARCHICAL_HEADER_TRACE("renderTile");
+        *m_image = m_renderer->renderImage(m_source, m_scale);
+    }
+
+private:
+    const HierarchicalHeaderRenderer *m_renderer;
+    QRect m_source;
+    qreal m_scale;
+    QImage *m_image;
+};
+
+} // namespace
+
+HierarchicalHeaderRenderer::HierarchicalHeaderRenderer() :
+    m_leafAlignment(Qt::AlignCenter),
+    m_headerAlignment(Qt::AlignCenter),
+    m_filterButtons(false),
+    m_threadCount(0)
+{
+    m_colors = {
+        QColor(255, 204, 153, 200),
+        QColor(240, 240, 240, 200),
+        QColor(210, 210, 210),
+        QColor(0, 0, 0),
+        QColor(229, 243, 255, 220),
+        QColor(255, 236, 139, 220)
+    };
+}
+
+HierarchicalHeaderRenderer::HierarchicalHeaderRenderer(const HierarchicalHeaderLayout &layout) :
+    HierarchicalHeaderRenderer()
+{
+    m_layout = layout;
+}
+
+void HierarchicalHeaderRenderer::setLayout(const HierarchicalHeaderLayout &layout)
+{
+    m_layout = layout;
+}
+
+HierarchicalHeaderLayout HierarchicalHeaderRenderer::layout() const
+{
+    return m_layout;
+}
+
+void HierarchicalHeaderRenderer::setColor(HierarchicalHeaderView::ColorRole role, const QColor &color)
+{
+    if (role >= m_colors.size())
+        return;
+    m_colors[role] = color;
+}
+
+QColor HierarchicalHeaderRenderer::color(HierarchicalHeaderView::ColorRole role) const
+{
+    if (role >= m_colors.size())
+        return QColor(255, 255, 255);
+    return m_colors.at(role);
+}
+
+void HierarchicalHeaderRenderer::setFont(const QFont &font)
+{
+    m_font = font;
+}
+
+void HierarchicalHeaderRenderer::setLeafAlignment(Qt::Alignment alignment)
+{
+    m_leafAlignment = alignment;
+}
+
+void HierarchicalHeaderRenderer::setHeaderAlignment(Qt::Alignment alignment)
+{
+    m_headerAlignment = alignment;
+}
+
+void HierarchicalHeaderRenderer::setFilterButtonsVisible(bool visible)
+{
+    m_filterButtons = visible;
+}
+
+void HierarchicalHeaderRenderer::setThreadCount(int count)
+{
+    m_threadCount = qMax(0, count);
+}
+
+/**
+ * @brief HierarchicalHeaderRenderer::render draw the cells of the layout that meet source,
+ * the top left of source lands on target
+ */
+void HierarchicalHeaderRenderer::render(QPainter *painter, const QRect &source, const QPointF &target, bool splitSpans) const
+{
+    if (painter == Q_NULLPTR || m_layout.isNull() || source.isEmpty())
+        return;
+
+    HIERARCHICAL_HEADER_TRACE("renderHeader");
+    painter->save();
+    painter->translate(target - QPointF(source.topLeft()));
+    painter->setClipRect(source);
+
+    // sizes follow the screen at 96 dpi whatever the device, the painter scale does the rest
+    QFont font(m_font);
+    if (font.pixelSize() <= 0)
+        font.setPixelSize(qMax(1, qRound(font.pointSizeF() * 96.0 / 72.0)));
+    painter->setFont(font);
+
+    const bool horizontal = m_layout.orientation() == Qt::Horizontal;
+    for (int id = 0; id < m_layout.nodeCount(); ++id) {
+        QRect rect = m_layout.cellRect(id);
+        if (rect.isEmpty() || !rect.intersects(source) || isCovered(id))
+            continue;
+
+        const HierarchicalHeaderLayout::Node &node = m_layout.node(id);
+        const bool leaf = m_layout.leafNode(node.firstLeaf) == id;
+        if (splitSpans && !leaf) {
+            if (horizontal) {
+                rect.setLeft(qMax(rect.left(), source.left()));
+                rect.setRight(qMin(rect.right(), source.right()));
+            } else {
+                rect.setTop(qMax(rect.top(), source.top()));
+                rect.setBottom(qMin(rect.bottom(), source.bottom()));
+            }
+        }
+
+        const QColor &background = (leaf && node.selected == 1)
+                ? color(HierarchicalHeaderView::SelectedBackGroundRole)
+                : color(HierarchicalHeaderView::UnSelectedBackGroundRole);
+        drawCell(painter, rect, node.title, leaf ? m_headerAlignment : m_leafAlignment, background,
+                 color(HierarchicalHeaderView::TextRole), color(HierarchicalHeaderView::BorderRole));
+        if (!leaf)
+            continue;
+
+        if (node.arrow > 0)
+            drawSortArrow(painter, arrowRect(rect), node.arrow);
+        if (m_filterButtons && horizontal && node.canFilter != 0)
+            drawFilterButton(painter, filterButtonRect(rect));
+    }
+    painter->restore();
+}
+
+QImage HierarchicalHeaderRenderer::renderImage(const QRect &source, qreal scale) const
+{
+    if (source.isEmpty() || scale <= 0)
+        return QImage();
+
+    QImage image((QSizeF(source.size()) * scale).toSize(), QImage::Format_ARGB32_Premultiplied);
+    image.setDevicePixelRatio(scale);
+    image.fill(Qt::white);
+    QPainter painter(&image);
+    render(&painter, source);
+    return image;
+}
+
+/**
+ * @brief HierarchicalHeaderRenderer::renderTiles the whole header cut into tiles along its length,
+ * rendered by a private thread pool; the result is in header order
+ */
+QVector<QImage> HierarchicalHeaderRenderer::renderTiles(int tileLength, qreal scale) const
+{
+    QVector<QImage> tiles;
+    if (m_layout.isNull() || tileLength <= 0)
+        return tiles;
+
+    tiles.resize((m_layout.length() + tileLength - 1) / tileLength);
+    QThreadPool pool;
+    pool.setMaxThreadCount(m_threadCount > 0 ? m_threadCount : QThread::idealThreadCount());
+    for (int i = 0; i < tiles.size(); ++i) {
+        const int begin = i * tileLength;
+        pool.start(new TileJob(this, sourceRect(begin, qMin(begin + tileLength, m_layout.length())), scale, &tiles[i]));
+    }
+    pool.waitForDone();
+    return tiles;
+}
+
+/**
+ * @brief HierarchicalHeaderRenderer::pageRanges split the header in visual order at section edges;
+ * a section longer than a page gets a page of its own and is clipped
+ */
+QVector<QPair<int, int> > HierarchicalHeaderRenderer::pageRanges(int pageLength) const
+{
+    QVector<QPair<int, int> > ranges;
+    if (m_layout.isNull() || pageLength <= 0)
+        return ranges;
+
+    int begin = -1;
+    int end = 0;
+    for (int visual = 0; visual < m_layout.sectionCount(); ++visual) {
+        const int logical = m_layout.logicalIndex(visual);
+        if (logical < 0)
+            continue;
+        const HierarchicalHeaderLayout::Section &section = m_layout.section(logical);
+        if (section.hidden || section.size <= 0)
+            continue;
+
+        if (begin < 0) {
+            begin = section.position;
+        } else if (section.position + section.size - begin > pageLength) {
+            ranges.append(qMakePair(begin, end));
+            begin = section.position;
+        }
+        end = section.position + section.size;
+    }
+    if (begin >= 0)
+        ranges.append(qMakePair(begin, end));
+    return ranges;
+}
+
+bool HierarchicalHeaderRenderer::print(QPagedPaintDevice *device, qreal scale) const
+{
+    if (device == Q_NULLPTR || m_layout.isNull() || scale <= 0)
+        return false;
+
+    const bool horizontal = m_layout.orientation() == Qt::Horizontal;
+    const qreal factor = scale * (horizontal ? device->logicalDpiX() : device->logicalDpiY()) / 96.0;
+    const int pageLength = int((horizontal ? device->width() : device->height()) / factor);
+    const QVector<QPair<int, int> > &ranges = pageRanges(pageLength);
+
+    QPainter painter;
+    if (!painter.begin(device))
+        return false;
+    painter.scale(factor, factor);
+    for (int i = 0; i < ranges.size(); ++i) {
+        if (i > 0 && !device->newPage())
+            break;
+        render(&painter, sourceRect(ranges.at(i).first, ranges.at(i).second), QPointF(), true);
+    }
+    return painter.end();
+}
+
+void HierarchicalHeaderRenderer::drawCell(QPainter *painter, const QRect &rect, const QString &text, Qt::Alignment alignment,
+                                          const QColor &background, const QColor &textColor, const QColor &borderColor)
+{
+    painter->fillRect(rect, background);
+    drawCellText(painter, rect, text, alignment, textColor, borderColor);
+}
+
+void HierarchicalHeaderRenderer::drawCellText(QPainter *painter, const QRect &rect, const QString &text, Qt::Alignment alignment,
+                                              const QColor &textColor, const QColor &borderColor, int textIndent)
+{
+    painter->save();
+    painter->setBrush(Qt::NoBrush);
+    painter->setPen(textColor);
+    painter->drawText(rect.adjusted(textIndent, 0, 0, 0), text, QTextOption(alignment));
+    painter->setPen(borderColor);
+    painter->drawRect(rect.adjusted(-1, -1, -1, -1));
+    painter->restore();
+}
+
+// 1 : down, 2 : up; the shape of the style indicator, drawn without the style
+void HierarchicalHeaderRenderer::drawSortArrow(QPainter *painter, const QRect &arrowRect, int type)
+{
+    QPolygon triangle;
+    if (type == 1) {
+        triangle << arrowRect.topLeft() << arrowRect.topRight()
+                 << QPoint(arrowRect.center().x(), arrowRect.bottom());
+    } else {
+        triangle << arrowRect.bottomLeft() << arrowRect.bottomRight()
+                 << QPoint(arrowRect.center().x(), arrowRect.top());
+    }
+    painter->save();
+    painter->setPen(Qt::NoPen);
+    painter->setBrush(QColor(73, 179, 238));
+    painter->drawConvexPolygon(triangle);
+    painter->restore();
+}
+
+void HierarchicalHeaderRenderer::drawFilterButton(QPainter *painter, const QRect &frame, const QColor &background)
+{
+    painter->save();
+    // draw 口
+    QPen curPen(QColor(150, 153, 163), 1, Qt::SolidLine, Qt::RoundCap, Qt::MiterJoin);
+    painter->setBrush(background);
+    painter->setPen(curPen);
+    painter->drawRect(frame);
+
+    //draw ▼
+    int triangleWidth = 8;
+    int triangLength = 6;
+    int triangTop = frame.top() + (frame.height() - triangLength) / 2;
+    int triangLeft = frame.left() + (frame.width() - triangleWidth) / 2;
+    QPoint points[3] = {QPoint(triangLeft, triangTop),
+                        QPoint(triangLeft + triangleWidth, triangTop),
+                        QPoint(triangLeft + triangleWidth / 2, triangTop + triangLength)};
+    painter->setBrush(QColor(90, 90, 102));
+    painter->drawConvexPolygon(points, 3);
+    painter->restore();
+}
+
+QRect HierarchicalHeaderRenderer::arrowRect(const QRect &cellRect)
+{
+    int triangleW = 15;
+    int triLeft = cellRect.left() + ((cellRect.width() - triangleW) >> 1);
+    return QRect(triLeft, cellRect.top(), triangleW, (triangleW >> 1));
+}
+
+QRect HierarchicalHeaderRenderer::filterButtonRect(const QRect &cellRect, int bottomMargin)
+{
+    int frameSize = 16;
+    int frameTop = cellRect.top() + cellRect.height() - bottomMargin - frameSize - 2;
+    int frameLeft = cellRect.left() + cellRect.width() - frameSize - 2;
+    return QRect(frameLeft, frameTop, frameSize, frameSize);
+}
+
+// cells below a collapsed group are covered by the group cell
+bool HierarchicalHeaderRenderer::isCovered(int id) const
+{
+    for (int parent = m_layout.node(id).parent; parent >= 0; parent = m_layout.node(parent).parent) {
+        if (m_layout.node(parent).collapsed)
+            return true;
+    }
+    return false;
+}
+
+QRect HierarchicalHeaderRenderer::sourceRect(int begin, int end) const
+{
+    if (m_layout.orientation() == Qt::Horizontal)
+        return QRect(begin, 0, end - begin, m_layout.thickness());
+    return QRect(0, begin, m_layout.thickness(), end - begin);
+}
@@ -0,0 +1,76 @@
+#ifndef HIERARCHICAL_HEADER_RENDERER_H
+#define HIERARCHICAL_HEADER_RENDERER_H
+
+#include "hierarchicalheaderlayout.h"
+#include "hierarchicalheaderview.h"
+
+#include <QFont>
+#include <QImage>
+#include <QPair>
+
+class QPainter;
+class QPagedPaintDevice;
+
+/**
+ * @brief The HierarchicalHeaderRenderer class draws a header from a HierarchicalHeaderLayout
+ * snapshot, without a widget: image tiles rendered in parallel on worker threads, PDF and
+ * printer pages with the header repeated on every page.
+ * All render functions are const and only read the snapshot, they may run on any thread.
+ * The cell drawing is shared with HierarchicalHeaderView; sort arrows are drawn here instead of
+ * through the widget style, which can not be used off the GUI thread.
+ */
+class HierarchicalHeaderRenderer
+{
+public:
+    HierarchicalHeaderRenderer();
+    explicit HierarchicalHeaderRenderer(const HierarchicalHeaderLayout &layout);
+
+    void setLayout(const HierarchicalHeaderLayout &layout);
+    HierarchicalHeaderLayout layout() const;
+
+    void setColor(HierarchicalHeaderView::ColorRole role, const QColor &color);
+    QColor color(HierarchicalHeaderView::ColorRole role) const;
+    void setFont(const QFont &font);
+    void setLeafAlignment(Qt::Alignment alignment);
+    void setHeaderAlignment(Qt::Alignment alignment);
+    void setFilterButtonsVisible(bool visible);
+    // 0 uses QThread::idealThreadCount()
+    void setThreadCount(int count);
+
+    // source is in header coordinates; with splitSpans parent cells cut by source are drawn
+    // closed, with their title inside the visible part, as needed on separate pages
+    void render(QPainter *painter, const QRect &source, const QPointF &target = QPointF(), bool splitSpans = false) const;
+    QImage renderImage(const QRect &source, qreal scale = 1.0) const;
+    // tiles of tileLength pixels along the header, seamless when put side by side
+    QVector<QImage> renderTiles(int tileLength, qreal scale = 1.0) const;
+
+    // header ranges [begin, end) fitting pageLength, broken at section edges
+    QVector<QPair<int, int> > pageRanges(int pageLength) const;
+    // one page per range, scale 1 keeps the on-screen size at 96 dpi
+    bool print(QPagedPaintDevice *device, qreal scale = 1.0) const;
+
+    // drawing shared with the view
+    static void drawCell(QPainter *painter, const QRect &rect, const QString &text, Qt::Alignment alignment,
+                         const QColor &background, const QColor &textColor, const QColor &borderColor);
+    // textIndent leaves room for an icon at the leading edge, the border still goes around rect
+    static void drawCellText(QPainter *painter, const QRect &rect, const QString &text, Qt::Alignment alignment,
+                             const QColor &textColor, const QColor &borderColor, int textIndent = 0);
+    static void drawSortArrow(QPainter *painter, const QRect &arrowRect, int type);
+    static void drawFilterButton(QPainter *painter, const QRect &frame, const QColor &background = QColor(236, 237, 239));
+    static QRect arrowRect(const QRect &cellRect);
+    static QRect filterButtonRect(const QRect &cellRect, int bottomMargin = 0);
+
+private:
+    bool isCovered(int id) const;
+    QRect sourceRect(int begin, int end) const;
+
+    HierarchicalHeaderLayout m_layout;
+    QVector<QColor> m_colors;
+    QFont m_font;
+    Qt::Alignment m_leafAlignment;
+    Qt::Alignment m_headerAlignment;
+    bool m_filterButtons;
+    int m_threadCount;
+};
+
+#endif // HIERARCHICAL_HEADER_RENDERER_H
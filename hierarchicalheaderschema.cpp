@@ -0,0 +1,360 @@
+#include "hierarchicalheaderschema.h"
+#include <QFile>
+#include <cstring>
+#include <QVector>
+
+static const char SchemaMagic[4] = { 'Q', 'M', 'H', 'M' };
+static const quint32 SchemaVersion = 1;
+
+HierarchicalHeaderSchemaModel::HierarchicalHeaderSchemaModel(QObject *parent) :
+    QAbstractItemModel(parent),
+    m_file(Q_NULLPTR),
+    m_header(Q_NULLPTR),
+    m_nodes(Q_NULLPTR),
+    m_strings(Q_NULLPTR),
+    m_titles(Q_NULLPTR),
+    m_leafNodes(Q_NULLPTR)
+{
+}
+
+HierarchicalHeaderSchemaModel::~HierarchicalHeaderSchemaModel()
+{
+    close();
+}
+
+/**
+ * @brief HierarchicalHeaderSchemaModel::open map fileName read-only; only the file header is
+ * checked here, nodes and strings are bounds checked when they are read
+ */
+bool HierarchicalHeaderSchemaModel::open(const QString &fileName)
+{
+    beginResetModel();
+    close();
+
+    QFile *file = new QFile(fileName);
+    uchar *map = Q_NULLPTR;
+    if (file->open(QIODevice::ReadOnly) && file->size() >= qint64(sizeof(FileHeader)))
+        map = file->map(0, file->size());
+
+    const FileHeader *header = reinterpret_cast<const FileHeader *>(map);
+    const qint64 size = file->size();
+    bool valid = header != Q_NULLPTR
+            && memcmp(header->magic, SchemaMagic, sizeof(SchemaMagic)) == 0
+            && header->version == SchemaVersion
+            && header->topCount <= header->nodeCount
+            && header->nodesOffset % sizeof(quint32) == 0
+            && qint64(header->nodesOffset) + qint64(header->nodeCount) * qint64(sizeof(SchemaNode)) <= size
+            && header->stringsOffset % sizeof(ushort) == 0
+            && qint64(header->stringsOffset) + qint64(header->stringsSize) * qint64(sizeof(ushort)) <= size;
+    if (valid) {
+        m_file = file;
+        m_header = header;
+        m_nodes = reinterpret_cast<const SchemaNode *>(map + header->nodesOffset);
+        m_strings = reinterpret_cast<const ushort *>(map + header->stringsOffset);
+    } else {
+        delete file;
+    }
+    endResetModel();
+    return valid;
+}
+
+/**
+ * @brief HierarchicalHeaderSchemaModel::openStatic serve tables that live for the whole program,
+ * normally HierarchicalHeaderStatic::Schema<...>::tables(); nothing is copied
+ */
+bool HierarchicalHeaderSchemaModel::openStatic(const StaticTables &tables)
+{
+    beginResetModel();
+    close();
+
+    const bool valid = tables.nodes != Q_NULLPTR && tables.titles != Q_NULLPTR
+            && tables.topCount <= tables.nodeCount && tables.leafCount <= tables.nodeCount;
+    if (valid) {
+        memcpy(m_staticHeader.magic, SchemaMagic, sizeof(SchemaMagic));
+        m_staticHeader.version = SchemaVersion;
+        m_staticHeader.nodeCount = tables.nodeCount;
+        m_staticHeader.topCount = tables.topCount;
+        m_staticHeader.leafCount = tables.leafCount;
+        m_staticHeader.nodesOffset = 0;
+        m_staticHeader.stringsOffset = 0;
+        m_staticHeader.stringsSize = 0;
+        m_header = &m_staticHeader;
+        m_nodes = tables.nodes;
+        m_titles = tables.titles;
+        m_leafNodes = tables.leafNodes;
+    }
+    endResetModel();
+    return valid;
+}
+
+void HierarchicalHeaderSchemaModel::close()
+{
+    m_header = Q_NULLPTR;
+    m_nodes = Q_NULLPTR;
+    m_strings = Q_NULLPTR;
+    m_titles = Q_NULLPTR;
+    m_leafNodes = Q_NULLPTR;
+    m_overlay.clear();
+    if (m_file != Q_NULLPTR) {
+        m_file->close();
+        delete m_file;
+        m_file = Q_NULLPTR;
+    }
+}
+
+bool HierarchicalHeaderSchemaModel::isOpen() const
+{
+    return m_header != Q_NULLPTR;
+}
+
+/**
+ * @brief HierarchicalHeaderSchemaModel::write store the header tree of model (items at row 0,
+ * children as columns, like QStandardItemModel headers) as schema file
+ */
+bool HierarchicalHeaderSchemaModel::write(const QAbstractItemModel *model, const QString &fileName)
+{
+    if (model == Q_NULLPTR)
+        return false;
+
+    QVector<SchemaNode> nodes;
+    QVector<QModelIndex> indexes;
+    QVector<ushort> strings;
+
+    const int topCount = model->columnCount();
+    for (int i = 0; i < topCount; ++i)
+        indexes.append(model->index(0, i));
+
+    // breadth first, children of one parent end up next to each other
+    for (int id = 0; id < indexes.size(); ++id) {
+        const QModelIndex index = indexes.at(id);
+        const QString &text = index.data(Qt::DisplayRole).toString();
+        SchemaNode node;
+        node.parent = -1;
+        node.firstChild = 0;
+        node.childCount = model->columnCount(index);
+        node.column = index.column();
+        node.depth = 0;
+        node.firstLeaf = 0;
+        node.leafCount = 0;
+        node.titleOffset = strings.size();
+        node.titleLength = text.size();
+        for (int i = 0; i < text.size(); ++i)
+            strings.append(text.at(i).unicode());
+
+        if (node.childCount > 0) {
+            node.firstChild = indexes.size();
+            for (int i = 0; i < int(node.childCount); ++i)
+                indexes.append(model->index(0, i, index));
+        }
+        nodes.append(node);
+    }
+    for (int id = 0; id < nodes.size(); ++id) {
+        for (quint32 i = 0; i < nodes.at(id).childCount; ++i) {
+            SchemaNode &child = nodes[nodes.at(id).firstChild + i];
+            child.parent = id;
+            child.depth = nodes.at(id).depth + 1;
+        }
+    }
+
+    // leaf numbering follows the depth first order used by the header views
+    QVector<int> stack;
+    for (int i = topCount - 1; i >= 0; --i)
+        stack.append(i);
+    quint32 leaf = 0;
+    while (!stack.isEmpty()) {
+        const int id = stack.takeLast();
+        nodes[id].firstLeaf = leaf;
+        if (nodes.at(id).childCount == 0)
+            ++leaf;
+        for (int i = int(nodes.at(id).childCount) - 1; i >= 0; --i)
+            stack.append(nodes.at(id).firstChild + i);
+    }
+    for (int id = nodes.size() - 1; id >= 0; --id) {
+        if (nodes.at(id).childCount == 0)
+            nodes[id].leafCount = 1;
+        if (nodes.at(id).parent >= 0)
+            nodes[nodes.at(id).parent].leafCount += nodes.at(id).leafCount;
+    }
+
+    FileHeader header;
+    memcpy(header.magic, SchemaMagic, sizeof(SchemaMagic));
+    header.version = SchemaVersion;
+    header.nodeCount = nodes.size();
+    header.topCount = topCount;
+    header.leafCount = leaf;
+    header.nodesOffset = sizeof(FileHeader);
+    header.stringsOffset = header.nodesOffset + nodes.size() * sizeof(SchemaNode);
+    header.stringsSize = strings.size();
+
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        return false;
+    bool ok = file.write(reinterpret_cast<const char *>(&header), sizeof(header)) == qint64(sizeof(header));
+    ok = ok && file.write(reinterpret_cast<const char *>(nodes.constData()), nodes.size() * sizeof(SchemaNode))
+            == qint64(nodes.size() * sizeof(SchemaNode));
+    ok = ok && file.write(reinterpret_cast<const char *>(strings.constData()), strings.size() * sizeof(ushort))
+            == qint64(strings.size() * sizeof(ushort));
+    file.close();
+    return ok;
+}
+
+int HierarchicalHeaderSchemaModel::nodeCount() const
+{
+    return m_header != Q_NULLPTR ? int(m_header->nodeCount) : 0;
+}
+
+int HierarchicalHeaderSchemaModel::leafCount() const
+{
+    return m_header != Q_NULLPTR ? int(m_header->leafCount) : 0;
+}
+
+/**
+ * @brief HierarchicalHeaderSchemaModel::forwardChildren the children of node id lie behind it and
+ * inside the node table; checked on every step down, so walks down the tree end after nodeCount
+ * steps whatever the file holds, without a pass over all nodes in open()
+ */
+bool HierarchicalHeaderSchemaModel::forwardChildren(int id, const SchemaNode *schemaNode) const
+{
+    return schemaNode->firstChild > quint32(id)
+            && quint64(schemaNode->firstChild) + schemaNode->childCount <= m_header->nodeCount;
+}
+
+const HierarchicalHeaderSchemaModel::SchemaNode *HierarchicalHeaderSchemaModel::node(int id) const
+{
+    if (m_header == Q_NULLPTR || id < 0 || quint32(id) >= m_header->nodeCount)
+        return Q_NULLPTR;
+    return m_nodes + id;
+}
+
+/**
+ * @brief HierarchicalHeaderSchemaModel::leafNode node id of a leaf, a table read for static schemas,
+ * otherwise a binary search over the firstLeaf of the siblings on each level
+ * @return -1 if leaf is out of range
+ */
+int HierarchicalHeaderSchemaModel::leafNode(int leaf) const
+{
+    if (m_header == Q_NULLPTR || leaf < 0 || quint32(leaf) >= m_header->leafCount)
+        return -1;
+    if (m_leafNodes != Q_NULLPTR)
+        return int(m_leafNodes[leaf]);
+
+    quint32 first = 0;
+    quint32 count = m_header->topCount;
+    while (count > 0) {
+        // last sibling whose first leaf is not behind leaf
+        quint32 low = first;
+        quint32 high = first + count;
+        while (high - low > 1) {
+            const quint32 middle = low + (high - low) / 2;
+            const SchemaNode *middleNode = node(int(middle));
+            if (middleNode == Q_NULLPTR)
+                return -1;
+            if (middleNode->firstLeaf <= quint32(leaf))
+                low = middle;
+            else
+                high = middle;
+        }
+        const SchemaNode *schemaNode = node(int(low));
+        if (schemaNode == Q_NULLPTR)
+            return -1;
+        if (schemaNode->childCount == 0)
+            return int(low);
+        // children always lie behind their parent, a link back is a corrupt file and would loop
+        if (!forwardChildren(int(low), schemaNode))
+            return -1;
+        first = schemaNode->firstChild;
+        count = schemaNode->childCount;
+    }
+    return -1;
+}
+
+QString HierarchicalHeaderSchemaModel::title(int id) const
+{
+    const SchemaNode *schemaNode = node(id);
+    if (schemaNode != Q_NULLPTR && m_titles != Q_NULLPTR)
+        return QString::fromRawData(reinterpret_cast<const QChar *>(m_titles[id]), int(schemaNode->titleLength));
+    if (schemaNode == Q_NULLPTR
+            || quint64(schemaNode->titleOffset) + schemaNode->titleLength > m_header->stringsSize)
+        return QString();
+    return QString(reinterpret_cast<const QChar *>(m_strings + schemaNode->titleOffset), schemaNode->titleLength);
+}
+
+QModelIndex HierarchicalHeaderSchemaModel::index(int row, int column, const QModelIndex &parent) const
+{
+    if (m_header == Q_NULLPTR || row != 0 || column < 0)
+        return QModelIndex();
+
+    if (!parent.isValid()) {
+        if (quint32(column) >= m_header->topCount)
+            return QModelIndex();
+        return createIndex(0, column, quintptr(column));
+    }
+
+    const SchemaNode *parentNode = node(int(parent.internalId()));
+    if (parentNode == Q_NULLPTR || quint32(column) >= parentNode->childCount)
+        return QModelIndex();
+    if (!forwardChildren(int(parent.internalId()), parentNode))
+        return QModelIndex();
+    const quint64 id = quint64(parentNode->firstChild) + column;
+    return createIndex(0, column, quintptr(id));
+}
+
+QModelIndex HierarchicalHeaderSchemaModel::parent(const QModelIndex &index) const
+{
+    const SchemaNode *schemaNode = index.isValid() ? node(int(index.internalId())) : Q_NULLPTR;
+    if (schemaNode == Q_NULLPTR)
+        return QModelIndex();
+
+    // parents always lie in front of their children, walks up the tree end after nodeCount steps
+    const SchemaNode *parentNode = node(schemaNode->parent);
+    if (parentNode == Q_NULLPTR || quintptr(schemaNode->parent) >= index.internalId())
+        return QModelIndex();
+    return createIndex(0, int(parentNode->column), quintptr(schemaNode->parent));
+}
+
+int HierarchicalHeaderSchemaModel::rowCount(const QModelIndex &parent) const
+{
+    return columnCount(parent) > 0 ? 1 : 0;
+}
+
+int HierarchicalHeaderSchemaModel::columnCount(const QModelIndex &parent) const
+{
+    if (m_header == Q_NULLPTR)
+        return 0;
+    if (!parent.isValid())
+        return int(m_header->topCount);
+
+    const SchemaNode *schemaNode = node(int(parent.internalId()));
+    return schemaNode != Q_NULLPTR ? int(schemaNode->childCount) : 0;
+}
+
+QVariant HierarchicalHeaderSchemaModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid())
+        return QVariant();
+
+    const int id = int(index.internalId());
+    QHash<QPair<int, int>, QVariant>::const_iterator it = m_overlay.constFind(qMakePair(id, role));
+    if (it != m_overlay.constEnd())
+        return it.value();
+    if (role == Qt::DisplayRole || role == Qt::EditRole)
+        return title(id);
+    return QVariant();
+}
+
+bool HierarchicalHeaderSchemaModel::setData(const QModelIndex &index, const QVariant &value, int role)
+{
+    if (!index.isValid() || node(int(index.internalId())) == Q_NULLPTR)
+        return false;
+
+    if (role == Qt::EditRole)
+        role = Qt::DisplayRole;
+    m_overlay.insert(qMakePair(int(index.internalId()), role), value);
+    emit dataChanged(index, index, QVector<int>() << role);
+    return true;
+}
+
+Qt::ItemFlags HierarchicalHeaderSchemaModel::flags(const QModelIndex &index) const
+{
+    return index.isValid() ? Qt::ItemIsEnabled : Qt::NoItemFlags;
+}
@@ -0,0 +1,99 @@
+#ifndef HIERARCHICAL_HEADER_SCHEMA_H
+#define HIERARCHICAL_HEADER_SCHEMA_H
+
+#include <QAbstractItemModel>
+#include <QHash>
+#include <QPair>
+
+class QFile;
+
+/**
+ * @brief The HierarchicalHeaderSchemaModel class read-only header tree served straight from a
+ * memory-mapped schema file. Nodes and titles are read from the mapping on access, opening a
+ * schema does not depend on its size and the pages are shared between processes.
+ * State roles (selected, Arrow, ...) set by the view are kept in a small overlay.
+ *
+ * File layout, native byte order:
+ *   FileHeader | SchemaNode[nodeCount] | UTF-16 string table
+ * Nodes are stored breadth first, so the children of a node are consecutive and the
+ * top level nodes are 0 .. topCount - 1.
+ * openStatic() serves the same node layout from tables built at compile time
+ * (hierarchicalheaderstaticschema.h), titles then come from one literal per node.
+ */
+class HierarchicalHeaderSchemaModel : public QAbstractItemModel
+{
+    Q_OBJECT
+public:
+    struct FileHeader
+    {
+        char magic[4];
+        quint32 version;
+        quint32 nodeCount;
+        quint32 topCount;
+        quint32 leafCount;
+        quint32 nodesOffset;
+        quint32 stringsOffset;
+        quint32 stringsSize;   // in UTF-16 code units
+    };
+
+    struct SchemaNode
+    {
+        qint32 parent;
+        quint32 firstChild;
+        quint32 childCount;
+        quint32 column;
+        quint32 depth;
+        quint32 firstLeaf;
+        quint32 leafCount;
+        quint32 titleOffset;   // in UTF-16 code units
+        quint32 titleLength;
+    };
+
+    struct StaticTables
+    {
+        quint32 nodeCount;
+        quint32 topCount;
+        quint32 leafCount;
+        const SchemaNode *nodes;
+        const char16_t *const *titles;  // per node, titleLength code units
+        const quint32 *leafNodes;       // node id of every leaf
+    };
+
+    explicit HierarchicalHeaderSchemaModel(QObject *parent = Q_NULLPTR);
+    ~HierarchicalHeaderSchemaModel();
+
+    bool open(const QString &fileName);
+    bool openStatic(const StaticTables &tables);
+    void close();
+    bool isOpen() const;
+
+    static bool write(const QAbstractItemModel *model, const QString &fileName);
+
+    int nodeCount() const;
+    int leafCount() const;
+    const SchemaNode *node(int id) const;
+    int leafNode(int leaf) const;
+    QString title(int id) const;
+
+    QModelIndex index(int row, int column, const QModelIndex &parent = QModelIndex()) const;
+    QModelIndex parent(const QModelIndex &index) const;
+    int rowCount(const QModelIndex &parent = QModelIndex()) const;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const;
+    bool setData(const QModelIndex &index, const QVariant &value, int role = Qt::EditRole);
+    Qt::ItemFlags flags(const QModelIndex &index) const;
+
+private:
+    bool forwardChildren(int id, const SchemaNode *schemaNode) const;
+
+    QFile *m_file;
+    const FileHeader *m_header;
+    const SchemaNode *m_nodes;
+    const ushort *m_strings;
+    const char16_t *const *m_titles;
+    const quint32 *m_leafNodes;
+    FileHeader m_staticHeader;
+    QHash<QPair<int, int>, QVariant> m_overlay;
+};
+
+#endif // HIERARCHICAL_HEADER_SCHEMA_H
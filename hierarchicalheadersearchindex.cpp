@@ -0,0 +1,264 @@
+#include "hierarchicalheadersearchindex.h"
+#include <QSet>
+#include <algorithm>
+
+static const int MaxGramLength = 3;
+
+static inline quint64 gramKey(const QString &text, int position, int length)
+{
+    quint64 key = quint64(length) << 48;
+    for (int i = 0; i < length; ++i)
+        key |= quint64(text.at(position + i).unicode()) << (16 * (2 - i));
+    return key;
+}
+
+HierarchicalHeaderSearchIndex::HierarchicalHeaderSearchIndex(QObject *parent) :
+    QObject(parent),
+    m_deadCount(0),
+    m_valid(false),
+    m_idsValid(false)
+{
+}
+
+void HierarchicalHeaderSearchIndex::setModel(QAbstractItemModel *model)
+{
+    if (m_model == model)
+        return;
+
+    if (!m_model.isNull())
+        m_model->disconnect(this);
+    m_model = model;
+    if (!m_model.isNull()) {
+        connect(model, SIGNAL(modelReset()), this, SLOT(slotReset()));
+        connect(model, SIGNAL(layoutChanged()), this, SLOT(slotReset()));
+        connect(model, SIGNAL(dataChanged(QModelIndex, QModelIndex, QVector<int>)),
+                this, SLOT(slotDataChanged(QModelIndex, QModelIndex, QVector<int>)));
+        connect(model, SIGNAL(columnsInserted(QModelIndex, int, int)), this, SLOT(slotColumnsInserted(QModelIndex, int, int)));
+        connect(model, SIGNAL(columnsAboutToBeRemoved(QModelIndex, int, int)),
+                this, SLOT(slotColumnsAboutToBeRemoved(QModelIndex, int, int)));
+        connect(model, SIGNAL(columnsRemoved(QModelIndex, int, int)), this, SLOT(slotStructureChanged()));
+        connect(model, SIGNAL(columnsMoved(QModelIndex, int, int, QModelIndex, int)), this, SLOT(slotStructureChanged()));
+    }
+    slotReset();
+}
+
+QAbstractItemModel *HierarchicalHeaderSearchIndex::model() const
+{
+    return m_model.data();
+}
+
+void HierarchicalHeaderSearchIndex::slotReset()
+{
+    m_valid = false;
+    m_idsValid = false;
+    m_lastQuery.clear();
+}
+
+void HierarchicalHeaderSearchIndex::slotStructureChanged()
+{
+    m_idsValid = false;
+}
+
+void HierarchicalHeaderSearchIndex::ensureIndex()
+{
+    if (m_valid)
+        return;
+
+    m_entries.clear();
+    m_grams.clear();
+    m_sorted.clear();
+    m_ids.clear();
+    m_deadCount = 0;
+    m_lastQuery.clear();
+    m_valid = true;
+    m_idsValid = true;
+    if (!m_model.isNull()) {
+        for (int i = 0; i < m_model->columnCount(); ++i)
+            addSubtree(m_model->index(0, i));
+    }
+}
+
+void HierarchicalHeaderSearchIndex::ensureIds()
+{
+    if (m_idsValid)
+        return;
+
+    m_ids.clear();
+    for (int id = 0; id < m_entries.size(); ++id) {
+        if (m_entries.at(id).alive && m_entries.at(id).index.isValid())
+            m_ids.insert(m_entries.at(id).index, id);
+    }
+    m_idsValid = true;
+}
+
+void HierarchicalHeaderSearchIndex::addSubtree(const QModelIndex &index)
+{
+    if (!index.isValid())
+        return;
+
+    Entry entry;
+    entry.index = index;
+    entry.text = index.data(Qt::DisplayRole).toString().toCaseFolded();
+    entry.alive = true;
+    const int id = m_entries.size();
+    m_entries.append(entry);
+    if (m_idsValid)
+        m_ids.insert(index, id);
+    indexEntry(id, true);
+
+    for (int i = 0; i < m_model->columnCount(index); ++i)
+        addSubtree(m_model->index(0, i, index));
+}
+
+void HierarchicalHeaderSearchIndex::removeSubtree(const QModelIndex &index)
+{
+    const int id = m_ids.value(index, -1);
+    if (id >= 0 && m_entries.at(id).alive) {
+        indexEntry(id, false);
+        m_entries[id].alive = false;
+        m_entries[id].index = QPersistentModelIndex();
+        m_entries[id].text.clear();
+        ++m_deadCount;
+    }
+    for (int i = 0; i < m_model->columnCount(index); ++i)
+        removeSubtree(m_model->index(0, i, index));
+}
+
+// adds or removes the grams and the prefix array slot of one entry
+void HierarchicalHeaderSearchIndex::indexEntry(int id, bool insert)
+{
+    const QString &text = m_entries.at(id).text;
+    QSet<quint64> grams;
+    for (int length = 1; length <= MaxGramLength; ++length) {
+        for (int i = 0; i + length <= text.size(); ++i)
+            grams.insert(gramKey(text, i, length));
+    }
+    for (QSet<quint64>::const_iterator it = grams.constBegin(); it != grams.constEnd(); ++it) {
+        if (insert) {
+            m_grams[*it].append(id);
+        } else {
+            QHash<quint64, QVector<int> >::iterator posting = m_grams.find(*it);
+            if (posting != m_grams.end()) {
+                posting.value().removeOne(id);
+                if (posting.value().isEmpty())
+                    m_grams.erase(posting);
+            }
+        }
+    }
+
+    const QVector<Entry> &entries = m_entries;
+    QVector<int>::iterator begin = std::lower_bound(m_sorted.begin(), m_sorted.end(), text,
+                                                    [&entries](int entry, const QString &value) {
+        return entries.at(entry).text < value;
+    });
+    if (insert) {
+        m_sorted.insert(begin, id);
+    } else {
+        for (QVector<int>::iterator it = begin; it != m_sorted.end() && entries.at(*it).text == text; ++it) {
+            if (*it == id) {
+                m_sorted.erase(it);
+                break;
+            }
+        }
+    }
+}
+
+void HierarchicalHeaderSearchIndex::slotDataChanged(const QModelIndex &topLeft, const QModelIndex &bottomRight,
+                                                    const QVector<int> &roles)
+{
+    if (!m_valid || (!roles.isEmpty() && !roles.contains(Qt::DisplayRole)))
+        return;
+
+    ensureIds();
+    for (int column = topLeft.column(); column <= bottomRight.column(); ++column) {
+        const QModelIndex &index = topLeft.sibling(0, column);
+        const int id = m_ids.value(index, -1);
+        if (id < 0)
+            continue;
+
+        const QString &text = index.data(Qt::DisplayRole).toString().toCaseFolded();
+        if (text == m_entries.at(id).text)
+            continue;
+        indexEntry(id, false);
+        m_entries[id].text = text;
+        indexEntry(id, true);
+        m_lastQuery.clear();
+    }
+}
+
+void HierarchicalHeaderSearchIndex::slotColumnsInserted(const QModelIndex &parent, int first, int last)
+{
+    m_idsValid = false;
+    if (!m_valid)
+        return;
+
+    for (int column = first; column <= last; ++column)
+        addSubtree(m_model->index(0, column, parent));
+    m_lastQuery.clear();
+}
+
+void HierarchicalHeaderSearchIndex::slotColumnsAboutToBeRemoved(const QModelIndex &parent, int first, int last)
+{
+    if (!m_valid)
+        return;
+
+    ensureIds();
+    for (int column = first; column <= last; ++column)
+        removeSubtree(m_model->index(0, column, parent));
+    m_idsValid = false;
+    m_lastQuery.clear();
+    // drop the tombstones once they outnumber the live entries
+    if (m_deadCount > m_entries.size() / 2)
+        m_valid = false;
+}
+
+// posting list of the rarest gram of text
+QVector<int> HierarchicalHeaderSearchIndex::candidates(const QString &text) const
+{
+    const int length = qMin(MaxGramLength, text.size());
+    const QVector<int> *best = Q_NULLPTR;
+    for (int i = 0; i + length <= text.size(); ++i) {
+        QHash<quint64, QVector<int> >::const_iterator it = m_grams.constFind(gramKey(text, i, length));
+        if (it == m_grams.constEnd())
+            return QVector<int>();
+        if (best == Q_NULLPTR || it.value().size() < best->size())
+            best = &it.value();
+    }
+    return best != Q_NULLPTR ? *best : QVector<int>();
+}
+
+QList<QPersistentModelIndex> HierarchicalHeaderSearchIndex::search(const QString &text, MatchMode mode)
+{
+    QList<QPersistentModelIndex> result;
+    const QString &query = text.toCaseFolded();
+    if (query.isEmpty() || m_model.isNull())
+        return result;
+
+    ensureIndex();
+    QVector<int> matches;
+    if (mode == PrefixMatch) {
+        const QVector<Entry> &entries = m_entries;
+        QVector<int>::const_iterator it = std::lower_bound(m_sorted.constBegin(), m_sorted.constEnd(), query,
+                                                           [&entries](int entry, const QString &value) {
+            return entries.at(entry).text < value;
+        });
+        for (; it != m_sorted.constEnd() && m_entries.at(*it).text.startsWith(query); ++it)
+            matches.append(*it);
+    } else {
+        const bool narrowing = !m_lastQuery.isEmpty() && query.contains(m_lastQuery);
+        const QVector<int> &pool = narrowing ? m_lastResult : candidates(query);
+        for (int i = 0; i < pool.size(); ++i) {
+            const Entry &entry = m_entries.at(pool.at(i));
+            if (entry.alive && entry.text.contains(query))
+                matches.append(pool.at(i));
+        }
+        m_lastQuery = query;
+        m_lastResult = matches;
+    }
+
+    for (int i = 0; i < matches.size(); ++i) {
+        if (m_entries.at(matches.at(i)).index.isValid())
+            result.append(m_entries.at(matches.at(i)).index);
+    }
+    return result;
+}
@@ -0,0 +1,73 @@
+#ifndef HIERARCHICAL_HEADER_SEARCH_INDEX_H
+#define HIERARCHICAL_HEADER_SEARCH_INDEX_H
+
+#include <QObject>
+#include <QPointer>
+#include <QPersistentModelIndex>
+#include <QAbstractItemModel>
+#include <QHash>
+#include <QVector>
+
+/**
+ * @brief The HierarchicalHeaderSearchIndex class prefix and substring index over the titles of
+ * every cell of a header tree (leaves and groups).
+ * Substrings are found through 1-, 2- and 3-gram posting lists, prefixes through a title ordered
+ * array. Title edits and inserted or removed subtrees update the index in place, only a reset
+ * of the header model rebuilds it.
+ */
+class HierarchicalHeaderSearchIndex : public QObject
+{
+    Q_OBJECT
+public:
+    enum MatchMode {
+        SubstringMatch,
+        PrefixMatch
+    };
+
+    explicit HierarchicalHeaderSearchIndex(QObject *parent = Q_NULLPTR);
+
+    void setModel(QAbstractItemModel *model);
+    QAbstractItemModel *model() const;
+
+    // case insensitive, the result is in no particular order
+    QList<QPersistentModelIndex> search(const QString &text, MatchMode mode = SubstringMatch);
+
+private slots:
+    void slotReset();
+    void slotStructureChanged();
+    void slotDataChanged(const QModelIndex &topLeft, const QModelIndex &bottomRight, const QVector<int> &roles);
+    void slotColumnsInserted(const QModelIndex &parent, int first, int last);
+    void slotColumnsAboutToBeRemoved(const QModelIndex &parent, int first, int last);
+
+private:
+    struct Entry
+    {
+        QPersistentModelIndex index;
+        QString text;   // case folded title
+        bool alive;
+    };
+
+    void ensureIndex();
+    void ensureIds();
+    void addSubtree(const QModelIndex &index);
+    void removeSubtree(const QModelIndex &index);
+    void indexEntry(int id, bool insert);
+    QVector<int> candidates(const QString &text) const;
+
+    QPointer<QAbstractItemModel> m_model;
+    QVector<Entry> m_entries;
+    QHash<quint64, QVector<int> > m_grams;
+    QVector<int> m_sorted;   // live entry ids ordered by title
+    int m_deadCount;
+    bool m_valid;
+
+    // model index -> entry id, rebuilt lazily after columns were inserted, removed or moved
+    QHash<QModelIndex, int> m_ids;
+    bool m_idsValid;
+
+    // a query containing the previous substring query only filters its result
+    QString m_lastQuery;
+    QVector<int> m_lastResult;
+};
+
+#endif // HIERARCHICAL_HEADER_SEARCH_INDEX_H
@@ -0,0 +1,218 @@
+#include "hierarchicalheaderselection.h"
+#include <algorithm>
+
+namespace {
+
+inline HierarchicalHeaderSelection::Range makeRange(int first, int last)
+{
+    HierarchicalHeaderSelection::Range range = { first, last };
+    return range;
+}
+
+// appends range, merged with the last one when they touch
+inline void appendRange(QVector<HierarchicalHeaderSelection::Range> &ranges, int first, int last)
+{
+    if (first > last)
+        return;
+    if (!ranges.isEmpty() && ranges.last().last + 1 >= first) {
+        ranges.last().last = qMax(ranges.last().last, last);
+        return;
+    }
+    ranges.append(makeRange(first, last));
+}
+
+} // namespace
+
+HierarchicalHeaderSelection::HierarchicalHeaderSelection()
+{
+}
+
+bool HierarchicalHeaderSelection::isEmpty() const
+{
+    return m_ranges.isEmpty();
+}
+
+int HierarchicalHeaderSelection::rangeCount() const
+{
+    return m_ranges.size();
+}
+
+int HierarchicalHeaderSelection::columnCount() const
+{
+    int count = 0;
+    for (int i = 0; i < m_ranges.size(); ++i)
+        count += m_ranges.at(i).last - m_ranges.at(i).first + 1;
+    return count;
+}
+
+QVector<HierarchicalHeaderSelection::Range> HierarchicalHeaderSelection::ranges() const
+{
+    return m_ranges;
+}
+
+int HierarchicalHeaderSelection::firstColumn() const
+{
+    return m_ranges.isEmpty() ? -1 : m_ranges.first().first;
+}
+
+bool HierarchicalHeaderSelection::contains(int column) const
+{
+    const int i = upperBound(column);
+    return i > 0 && m_ranges.at(i - 1).last >= column;
+}
+
+bool HierarchicalHeaderSelection::containsRange(int first, int last) const
+{
+    if (first > last)
+        std::swap(first, last);
+    const int i = upperBound(first);
+    return i > 0 && m_ranges.at(i - 1).last >= last;
+}
+
+QVector<HierarchicalHeaderSelection::Range> HierarchicalHeaderSelection::select(int first, int last)
+{
+    if (first > last)
+        std::swap(first, last);
+    QVector<Range> changed;
+    if (last < 0)
+        return changed;
+    first = qMax(0, first);
+
+    // ranges overlapping or touching [first, last] merge into one
+    const int begin = lowerBound(first - 1);
+    const int end = upperBound(last + 1);
+    int column = first;
+    for (int i = begin; i < end; ++i) {
+        appendRange(changed, column, m_ranges.at(i).first - 1);
+        column = qMax(column, m_ranges.at(i).last + 1);
+    }
+    appendRange(changed, column, last);
+    if (changed.isEmpty())
+        return changed;
+
+    QVector<Range> merged;
+    merged.append(makeRange(begin < end ? qMin(first, m_ranges.at(begin).first) : first,
+                            begin < end ? qMax(last, m_ranges.at(end - 1).last) : last));
+    replace(begin, end, merged);
+    return changed;
+}
+
+QVector<HierarchicalHeaderSelection::Range> HierarchicalHeaderSelection::deselect(int first, int last)
+{
+    if (first > last)
+        std::swap(first, last);
+    QVector<Range> changed;
+    const int begin = lowerBound(first);
+    const int end = upperBound(last);
+    if (begin >= end)
+        return changed;
+
+    for (int i = begin; i < end; ++i)
+        changed.append(makeRange(qMax(first, m_ranges.at(i).first), qMin(last, m_ranges.at(i).last)));
+
+    QVector<Range> rest;
+    if (m_ranges.at(begin).first < first)
+        rest.append(makeRange(m_ranges.at(begin).first, first - 1));
+    if (m_ranges.at(end - 1).last > last)
+        rest.append(makeRange(last + 1, m_ranges.at(end - 1).last));
+    replace(begin, end, rest);
+    return changed;
+}
+
+QVector<HierarchicalHeaderSelection::Range> HierarchicalHeaderSelection::toggle(int first, int last)
+{
+    if (first > last)
+        std::swap(first, last);
+    QVector<Range> changed;
+    if (last < 0)
+        return changed;
+    first = qMax(0, first);
+
+    // the gaps inside [first, last] become the selection, the parts of the ranges outside stay
+    const int begin = lowerBound(first - 1);
+    const int end = upperBound(last + 1);
+    QVector<Range> toggled;
+    if (begin < end && m_ranges.at(begin).first < first)
+        appendRange(toggled, m_ranges.at(begin).first, first - 1);
+    int column = first;
+    for (int i = begin; i < end; ++i) {
+        appendRange(toggled, column, qMin(last, m_ranges.at(i).first - 1));
+        column = qMax(column, m_ranges.at(i).last + 1);
+    }
+    appendRange(toggled, column, last);
+    if (begin < end && m_ranges.at(end - 1).last > last)
+        appendRange(toggled, last + 1, m_ranges.at(end - 1).last);
+    replace(begin, end, toggled);
+    changed.append(makeRange(first, last));
+    return changed;
+}
+
+QVector<HierarchicalHeaderSelection::Range> HierarchicalHeaderSelection::clear()
+{
+    QVector<Range> changed;
+    changed.swap(m_ranges);
+    return changed;
+}
+
+QVector<HierarchicalHeaderSelection::Range> HierarchicalHeaderSelection::removeColumns(int first, int count)
+{
+    if (count <= 0)
+        return QVector<Range>();
+
+    const QVector<Range> &changed = deselect(first, first + count - 1);
+    int i = lowerBound(first);
+    for (int j = i; j < m_ranges.size(); ++j) {
+        m_ranges[j].first -= count;
+        m_ranges[j].last -= count;
+    }
+    // the ranges on both sides of the removed columns may touch now
+    if (i > 0 && i < m_ranges.size() && m_ranges.at(i - 1).last + 1 >= m_ranges.at(i).first) {
+        m_ranges[i - 1].last = m_ranges.at(i).last;
+        m_ranges.remove(i);
+    }
+    return changed;
+}
+
+// first range ending at or after column
+int HierarchicalHeaderSelection::lowerBound(int column) const
+{
+    int low = 0;
+    int high = m_ranges.size();
+    while (low < high) {
+        const int mid = (low + high) >> 1;
+        if (m_ranges.at(mid).last < column)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+    return low;
+}
+
+// first range starting after column
+int HierarchicalHeaderSelection::upperBound(int column) const
+{
+    int low = 0;
+    int high = m_ranges.size();
+    while (low < high) {
+        const int mid = (low + high) >> 1;
+        if (m_ranges.at(mid).first <= column)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+    return low;
+}
+
+// ranges [begin, end) are replaced by ranges, moving the tail of the list once
+void HierarchicalHeaderSelection::replace(int begin, int end, const QVector<Range> &ranges)
+{
+    const int common = qMin(end - begin, ranges.size());
+    for (int i = 0; i < common; ++i)
+        m_ranges[begin + i] = ranges.at(i);
+    if (ranges.size() > common)
+        m_ranges.insert(begin + common, ranges.size() - common, Range());
+    else if (end - begin > common)
+        m_ranges.remove(begin + common, end - begin - common);
+    for (int i = common; i < ranges.size(); ++i)
+        m_ranges[begin + i] = ranges.at(i);
+}
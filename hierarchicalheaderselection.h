@@ -0,0 +1,51 @@
+#ifndef HIERARCHICAL_HEADER_SELECTION_H
+#define HIERARCHICAL_HEADER_SELECTION_H
+
+#include <QVector>
+
+/**
+ * @brief The HierarchicalHeaderSelection class selected leaf columns as a sorted list of disjoint,
+ * non adjacent ranges. Membership is a binary search over the ranges; an edit touching k ranges
+ * replaces just those k in one move of the list and returns the column ranges whose state changed,
+ * so views only repaint what was toggled.
+ */
+class HierarchicalHeaderSelection
+{
+public:
+    struct Range
+    {
+        int first;
+        int last;   // inclusive
+    };
+
+    HierarchicalHeaderSelection();
+
+    bool isEmpty() const;
+    int rangeCount() const;
+    int columnCount() const;
+    QVector<Range> ranges() const;
+    // -1 when empty
+    int firstColumn() const;
+
+    bool contains(int column) const;
+    // every column of first .. last selected
+    bool containsRange(int first, int last) const;
+
+    // each returns the ranges that changed state, first may be greater than last
+    QVector<Range> select(int first, int last);
+    QVector<Range> deselect(int first, int last);
+    QVector<Range> toggle(int first, int last);
+    QVector<Range> clear();
+
+    // columns first .. first + count - 1 were removed, the columns after them move down
+    QVector<Range> removeColumns(int first, int count);
+
+private:
+    int lowerBound(int column) const;
+    int upperBound(int column) const;
+    void replace(int begin, int end, const QVector<Range> &ranges);
+
+    QVector<Range> m_ranges;
+};
+
+#endif // HIERARCHICAL_HEADER_SELECTION_H
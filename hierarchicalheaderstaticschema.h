@@ -0,0 +1,177 @@
+#ifndef HIERARCHICAL_HEADER_STATIC_SCHEMA_H
+#define HIERARCHICAL_HEADER_STATIC_SCHEMA_H
+
+#include "hierarchicalheaderschema.h"
+
+/**
+ * Header trees fixed at compile time. The node table (same layout as a schema file), one title
+ * literal per node and the leaf -> node table are constant initialized, nothing is built at startup:
+ *
+ *   HIERARCHICAL_HEADER_TITLE(Bid, "Bid");
+ *   HIERARCHICAL_HEADER_TITLE(Px, "Px");
+ *   HIERARCHICAL_HEADER_TITLE(Qty, "Qty");
+ *   using namespace HierarchicalHeaderStatic;
+ *   typedef Schema<Group<Bid, Leaf<Px>, Leaf<Qty> >, Leaf<Px> > QuoteHeader;
+ *
+ *   HierarchicalHeaderModel *model = HierarchicalHeaderModel::fromStaticSchema(QuoteHeader::tables());
+ *
+ * C++11 does not take string literals as template arguments, titles are named by the small
+ * types HIERARCHICAL_HEADER_TITLE declares. Evaluation is recursive, keep a title under a few
+ * hundred characters and a schema under a few hundred nodes per sibling list.
+ */
+#define HIERARCHICAL_HEADER_TITLE(Name, text) \
+    struct Name { static constexpr const char16_t *title() { return u"" text; } }
+
+namespace HierarchicalHeaderStatic {
+
+typedef HierarchicalHeaderSchemaModel::SchemaNode SchemaNode;
+
+template <quint32... I> struct IndexSequence {};
+
+template <typename A, typename B> struct ConcatSequence;
+template <quint32... A, quint32... B>
+struct ConcatSequence<IndexSequence<A...>, IndexSequence<B...> >
+{
+    typedef IndexSequence<A..., (quint32(sizeof...(A)) + B)...> Type;
+};
+
+// halves on every step, the nesting stays logarithmic in the node count
+template <quint32 N> struct MakeIndexSequence
+{
+    typedef typename ConcatSequence<typename MakeIndexSequence<N / 2>::Type,
+                                    typename MakeIndexSequence<N - N / 2>::Type>::Type Type;
+};
+template <> struct MakeIndexSequence<0> { typedef IndexSequence<> Type; };
+template <> struct MakeIndexSequence<1> { typedef IndexSequence<0> Type; };
+
+constexpr quint32 titleLength(const char16_t *text, quint32 length = 0)
+{
+    return text[length] == 0 ? length : titleLength(text, length + 1);
+}
+
+/*
+ * Siblings take the ids base .. base + count - 1, then comes the child block of every sibling in
+ * turn, each laid out the same way; blocks is where the block of the current sibling starts.
+ * So the children of a node are consecutive and the top level nodes are 0 .. topCount - 1.
+ */
+template <typename... Nodes> struct List;
+
+template <> struct List<>
+{
+    static constexpr quint32 count = 0;
+    static constexpr quint32 nodeCount = 0;
+    static constexpr quint32 leafCount = 0;
+
+    static constexpr SchemaNode node(quint32, quint32, quint32, quint32, qint32, quint32, quint32)
+    {
+        return SchemaNode{ -1, 0, 0, 0, 0, 0, 0, 0, 0 };
+    }
+    static constexpr const char16_t *title(quint32, quint32, quint32, quint32) { return u""; }
+    static constexpr quint32 leafNode(quint32, quint32, quint32, quint32) { return 0; }
+};
+
+template <typename Head, typename... Tail>
+struct List<Head, Tail...>
+{
+    typedef List<Tail...> Next;
+    typedef typename Head::Children Children;
+
+    static constexpr quint32 count = 1 + Next::count;
+    static constexpr quint32 nodeCount = Head::nodeCount + Next::nodeCount;
+    static constexpr quint32 leafCount = Head::leafCount + Next::leafCount;
+
+    static constexpr SchemaNode node(quint32 id, quint32 base, quint32 column, quint32 blocks,
+                                     qint32 parent, quint32 depth, quint32 firstLeaf)
+    {
+        return id == base + column
+                ? SchemaNode{ parent, Children::count > 0 ? blocks : 0u, Children::count, column, depth,
+                              firstLeaf, Head::leafCount, 0, titleLength(Head::Title::title()) }
+                : id >= blocks && id < blocks + Head::nodeCount - 1
+                  ? Children::node(id, blocks, 0, blocks + Children::count, qint32(base + column), depth + 1, firstLeaf)
+                  : Next::node(id, base, column + 1, blocks + Head::nodeCount - 1, parent, depth, firstLeaf + Head::leafCount);
+    }
+
+    static constexpr const char16_t *title(quint32 id, quint32 base, quint32 column, quint32 blocks)
+    {
+        return id == base + column
+                ? Head::Title::title()
+                : id >= blocks && id < blocks + Head::nodeCount - 1
+                  ? Children::title(id, blocks, 0, blocks + Children::count)
+                  : Next::title(id, base, column + 1, blocks + Head::nodeCount - 1);
+    }
+
+    static constexpr quint32 leafNode(quint32 leaf, quint32 base, quint32 column, quint32 blocks)
+    {
+        return leaf >= Head::leafCount
+                ? Next::leafNode(leaf - Head::leafCount, base, column + 1, blocks + Head::nodeCount - 1)
+                : Children::count == 0
+                  ? base + column
+                  : Children::leafNode(leaf, blocks, 0, blocks + Children::count);
+    }
+};
+
+template <typename TitleType>
+struct Leaf
+{
+    typedef TitleType Title;
+    typedef List<> Children;
+    static constexpr quint32 nodeCount = 1;
+    static constexpr quint32 leafCount = 1;
+};
+
+template <typename TitleType, typename... ChildNodes>
+struct Group
+{
+    static_assert(sizeof...(ChildNodes) > 0, "a group needs children, use Leaf for a single column");
+    typedef TitleType Title;
+    typedef List<ChildNodes...> Children;
+    static constexpr quint32 nodeCount = 1 + Children::nodeCount;
+    static constexpr quint32 leafCount = Children::leafCount;
+};
+
+template <typename S, typename NodeIds, typename LeafIds> struct Tables;
+
+template <typename S, quint32... N, quint32... L>
+struct Tables<S, IndexSequence<N...>, IndexSequence<L...> >
+{
+    static constexpr SchemaNode nodes[sizeof...(N)] = { S::nodeAt(N)... };
+    static constexpr const char16_t *titles[sizeof...(N)] = { S::titleAt(N)... };
+    static constexpr quint32 leafNodes[sizeof...(L)] = { S::leafNodeAt(L)... };
+};
+
+template <typename S, quint32... N, quint32... L>
+constexpr SchemaNode Tables<S, IndexSequence<N...>, IndexSequence<L...> >::nodes[sizeof...(N)];
+template <typename S, quint32... N, quint32... L>
+constexpr const char16_t *Tables<S, IndexSequence<N...>, IndexSequence<L...> >::titles[sizeof...(N)];
+template <typename S, quint32... N, quint32... L>
+constexpr quint32 Tables<S, IndexSequence<N...>, IndexSequence<L...> >::leafNodes[sizeof...(L)];
+
+template <typename... TopNodes>
+struct Schema
+{
+    static_assert(sizeof...(TopNodes) > 0, "a header schema needs at least one column");
+    typedef List<TopNodes...> Top;
+
+    static constexpr quint32 topCount = Top::count;
+    static constexpr quint32 nodeCount = Top::nodeCount;
+    static constexpr quint32 leafCount = Top::leafCount;
+
+    static constexpr SchemaNode nodeAt(quint32 id) { return Top::node(id, 0, 0, Top::count, -1, 0, 0); }
+    static constexpr const char16_t *titleAt(quint32 id) { return Top::title(id, 0, 0, Top::count); }
+    static constexpr quint32 leafNodeAt(quint32 leaf) { return Top::leafNode(leaf, 0, 0, Top::count); }
+
+    typedef Tables<Schema, typename MakeIndexSequence<nodeCount>::Type,
+                   typename MakeIndexSequence<leafCount>::Type> Data;
+
+    static HierarchicalHeaderSchemaModel::StaticTables tables()
+    {
+        HierarchicalHeaderSchemaModel::StaticTables result = {
+            nodeCount + 0, topCount + 0, leafCount + 0, Data::nodes, Data::titles, Data::leafNodes
+        };
+        return result;
+    }
+};
+
+} // namespace HierarchicalHeaderStatic
+
+#endif // HIERARCHICAL_HEADER_STATIC_SCHEMA_H
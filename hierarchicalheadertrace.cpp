@@ -0,0 +1,136 @@
+#include "hierarchicalheadertrace.h"
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QThread>
+#include <QVector>
+
+namespace {
+
+struct TraceEvent
+{
+    const char *name;
+    char phase;
+    qint64 timestamp;   // ns since tracing was first enabled
+    quintptr thread;
+};
+
+QVector<TraceEvent> &traceEvents()
+{
+    static QVector<TraceEvent> events;
+    return events;
+}
+
+QElapsedTimer &traceClock()
+{
+    static QElapsedTimer clock;
+    return clock;
+}
+
+QAtomicInteger<quint64> tracePosition;
+
+}
+
+QAtomicInt HierarchicalHeaderTrace::s_enabled;
+
+void HierarchicalHeaderTrace::setEnabled(bool enabled, int capacity)
+{
+    if (!enabled) {
+        s_enabled.storeRelease(0);
+        return;
+    }
+    if (isEnabled())
+        return;
+
+    QVector<TraceEvent> &events = traceEvents();
+    if (events.size() != qMax(1, capacity)) {
+        events.fill(TraceEvent(), qMax(1, capacity));
+        tracePosition.storeRelease(0);
+    }
+    if (!traceClock().isValid())
+        traceClock().start();
+    s_enabled.storeRelease(1);
+}
+
+void HierarchicalHeaderTrace::clear()
+{
+    tracePosition.storeRelease(0);
+}
+
+void HierarchicalHeaderTrace::begin(const char *name)
+{
+    record(name, 'B');
+}
+
+void HierarchicalHeaderTrace::end(const char *name)
+{
+    record(name, 'E');
+}
+
+void HierarchicalHeaderTrace::instant(const char *name)
+{
+    record(name, 'i');
+}
+
+void HierarchicalHeaderTrace::record(const char *name, char phase)
+{
+    QVector<TraceEvent> &events = traceEvents();
+    if (events.isEmpty())
+        return;
+
+    // every writer owns its slot, the oldest events are overwritten once the ring is full
+    const quint64 position = tracePosition.fetchAndAddRelaxed(1);
+    TraceEvent &event = events[int(position % quint64(events.size()))];
+    event.name = name;
+    event.phase = phase;
+    event.timestamp = traceClock().nsecsElapsed();
+    event.thread = reinterpret_cast<quintptr>(QThread::currentThreadId());
+}
+
+/**
+ * @brief HierarchicalHeaderTrace::toChromeTraceJson events in the ring, oldest first, in the
+ * Chrome trace event format; best taken while tracing is disabled
+ */
+QByteArray HierarchicalHeaderTrace::toChromeTraceJson()
+{
+    const QVector<TraceEvent> &events = traceEvents();
+    const quint64 position = tracePosition.loadAcquire();
+    const quint64 capacity = quint64(events.size());
+    const quint64 first = position > capacity ? position - capacity : 0;
+    const QByteArray pid = QByteArray::number(QCoreApplication::applicationPid());
+
+    QByteArray json("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+    bool separator = false;
+    for (quint64 i = first; i < position; ++i) {
+        const TraceEvent &event = events.at(int(i % capacity));
+        if (event.name == Q_NULLPTR)
+            continue;
+        if (separator)
+            json += ',';
+        separator = true;
+        json += "\n{\"name\":\"";
+        json += event.name;
+        json += "\",\"cat\":\"header\",\"ph\":\"";
+        json += event.phase;
+        json += "\",\"ts\":";
+        json += QByteArray::number(event.timestamp / 1000.0, 'f', 3);
+        json += ",\"pid\":";
+        json += pid;
+        json += ",\"tid\":";
+        json += QByteArray::number(quint64(event.thread));
+        if (event.phase == 'i')
+            json += ",\"s\":\"t\"";
+        json += '}';
+    }
+    json += "\n]}\n";
+    return json;
+}
+
+bool HierarchicalHeaderTrace::dump(const QString &fileName)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        return false;
+    const QByteArray &json = toChromeTraceJson();
+    return file.write(json) == json.size();
+}
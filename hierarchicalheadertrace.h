@@ -0,0 +1,68 @@
+#ifndef HIERARCHICAL_HEADER_TRACE_H
+#define HIERARCHICAL_HEADER_TRACE_H
+
+#include <QAtomicInt>
+#include <QByteArray>
+#include <QString>
+
+/**
+ * @brief The HierarchicalHeaderTrace class begin/end events of the header paint and layout phases,
+ * recorded into a preallocated ring buffer and dumped as Chrome trace JSON (chrome://tracing, Perfetto).
+ * Disabled tracing costs one relaxed load per traced scope; defining QMULTIHEADER_NO_TRACE removes
+ * the scopes altogether. Event names must be string literals.
+ */
+class HierarchicalHeaderTrace
+{
+public:
+    // capacity can only change while tracing is disabled
+    static void setEnabled(bool enabled, int capacity = 65536);
+    static inline bool isEnabled() { return s_enabled.loadAcquire() != 0; }
+    static void clear();
+
+    static void begin(const char *name);
+    static void end(const char *name);
+    static void instant(const char *name);
+
+    static QByteArray toChromeTraceJson();
+    static bool dump(const QString &fileName);
+
+private:
+    static void record(const char *name, char phase);
+
+    static QAtomicInt s_enabled;
+};
+
+class HierarchicalHeaderTraceScope
+{
+public:
+    inline explicit HierarchicalHeaderTraceScope(const char *name) :
+        m_name(HierarchicalHeaderTrace::isEnabled() ? name : Q_NULLPTR)
+    {
+        if (m_name != Q_NULLPTR)
+            HierarchicalHeaderTrace::begin(m_name);
+    }
+
+    inline ~HierarchicalHeaderTraceScope()
+    {
+        if (m_name != Q_NULLPTR)
+            HierarchicalHeaderTrace::end(m_name);
+    }
+
+private:
+    Q_DISABLE_COPY(HierarchicalHeaderTraceScope)
+    const char *m_name;
+};
+
+#ifndef QMULTIHEADER_NO_TRACE
+#define HIERARCHICAL_HEADER_TRACE_CONCAT2(a, b) a##b
+#define HIERARCHICAL_HEADER_TRACE_CONCAT(a, b) HIERARCHICAL_HEADER_TRACE_CONCAT2(a, b)
+#define HIERARCHICAL_HEADER_TRACE(name) \
+    HierarchicalHeaderTraceScope HIERARCHICAL_HEADER_TRACE_CONCAT(traceScope, __LINE__)(name)
+#define HIERARCHICAL_HEADER_TRACE_INSTANT(name) \
+    do { if (HierarchicalHeaderTrace::isEnabled()) HierarchicalHeaderTrace::instant(name); } while (0)
+#else
+#define HIERARCHICAL_HEADER_TRACE(name) do { } while (0)
+#define HIERARCHICAL_HEADER_TRACE_INSTANT(name) do { } while (0)
+#endif
+
+#endif // HIERARCHICAL_HEADER_TRACE_H
@@ -1,9 +1,33 @@
 #include "hierarchicalheaderview.h"
+#include "hierarchicalheaderlayout.h"
+#include "hierarchicalrowgroups.h"
+#include "hierarchicalheadersearchindex.h"
+#include "hierarchicalheaderaggregates.h"
+#include "hierarchicalheadertrace.h"
+#include "hierarchicalheaderrenderer.h"
+#include "hierarchicalheadericoncache.h"
 #include <QPainter>
 #include <QAbstractItemModel>
 #include <QPointer>
 #include <QVariant>
 #include <QMouseEvent>
+#include <QPaintEvent>
+#include <QSet>
+#include <QBasicTimer>
+#include <QTimerEvent>
+#include <QHash>
+#include <QApplication>
+#include <climits>
+#include <QDataStream>
+#include <QLineEdit>
+#include <QLocale>
+#include <QtMath>
+#include <QAbstractItemView>
+#include <algorithm>
+
+static const quint32 HeaderViewStateMagic = 0x514d4856; // "QMHV"
+static const quint8 HeaderViewStateVersion = 1;
+static const int IconMargin = 3;
 
 class HierarchicalHeaderView :: private_data
 {
@@ -12,6 +36,10 @@ class HierarchicalHeaderView :: private_data
     bool m_canFilter;
     bool m_canSort;
     QVector<QColor> m_colors;
+    int m_simplifiedWidth;
+    int m_overviewWidth;
+    bool m_groupsCollapsible;
+    QSet<QPersistentModelIndex> m_collapsed;
 
 signals:
     void signalHeaderDataChange(int logicalIndex);
@@ -19,17 +47,139 @@ signals:
 public:
     QPointer<QAbstractItemModel> headerModel;
 
+    // flattened header tree, rebuilt lazily after structural changes of headerModel
+    struct LayoutNode
+    {
+        QModelIndex index;
+        int parent;
+        int root;
+        int column;
+        int depth;
+        int firstLeaf;
+        int leafCount;
+        bool collapsed;
+    };
+    mutable QVector<LayoutNode> m_nodes;
+    mutable QVector<int> m_leafNodes;
+    mutable QHash<QModelIndex, int> m_nodeIds;
+    mutable int m_maxDepth;
+    mutable bool m_layoutValid;
+    int m_sectionBatch;
+
+    // visual extent of every node, only needed once sections were moved
+    mutable QVector<int> m_visualFirst;
+    mutable QVector<int> m_visualLast;
+    mutable bool m_visualValid;
+
+    // offset of every cell from the top (left) of the header and the row height
+    // (column width) of parent cells, leaves take what is left of the section.
+    // Parents of one depth share the extent of their level: the tallest title of the
+    // level, or the size set for it in m_fixedLevelExtents (0 : measured)
+    mutable QVector<int> m_nodeOffsets;
+    mutable QVector<int> m_nodeExtents;
+    mutable QVector<int> m_levelExtents;
+    QVector<int> m_fixedLevelExtents;
+    mutable bool m_extentsValid;
+
+    // parent cell being dragged with the mouse
+    int m_dragNode;
+    bool m_dragActive;
+    QPoint m_dragStart;
+    int m_dropNode;
+    bool m_dropAfter;
+
+    // parent cell whose edge is dragged, its leaves share the change from their sizes at the press
+    int m_resizeNode;
+    int m_resizeStart;
+    QVector<int> m_resizeSections;
+    QVector<int> m_resizeSizes;
+
+    // hovered cell and element, repaints are collected in m_hoverDirty and flushed by m_hoverTimer
+    int m_hoverNode;
+    HierarchicalHeaderView::HitElement m_hoverElement;
+    QRect m_hoverRect;
+    QRegion m_hoverDirty;
+    QBasicTimer m_hoverTimer;
+
+    // logical index shift-click ranges start from
+    int m_selectionAnchor;
+
+    // bumped on every change that shows in a layout snapshot
+    quint64 m_layoutVersion;
+    mutable HierarchicalHeaderLayout m_snapshot;
+
+    // run-length row groups painted in front of the row labels of a vertical header
+    HierarchicalRowGroups m_rowGroups;
+    int m_rowGroupWidth;
+
+    // header search, m_searchMatches is in display order; m_searchStale is set when the
+    // header changed and the query has to run again before the matches are used
+    HierarchicalHeaderSearchIndex *m_searchIndex;
+    QString m_searchText;
+    HierarchicalHeaderView::SearchMode m_searchMode;
+    QVector<QPersistentModelIndex> m_searchMatches;
+    int m_searchCurrent;
+    bool m_searchStale;
+    mutable QSet<int> m_searchNodes;
+    mutable bool m_searchNodesValid;
+    QLineEdit *m_searchBox;
+
+    // aggregate band, m_nodeAggregates holds the rollup of every layout node for m_nodeAggregatesRevision
+    HierarchicalHeaderAggregates *m_aggregates;
+    HierarchicalHeaderView::AggregateFunctions m_aggregateFunctions;
+    bool m_aggregateBand;
+    int m_aggregateBandHeight;
+    mutable QVector<HierarchicalHeaderAggregates::Aggregate> m_nodeAggregates;
+    mutable quint64 m_nodeAggregatesRevision;
+    mutable bool m_nodeAggregatesValid;
+
+    // cell icons come decoded from here, paint never waits for them
+    QPointer<HierarchicalHeaderIconCache> m_iconCache;
+
     private_data() :
         m_leafAlignment(Qt::AlignCenter),
         m_headerAlignment(Qt::AlignCenter),
         m_canFilter(false),
-        m_canSort(false)
+        m_canSort(false),
+        m_simplifiedWidth(24),
+        m_overviewWidth(6),
+        m_groupsCollapsible(false),
+        m_maxDepth(0),
+        m_layoutValid(false),
+        m_sectionBatch(0),
+        m_visualValid(false),
+        m_extentsValid(false),
+        m_dragNode(-1),
+        m_dragActive(false),
+        m_dropNode(-1),
+        m_dropAfter(false),
+        m_resizeNode(-1),
+        m_resizeStart(0),
+        m_hoverNode(-1),
+        m_hoverElement(HierarchicalHeaderView::NoElement),
+        m_selectionAnchor(-1),
+        m_layoutVersion(1),
+        m_rowGroupWidth(80),
+        m_searchIndex(Q_NULLPTR),
+        m_searchMode(HierarchicalHeaderView::SubstringSearch),
+        m_searchCurrent(-1),
+        m_searchStale(false),
+        m_searchNodesValid(false),
+        m_searchBox(Q_NULLPTR),
+        m_aggregates(Q_NULLPTR),
+        m_aggregateFunctions(HierarchicalHeaderView::AggregateSum | HierarchicalHeaderView::AggregateMean),
+        m_aggregateBand(false),
+        m_aggregateBandHeight(0),
+        m_nodeAggregatesRevision(0),
+        m_nodeAggregatesValid(false)
     {
         m_colors = {
             QColor(255, 204, 153, 200),
             QColor(240, 240, 240, 200),
             QColor(210, 210, 210),
-            QColor(0, 0, 0)
+            QColor(0, 0, 0),
+            QColor(229, 243, 255, 220),
+            QColor(255, 236, 139, 220)
         };
 
     }
@@ -59,17 +209,87 @@ public:
     {   
         if (headerModel.isNull() || column < 0)
             return;
-        headerModel->setData(leafIndex(column), QVariant(1), HierarchicalHeaderModel::selected);
+        HierarchicalHeaderModel *model = hierarchicalModel();
+        if (model != Q_NULLPTR)
+            model->selectColumns(column, column);
+        else
+            headerModel->setData(leafIndex(column), QVariant(1), HierarchicalHeaderModel::selected);
     }
 
     inline void clearSelection()
     {
+        HierarchicalHeaderModel *model = hierarchicalModel();
+        if (model != Q_NULLPTR) {
+            model->clearSelection();
+            return;
+        }
         const QModelIndex &index = leafIndex(getPrevSelected());
         if (!headerModel.isNull() && index.isValid()) {
             headerModel->setData(index, QVariant(0), HierarchicalHeaderModel::selected);
         }
     }
 
+    // the selection lives in the HierarchicalHeaderModel, other header models use the selected role
+    inline bool isSelected(int logicalIndex, const QModelIndex &leafIndex) const
+    {
+        HierarchicalHeaderModel *model = hierarchicalModel();
+        if (model != Q_NULLPTR)
+            return model->isColumnSelected(logicalIndex);
+        return leafIndex.data(HierarchicalHeaderModel::selected).toInt() == 1;
+    }
+
+    // the item view icon size, the small icon metric of the style when unset
+    inline QSize iconSize(const QHeaderView *hv) const
+    {
+        const QSize &size = hv->iconSize();
+        if (size.isValid())
+            return size;
+        const int metric = hv->style()->pixelMetric(QStyle::PM_SmallIconSize, Q_NULLPTR, hv);
+        return QSize(metric, metric);
+    }
+
+    inline bool hasIcon(const QModelIndex &index) const
+    {
+        if (!index.data(HierarchicalHeaderModel::IconName).toString().isEmpty())
+            return true;
+        const QVariant &decoration = index.data(Qt::DecorationRole);
+        return decoration.type() == QVariant::String || decoration.type() == QVariant::Pixmap
+                || decoration.type() == QVariant::Image;
+    }
+
+    /**
+     * @brief cellIcon a name in IconName (or a string in Qt::DecorationRole) is looked up in the icon
+     * cache, the pixmap stays null until decoded; a pixmap or image in Qt::DecorationRole is used as is.
+     * QIcon values are not drawn, they may load from disk when asked for a pixmap.
+     * @return false if the cell has no icon
+     */
+    bool cellIcon(const QHeaderView *hv, const QModelIndex &index, QPixmap &pixmap) const
+    {
+        QString name = index.data(HierarchicalHeaderModel::IconName).toString();
+        const QVariant &decoration = index.data(Qt::DecorationRole);
+        if (name.isEmpty() && decoration.type() == QVariant::String)
+            name = decoration.toString();
+        if (!name.isEmpty()) {
+            if (m_iconCache.isNull() || m_iconCache->isFailed(name))
+                return false;
+            pixmap = m_iconCache->pixmap(name, iconSize(hv), hv->devicePixelRatioF());
+            return true;
+        }
+        if (decoration.type() == QVariant::Pixmap)
+            pixmap = qvariant_cast<QPixmap>(decoration);
+        else if (decoration.type() == QVariant::Image)
+            pixmap = QPixmap::fromImage(qvariant_cast<QImage>(decoration));
+        return !pixmap.isNull();
+    }
+
+    // icon at the leading edge of the cell, centered across it
+    inline QRect iconRect(const QHeaderView *hv, const QRect &cellRect) const
+    {
+        const QSize &size = iconSize(hv);
+        return QRect(cellRect.left() + IconMargin, cellRect.top() + (cellRect.height() - size.height()) / 2,
+                     size.width(), size.height());
+    }
+
     int setArrowType(int column)
     {
         if (headerModel.isNull() || column < 0)
@@ -129,6 +349,377 @@ public:
         if (v.isValid()) {
             headerModel = qobject_cast<QAbstractItemModel*>(v.value<QObject*>());
         }
+        invalidateLayout();
+    }
+
+    inline void touchLayout() { ++m_layoutVersion; }
+    inline void invalidateLayout() { m_layoutValid = false; m_visualValid = false; m_extentsValid = false; m_hoverNode = -1; m_searchNodesValid = false; m_nodeAggregatesValid = false; touchLayout(); }
+    inline void invalidateExtents() { m_extentsValid = false; touchLayout(); }
+    inline void invalidateVisualSpans() { m_visualValid = false; touchLayout(); }
+
+    void ensureVisualSpans(const QHeaderView *hv) const
+    {
+        ensureLayout();
+        if (m_visualValid)
+            return;
+
+        m_visualFirst.fill(INT_MAX, m_nodes.size());
+        m_visualLast.fill(-1, m_nodes.size());
+        for (int section = 0; section < m_leafNodes.size(); ++section) {
+            int visual = hv->visualIndex(section);
+            if (visual < 0)
+                continue;
+            for (int node = m_leafNodes.at(section); node >= 0; node = m_nodes.at(node).parent) {
+                m_visualFirst[node] = qMin(m_visualFirst.at(node), visual);
+                m_visualLast[node] = qMax(m_visualLast.at(node), visual);
+            }
+        }
+        m_visualValid = true;
+    }
+
+    // visual index range covered by node
+    void visualSpan(const QHeaderView *hv, int node, int &first, int &last) const
+    {
+        if (!hv->sectionsMoved()) {
+            first = m_nodes.at(node).firstLeaf;
+            last = first + m_nodes.at(node).leafCount - 1;
+            return;
+        }
+        ensureVisualSpans(hv);
+        first = m_visualFirst.at(node);
+        last = m_visualLast.at(node);
+    }
+
+    inline bool isContiguous(const QHeaderView *hv, int node) const
+    {
+        int first, last;
+        visualSpan(hv, node, first, last);
+        return last - first + 1 == m_nodes.at(node).leafCount;
+    }
+
+    // a moved leaf must stay inside its parents and must not split the groups around it
+    bool isLeafPlacementValid(const QHeaderView *hv, int logicalIndex) const
+    {
+        const int leaf = leafNode(logicalIndex);
+        if (leaf < 0)
+            return true;
+
+        const int visual = hv->visualIndex(logicalIndex);
+        const int neighbours[3] = { leaf, leafNode(hv->logicalIndex(visual - 1)), leafNode(hv->logicalIndex(visual + 1)) };
+        for (int i = 0; i < 3; ++i) {
+            if (neighbours[i] < 0)
+                continue;
+            for (int node = m_nodes.at(neighbours[i]).parent; node >= 0; node = m_nodes.at(node).parent) {
+                if (!isContiguous(hv, node))
+                    return false;
+            }
+        }
+        return true;
+    }
+
+    // sibling of dragNode under pos, dropAfter tells on which half of it pos lies
+    int dropTargetAt(const HierarchicalHeaderView *hv, const QPoint &pos, int dragNode, bool &dropAfter) const
+    {
+        int node = leafNode(hv->logicalIndexAt(pos));
+        while (node >= 0 && m_nodes.at(node).parent != m_nodes.at(dragNode).parent)
+            node = m_nodes.at(node).parent;
+        if (node < 0 || node == dragNode)
+            return -1;
+
+        const QRect &rect = spanRect(hv, node, 0, 0);
+        if (hv->orientation() == Qt::Horizontal)
+            dropAfter = pos.x() > rect.center().x();
+        else
+            dropAfter = pos.y() > rect.center().y();
+        if (hv->orientation() == Qt::Horizontal && hv->isRightToLeft())
+            dropAfter = !dropAfter;
+        return node;
+    }
+
+    void ensureLayout() const
+    {
+        if (m_layoutValid)
+            return;
+
+        HIERARCHICAL_HEADER_TRACE("ensureLayout");
+
+        m_nodes.clear();
+        m_leafNodes.clear();
+        m_nodeIds.clear();
+        m_maxDepth = 0;
+        if (!headerModel.isNull()) {
+            for (int i = 0; i < headerModel->columnCount(); ++i)
+                appendLayoutNode(headerModel->index(0, i), -1, 0);
+        }
+        for (QSet<QPersistentModelIndex>::const_iterator it = m_collapsed.constBegin(); it != m_collapsed.constEnd(); ++it) {
+            int node = m_nodeIds.value(*it, -1);
+            if (node >= 0)
+                m_nodes[node].collapsed = true;
+        }
+        m_layoutValid = true;
+    }
+
+    void appendLayoutNode(const QModelIndex &index, int parent, int depth) const
+    {
+        const int id = m_nodes.size();
+        LayoutNode node;
+        node.index = index;
+        node.parent = parent;
+        node.root = parent < 0 ? id : m_nodes.at(parent).root;
+        node.column = index.column();
+        node.depth = depth;
+        node.firstLeaf = m_leafNodes.size();
+        node.leafCount = 0;
+        node.collapsed = false;
+        m_nodes.append(node);
+        m_nodeIds.insert(index, id);
+        m_maxDepth = qMax(m_maxDepth, depth);
+
+        int childCount = headerModel->columnCount(index);
+        if (childCount == 0) {
+            m_leafNodes.append(id);
+        } else {
+            for (int i = 0; i < childCount; ++i)
+                appendLayoutNode(headerModel->index(0, i, index), id, depth + 1);
+        }
+        m_nodes[id].leafCount = m_leafNodes.size() - m_nodes.at(id).firstLeaf;
+    }
+
+    // from-scratch walk of headerModel, the reference verifyLayoutCache compares the caches against
+    struct ReferenceNode
+    {
+        QModelIndex index;
+        int parent;
+        int depth;
+        int firstLeaf;
+        int leafCount;
+    };
+
+    void collectReference(QVector<ReferenceNode> &nodes, int &leafCount, const QModelIndex &index, int parent, int depth) const
+    {
+        const int id = nodes.size();
+        ReferenceNode node;
+        node.index = index;
+        node.parent = parent;
+        node.depth = depth;
+        node.firstLeaf = leafCount;
+        node.leafCount = 0;
+        nodes.append(node);
+
+        const int childCount = headerModel->columnCount(index);
+        if (childCount == 0)
+            ++leafCount;
+        for (int i = 0; i < childCount; ++i)
+            collectReference(nodes, leafCount, headerModel->index(0, i, index), id, depth + 1);
+        nodes[id].leafCount = leafCount - nodes.at(id).firstLeaf;
+    }
+
+    bool verify(const HierarchicalHeaderView *hv, QString &error) const
+    {
+        if (headerModel.isNull())
+            return true;
+
+        // whatever is still marked valid must equal a fresh computation
+        const bool extentsValid = m_extentsValid;
+        const bool visualValid = m_visualValid;
+        ensureLayout();
+
+        QVector<ReferenceNode> reference;
+        int leafCount = 0;
+        for (int i = 0; i < headerModel->columnCount(); ++i)
+            collectReference(reference, leafCount, headerModel->index(0, i), -1, 0);
+
+        if (reference.size() != m_nodes.size()) {
+            error = QString("node count %1, expected %2").arg(m_nodes.size()).arg(reference.size());
+            return false;
+        }
+        if (leafCount != m_leafNodes.size() || leafCount != hv->count()) {
+            error = QString("leaf count %1, section count %2, expected %3").arg(m_leafNodes.size()).arg(hv->count()).arg(leafCount);
+            return false;
+        }
+        for (int id = 0; id < reference.size(); ++id) {
+            const ReferenceNode &expected = reference.at(id);
+            const LayoutNode &node = m_nodes.at(id);
+            if (node.index != expected.index || node.parent != expected.parent || node.depth != expected.depth
+                    || node.firstLeaf != expected.firstLeaf || node.leafCount != expected.leafCount) {
+                error = QString("node %1 differs from the header model").arg(id);
+                return false;
+            }
+            if (m_nodeIds.value(node.index, -1) != id) {
+                error = QString("node %1 is not found by its index").arg(id);
+                return false;
+            }
+            if (expected.leafCount == 1 && headerModel->columnCount(expected.index) == 0
+                    && m_leafNodes.at(expected.firstLeaf) != id) {
+                error = QString("section %1 does not map to node %2").arg(expected.firstLeaf).arg(id);
+                return false;
+            }
+            if (node.collapsed != m_collapsed.contains(QPersistentModelIndex(node.index))) {
+                error = QString("collapsed state of node %1 is stale").arg(id);
+                return false;
+            }
+        }
+        for (int section = 0; section < m_leafNodes.size(); ++section) {
+            if (isLeafCollapsedAway(m_leafNodes.at(section)) && !hv->isSectionHidden(section)) {
+                error = QString("section %1 is inside a collapsed group but visible").arg(section);
+                return false;
+            }
+        }
+
+        if (extentsValid) {
+            const QVector<int> &levels = measureLevelExtents(hv);
+            if (levels != m_levelExtents) {
+                error = QString("level extents are stale");
+                return false;
+            }
+            for (int id = 0; id < reference.size(); ++id) {
+                const int parent = reference.at(id).parent;
+                const int offset = parent < 0 ? 0 : m_nodeOffsets.at(parent) + m_nodeExtents.at(parent);
+                const int extent = isLeafNode(id) ? 0 : levels.at(reference.at(id).depth);
+                if (m_nodeOffsets.at(id) != offset || m_nodeExtents.at(id) != extent) {
+                    error = QString("cell extent of node %1 is stale").arg(id);
+                    return false;
+                }
+            }
+        }
+
+        if (visualValid) {
+            for (int id = 0; id < reference.size(); ++id) {
+                int first = INT_MAX;
+                int last = -1;
+                const int firstLeaf = reference.at(id).firstLeaf;
+                for (int section = firstLeaf; section < firstLeaf + reference.at(id).leafCount; ++section) {
+                    const int visual = hv->visualIndex(section);
+                    if (visual < 0)
+                        continue;
+                    first = qMin(first, visual);
+                    last = qMax(last, visual);
+                }
+                if (m_visualFirst.at(id) != first || m_visualLast.at(id) != last) {
+                    error = QString("visual span of node %1 is stale").arg(id);
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    int leafNode(int sectionIndex) const
+    {
+        ensureLayout();
+        if (sectionIndex < 0 || sectionIndex >= m_leafNodes.size())
+            return -1;
+        return m_leafNodes.at(sectionIndex);
+    }
+
+    int nodeId(const QModelIndex &index) const
+    {
+        ensureLayout();
+        return m_nodeIds.value(index, -1);
+    }
+
+    inline bool isLeafNode(int node) const
+    {
+        return m_leafNodes.at(m_nodes.at(node).firstLeaf) == node;
+    }
+
+    // the outermost collapsed ancestor of node, -1 when the whole chain is expanded
+    int collapsedAncestor(int node) const
+    {
+        int result = -1;
+        for (node = m_nodes.at(node).parent; node >= 0; node = m_nodes.at(node).parent) {
+            if (m_nodes.at(node).collapsed)
+                result = node;
+        }
+        return result;
+    }
+
+    bool setGroupCollapsed(int node, bool collapsed)
+    {
+        if (node < 0 || isLeafNode(node) || m_nodes.at(node).collapsed == collapsed)
+            return false;
+
+        m_nodes[node].collapsed = collapsed;
+        if (collapsed)
+            m_collapsed.insert(QPersistentModelIndex(m_nodes.at(node).index));
+        else
+            m_collapsed.remove(QPersistentModelIndex(m_nodes.at(node).index));
+        return true;
+    }
+
+    // a collapsed group keeps its first leaf as summary section
+    inline bool isLeafCollapsedAway(int leaf) const
+    {
+        int ancestor = collapsedAncestor(leaf);
+        return ancestor >= 0 && m_nodes.at(ancestor).firstLeaf != m_nodes.at(leaf).firstLeaf;
+    }
+
+    inline void setGroupsCollapsible(bool flag) { m_groupsCollapsible = flag; }
+    inline bool groupsCollapsible() const { return m_groupsCollapsible; }
+
+    // section changes done inside a batch skip the per section repaint in slotSectionResized
+    inline void beginSectionBatch() { ++m_sectionBatch; }
+    inline bool endSectionBatch() { return --m_sectionBatch == 0; }
+    inline bool inSectionBatch() const { return m_sectionBatch > 0; }
+
+    /**
+     * @brief distributeSizes spread total over sizes in proportion to them; a size clamped to its limit
+     * leaves its share to the others, the rounding remainder goes to the largest fractions
+     * @return the new sizes, summing to total unless the limits do not allow it
+     */
+    static QVector<int> distributeSizes(const QVector<int> &sizes, const QVector<int> &minimum,
+                                        const QVector<int> &maximum, int total)
+    {
+        const int n = sizes.size();
+        QVector<double> exact(n);
+        QVector<bool> fixed(n, false);
+        bool clamped = true;
+        while (clamped) {
+            clamped = false;
+            double weight = 0;
+            double remaining = total;
+            for (int i = 0; i < n; ++i) {
+                if (fixed.at(i))
+                    remaining -= exact.at(i);
+                else
+                    weight += qMax(1, sizes.at(i));
+            }
+            if (weight <= 0)
+                break;
+            // only the limits on the side of the larger overshoot are final, the others may resolve
+            double overshoot = 0;
+            for (int i = 0; i < n; ++i) {
+                if (fixed.at(i))
+                    continue;
+                exact[i] = remaining * qMax(1, sizes.at(i)) / weight;
+                overshoot += qBound<double>(minimum.at(i), exact.at(i), maximum.at(i)) - exact.at(i);
+            }
+            for (int i = 0; i < n; ++i) {
+                if (fixed.at(i))
+                    continue;
+                if ((overshoot >= 0 && exact.at(i) < minimum.at(i)) || (overshoot <= 0 && exact.at(i) > maximum.at(i))) {
+                    exact[i] = qBound<double>(minimum.at(i), exact.at(i), maximum.at(i));
+                    fixed[i] = true;
+                    clamped = true;
+                }
+            }
+        }
+
+        QVector<int> result(n);
+        QVector<QPair<double, int> > fractions;
+        int sum = 0;
+        for (int i = 0; i < n; ++i) {
+            result[i] = qFloor(exact.at(i));
+            sum += result.at(i);
+            if (result.at(i) < maximum.at(i))
+                fractions.append(qMakePair(exact.at(i) - result.at(i), i));
+        }
+        std::sort(fractions.begin(), fractions.end(), [](const QPair<double, int> &a, const QPair<double, int> &b) {
+            return a.first > b.first;
+        });
+        for (int i = 0; i < fractions.size() && sum < total; ++i, ++sum)
+            ++result[fractions.at(i).second];
+        return result;
     }
 
     QModelIndex findRootIndex(QModelIndex index) const
@@ -150,43 +741,10 @@ public:
         return indexes;
     }
 
-    QModelIndex findLeaf(const QModelIndex &curentIndex, int sectionIndex, int &curentLeafIndex)
-    {
-        if (curentIndex.isValid())
-        {
-            int childCount = curentIndex.model()->columnCount(curentIndex);
-            if (childCount)
-            {
-                for (int i = 0; i < childCount; ++i)
-                {
-                    QModelIndex res(findLeaf(curentIndex.model()->index(0, i, curentIndex), sectionIndex, curentLeafIndex));
-                    if (res.isValid())
-                        return res;
-                }
-            }
-            else
-            {
-                ++curentLeafIndex;
-                if (curentLeafIndex == sectionIndex)
-                    return curentIndex;
-            }
-        }
-        return QModelIndex();
-    }
-
-    QModelIndex leafIndex(int sectionIndex)
+    QModelIndex leafIndex(int sectionIndex) const
     {
-        if (!headerModel.isNull())
-        {
-            int curentLeafIndex = -1;
-            for (int i = 0; i < headerModel->columnCount(); ++i)
-            {
-                QModelIndex res(findLeaf(headerModel->index(0, i), sectionIndex, curentLeafIndex));
-                if (res.isValid())
-                    return res;
-            }
-        }
-        return QModelIndex();
+        int node = leafNode(sectionIndex);
+        return node < 0 ? QModelIndex() : m_nodes.at(node).index;
     }
 
     QModelIndexList searchLeafs(const QModelIndex& curentIndex) const
@@ -252,6 +810,11 @@ public:
         QSize size(fm.size(0, leafIndex.data(Qt::DisplayRole).toString()));
         if (leafIndex.data(Qt::UserRole).isValid())
             size.transpose();
+        if (hasIcon(leafIndex)) {
+            const QSize &icon = iconSize(hv);
+            size.rwidth() += icon.width() + 2 * IconMargin;
+            size.setHeight(qMax(size.height(), icon.height()));
+        }
         QSize decorationsSize(hv->style()->sizeFromContents(QStyle::CT_HeaderSection, &styleOptions, QSize(), hv));
         QSize emptyTextSize(fm.size(0, ""));
         return res.expandedTo(size + decorationsSize - emptyTextSize);
@@ -292,6 +855,7 @@ public:
 
         if (!painter) return;
 
+        HIERARCHICAL_HEADER_TRACE("paintCell");
         painter->save();
 
         const QRect &rect = styleOptions.rect;
@@ -302,13 +866,8 @@ public:
             if (type > 0) {
                 painter->save();
                 QStyleOptionHeader opt(styleOptions);
-
-                int triangleW = 15;
-                int triLeft = rect.left() + ((rect.width() - triangleW) >> 1);
-                QRect triangle(triLeft, rect.top(), triangleW, (triangleW >> 1));
-
                 QStyle::PrimitiveElement pe = (type == 1) ? QStyle::PE_IndicatorArrowDown : QStyle::PE_IndicatorArrowUp;
-                opt.rect = triangle;
+                opt.rect = arrowRect(rect);
                 opt.palette.setBrush(QPalette::ButtonText, QBrush(QColor(73, 179, 238)));
                 hv->style()->drawPrimitive(pe, &opt, painter, hv);
                 painter->restore();
@@ -318,32 +877,41 @@ public:
         if (cellIndex != leafIndex)
             painter->eraseRect(rect);
 
-        painter->setPen(getColor(HierarchicalHeaderView::TextRole));
-        painter->drawText(rect, styleOptions.text, QTextOption(styleOptions.textAlignment));
-        painter->setPen(getColor(HierarchicalHeaderView::BorderRole));
-        const QRect &newRect = rect.adjusted(-1, -1, -1, -1);
-        painter->drawRect(newRect);
+        int textIndent = 0;
+        QPixmap icon;
+        if (cellIcon(hv, cellIndex, icon)) {
+            const QRect &target = iconRect(hv, rect);
+            if (icon.isNull())
+                painter->fillRect(target, placeholderColor());
+            else
+                painter->drawPixmap(target.topLeft(), icon);
+            textIndent = target.width() + 2 * IconMargin;
+        }
+
+        HierarchicalHeaderRenderer::drawCellText(painter, rect, styleOptions.text, styleOptions.textAlignment,
+                                                 getColor(HierarchicalHeaderView::TextRole),
+                                                 getColor(HierarchicalHeaderView::BorderRole), textIndent);
 
         painter->restore();
     }
 
-    int paintHorizontalCell(QPainter *painter, const QHeaderView *hv, const QModelIndex &cellIndex,
+    int paintHorizontalCell(QPainter *painter, const HierarchicalHeaderView *hv, const QModelIndex &cellIndex,
                             const QModelIndex &leafIndex, int logicalLeafIndex,
                             const QStyleOptionHeader &styleOptions, const QRect &sectionRect, int top) const
     {
         QStyleOptionHeader uniopt(styleOptions);
 
-        const QVariant &variant = headerModel->data(leafIndex, HierarchicalHeaderModel::selected);
-
         QColor color;
-        if (variant.isValid() && variant.toInt() == 1)
+        if (isSelected(logicalLeafIndex, leafIndex))
             color = getColor(HierarchicalHeaderView::SelectedBackGroundRole);
         else
             color = getColor(HierarchicalHeaderView::UnSelectedBackGroundRole);
         QBrush brush(color);
         uniopt.palette.setBrush(QPalette::Window, brush);
 
-        int height = cellSize(cellIndex, hv, uniopt).height();
+        // parent rows come from the level table, the same rows hit testing uses
+        const int node = nodeId(cellIndex);
+        int height = node >= 0 ? m_nodeExtents.at(node) : cellSize(cellIndex, hv, uniopt).height();
         if (cellIndex == leafIndex) {
             uniopt.textAlignment = m_headerAlignment;
             height = sectionRect.height() - top;
@@ -395,50 +963,15 @@ public:
         int type = headerModel->data(leafIndex, HierarchicalHeaderModel::CanFilter).toInt();
         if (type == 0)
             return;
-        painter->save();
-        // draw 口
-        int frameSize = 16;
-        int frameTop = top + height - frameSize - 2;
-        int frameLeft = left + width - frameSize - 2;
-
-        QBrush curBrush(Qt::black);
-        QPen curPen(Qt::black, 1, Qt::SolidLine, Qt::RoundCap, Qt::MiterJoin);
-        QRect curRect(frameLeft, frameTop, frameSize, frameSize);
-        curPen.setColor(QColor(150, 153, 163));
-        curPen.setWidth(1);
-        curBrush.setColor(QColor(236, 237, 239));
-        painter->setBrush(curBrush);
-        painter->setPen(curPen);
-        painter->drawRect(curRect);
-
-//        QPixmap pixmap;
-//        QString iconPath = ":image/downBtn.png";
-//        if (type == 2) {
-//           iconPath = ":image/toolBar/filter.png";
-//        }
-//        pixmap.load(iconPath);
-//        painter->drawPixmap(frameLeft +1, frameTop +1, frameSize, frameSize, pixmap);
-
-        //draw ▼
-        int triangleWidth = 8;
-        int triangLength = 6;
-        int triangTop = frameTop + (frameSize - triangLength) / 2;
-        int triangLeft = frameLeft + (frameSize - triangleWidth) / 2;
-        QPoint points[3] = {QPoint(triangLeft, triangTop),
-                            QPoint(triangLeft + triangleWidth, triangTop),
-                            QPoint(triangLeft + triangleWidth /2, triangTop + triangLength)};
-
-        curBrush.setColor(QColor(90, 90, 102));
-        painter->setPen(curPen);
-        painter->setBrush(curBrush);
-        painter->drawConvexPolygon(points, 3);
-        painter->restore();
+        // the rect hit testing uses, above the aggregate band
+        HierarchicalHeaderRenderer::drawFilterButton(painter, filterButtonRect(QRect(left, top, width, height)));
     }
 
     void paintHorizontalSection(QPainter *painter, const QRect &sectionRect, int logicalLeafIndex,
-                                const QHeaderView *hv, const QStyleOptionHeader &styleOptions,
+                                const HierarchicalHeaderView *hv, const QStyleOptionHeader &styleOptions,
                                 const QModelIndex &leafIndex) const
     {
+        ensureExtents(hv);
         QPointF oldBO(painter->brushOrigin());
         int top = sectionRect.y();
         QModelIndexList indexes(parentIndexes(leafIndex));
@@ -458,15 +991,14 @@ public:
         painter->setBrushOrigin(oldBO);
     }
 
-    int paintVerticalCell(QPainter *painter, const QHeaderView *hv, const QModelIndex &cellIndex,
+    int paintVerticalCell(QPainter *painter, const HierarchicalHeaderView *hv, const QModelIndex &cellIndex,
                           const QModelIndex &leafIndex, int logicalLeafIndex,
                           const QStyleOptionHeader &styleOptions, const QRect &sectionRect, int left) const
     {
         QStyleOptionHeader uniopt(styleOptions);
 
-        const QVariant &variant = headerModel->data(leafIndex, HierarchicalHeaderModel::selected);
         QColor color;
-        if (variant.isValid() && variant.toInt() == 1)
+        if (isSelected(logicalLeafIndex, leafIndex))
             color = getColor(HierarchicalHeaderView::SelectedBackGroundRole);
         else
             color = getColor(HierarchicalHeaderView::UnSelectedBackGroundRole);
@@ -474,7 +1006,8 @@ public:
         QBrush brush(color);
         uniopt.palette.setBrush(QPalette::Window, brush);
 
-        int width = cellSize(cellIndex, hv, uniopt).width() + 2;
+        const int node = nodeId(cellIndex);
+        int width = node >= 0 ? m_nodeExtents.at(node) : cellSize(cellIndex, hv, uniopt).width() + 2;
         if (cellIndex == leafIndex)
             width = sectionRect.width() - left;
 
@@ -537,9 +1070,10 @@ public:
     }
 
     void paintVerticalSection(QPainter *painter, const QRect& sectionRect, int logicalLeafIndex,
-                              const QHeaderView* hv, const QStyleOptionHeader& styleOptions,
+                              const HierarchicalHeaderView *hv, const QStyleOptionHeader& styleOptions,
                               const QModelIndex& leafIndex) const
     {
+        ensureExtents(hv);
         QPointF oldBO(painter->brushOrigin());
         int left = sectionRect.x();
         QModelIndexList indexes(parentIndexes(leafIndex));
@@ -558,190 +1092,1400 @@ public:
         }
         painter->setBrushOrigin(oldBO);
     }
-};
-
-HierarchicalHeaderView::HierarchicalHeaderView(Qt::Orientation orientation, QWidget *parent) :
-    QHeaderView(orientation, parent),
-    _pd(new private_data()),
-    m_frozenHeader(Q_NULLPTR)
-{
-    setStyleSheet("background-color:rgb(240, 240, 240);border-color:rgb(210,210,210);");
-    setHighlightSections(true);
-    connect(this, SIGNAL(sectionResized(int, int, int)), this, SLOT(slotSectionResized(int)));
-}
-
-HierarchicalHeaderView::~HierarchicalHeaderView()
-{
-    delete _pd;
-    _pd = Q_NULLPTR;
-}
-
-void HierarchicalHeaderView::setColor(HierarchicalHeaderView::ColorRole role, const QColor &color)
-{
-    if (_pd) _pd->setColor(role, color);
-    viewport()->update();
-}
 
-QStyleOptionHeader HierarchicalHeaderView::styleOptionForCell(int logicalInd) const
-{
-    QStyleOptionHeader opt;
-    initStyleOption(&opt);
-    if (window()->isActiveWindow())
-        opt.state |= QStyle::State_Active;
-    opt.textAlignment = Qt::AlignCenter;
-    opt.iconAlignment = Qt::AlignVCenter;
-    opt.section = logicalInd;
+    inline void setDetailThresholds(int simplifiedWidth, int overviewWidth)
+    {
+        m_simplifiedWidth = simplifiedWidth;
+        m_overviewWidth = qMin(overviewWidth, simplifiedWidth);
+    }
 
-    int visual = visualIndex(logicalInd);
+    HierarchicalHeaderView::DetailLevel detailLevel(int sectionSize) const
+    {
+        if (sectionSize < m_overviewWidth)
+            return HierarchicalHeaderView::OverviewDetail;
+        if (sectionSize < m_simplifiedWidth)
+            return HierarchicalHeaderView::SimplifiedDetail;
+        return HierarchicalHeaderView::FullDetail;
+    }
 
-    if (count() == 1)
+    inline QColor placeholderColor() const
     {
-        opt.position = QStyleOptionHeader::OnlyOneSection;
+        QColor color = getColor(HierarchicalHeaderView::BorderRole);
+        color.setAlpha(color.alpha() / 2);
+        return color;
     }
-    else
+
+    QColor groupColor(int node) const
     {
-        if (visual == 0)
-            opt.position = QStyleOptionHeader::Beginning;
-        else
-            opt.position=(visual==count()-1 ? QStyleOptionHeader::End : QStyleOptionHeader::Middle);
+        const LayoutNode &root = m_nodes.at(m_nodes.at(node).root);
+        QVariant backgroundBrush(root.index.data(Qt::BackgroundRole));
+        if (backgroundBrush.canConvert(QMetaType::QBrush))
+            return qvariant_cast<QBrush>(backgroundBrush).color();
+
+        const QColor &color = getColor(HierarchicalHeaderView::UnSelectedBackGroundRole);
+        return (root.column % 2) ? color.darker(115) : color;
     }
 
-    if (sectionsClickable())
+    // everything painted for the visible sections of one paint event,
+    // submitted by flushBatch with one state change per kind of primitive
+    struct PaintBatch
     {
-        if (highlightSections() && selectionModel())
+        struct TextItem
         {
-            if (orientation()==Qt::Horizontal)
-            {
-                if (selectionModel()->columnIntersectsSelection(logicalInd, rootIndex()))
-                    opt.state |= QStyle::State_On;
-                if (selectionModel()->isColumnSelected(logicalInd, rootIndex()))
-                    opt.state |= QStyle::State_Sunken;
-            }
-        }
+            QRect rect;
+            QString text;
+            Qt::Alignment alignment;
+        };
+
+        QHash<QRgb, QVector<QRect> > fills;
+        QVector<QRect> borders;
+        QVector<QLine> lines;
+        QVector<TextItem> texts;
+        QVector<QPair<QRect, int> > arrows;
+        QVector<QRect> filterFrames;
+        QVector<QRect> hoveredFilterFrames;
+        QVector<QPolygon> filterTriangles;
+        QVector<QPair<QPoint, QPixmap> > icons;
+        QVector<QRect> iconPlaceholders;
+        QSet<int> nodes;
+    };
+
+    QRect spanRect(const HierarchicalHeaderView *hv, int node, int offset, int size) const
+    {
+        int first, last;
+        visualSpan(hv, node, first, last);
+        first = hv->logicalIndex(first);
+        last = hv->logicalIndex(last);
+        int firstPos = hv->sectionViewportPosition(first);
+        int lastPos = hv->sectionViewportPosition(last);
+        int begin = qMin(firstPos, lastPos);
+        int end = qMax(firstPos + hv->sectionSize(first), lastPos + hv->sectionSize(last));
+        if (hv->orientation() == Qt::Horizontal)
+            return QRect(begin, offset, end - begin, size);
+        return QRect(offset, begin, size, end - begin);
     }
 
-    if (selectionModel())
+    // with iconIndex the text makes room for the icon of that cell
+    void batchCell(PaintBatch &batch, const QRect &rect, const QString &text,
+                   Qt::Alignment alignment, const QColor &color,
+                   const QHeaderView *hv = Q_NULLPTR, const QModelIndex &iconIndex = QModelIndex()) const
     {
-        bool previousSelected=false;
-        if (orientation() == Qt::Horizontal)
-            previousSelected = selectionModel()->isColumnSelected(logicalIndex(visual - 1), rootIndex());
-        else
-            previousSelected = selectionModel()->isRowSelected(logicalIndex(visual - 1), rootIndex());
-        bool nextSelected=false;
-        if (orientation() == Qt::Horizontal)
-            nextSelected = selectionModel()->isColumnSelected(logicalIndex(visual + 1), rootIndex());
-        else
-            nextSelected = selectionModel()->isRowSelected(logicalIndex(visual + 1), rootIndex());
-        if (previousSelected && nextSelected)
-            opt.selectedPosition = QStyleOptionHeader::NextAndPreviousAreSelected;
-        else
-        {
-            if (previousSelected)
-                opt.selectedPosition = QStyleOptionHeader::PreviousIsSelected;
+        batch.fills[color.rgba()].append(rect);
+        PaintBatch::TextItem item;
+        item.rect = rect;
+        QPixmap icon;
+        if (hv != Q_NULLPTR && cellIcon(hv, iconIndex, icon)) {
+            const QRect &target = iconRect(hv, rect);
+            if (icon.isNull())
+                batch.iconPlaceholders.append(target);
             else
-            {
-                if (nextSelected)
-                    opt.selectedPosition = QStyleOptionHeader::NextIsSelected;
-                else
-                    opt.selectedPosition = QStyleOptionHeader::NotAdjacent;
-            }
+                batch.icons.append(qMakePair(target.topLeft(), icon));
+            item.rect.setLeft(rect.left() + target.width() + 2 * IconMargin);
         }
+        item.text = text;
+        item.alignment = alignment;
+        batch.texts.append(item);
+        batch.borders.append(rect.adjusted(-1, -1, -1, -1));
     }
-    return opt;
-}
 
-QSize HierarchicalHeaderView::sectionSizeFromContents(int logicalIndex) const
-{
-    if (_pd->headerModel)
+    // row height (column width for vertical headers) of a parent cell
+    int cellExtent(const HierarchicalHeaderView *hv, int node, const QStyleOptionHeader &styleOptions) const
     {
-        QModelIndex curLeafIndex(_pd->leafIndex(logicalIndex));
-        if (curLeafIndex.isValid()/* && !isSectionHidden(logicalIndex)*/)
-        {
-            QStyleOptionHeader styleOption(styleOptionForCell(logicalIndex));
-            QSize s(_pd->cellSize(curLeafIndex, this, styleOption));
-            curLeafIndex = curLeafIndex.parent();
-            while (curLeafIndex.isValid())
-            {
-                if (orientation() == Qt::Horizontal)
-                    s.rheight() += _pd->cellSize(curLeafIndex, this, styleOption).height();
+        const QModelIndex &cellIndex = m_nodes.at(node).index;
+        if (hv->orientation() == Qt::Horizontal)
+            return cellSize(cellIndex, hv, styleOptions).height() + m_aggregateBandHeight;
+        return cellSize(cellIndex, hv, styleOptions).width() + 2;
+    }
+
+    QVector<int> ancestorNodes(int node) const
+    {
+        QVector<int> ancestors;
+        for (node = m_nodes.at(node).parent; node >= 0; node = m_nodes.at(node).parent)
+            ancestors.prepend(node);
+        return ancestors;
+    }
+
+    // extent of every parent level, the largest parent cell of the depth unless fixed
+    QVector<int> measureLevelExtents(const HierarchicalHeaderView *hv) const
+    {
+        const QStyleOptionHeader &styleOptions = hv->styleOptionForCell(0);
+        QVector<int> levels(m_maxDepth + 1, 0);
+        for (int node = 0; node < m_nodes.size(); ++node) {
+            const int depth = m_nodes.at(node).depth;
+            if (isLeafNode(node) || (depth < m_fixedLevelExtents.size() && m_fixedLevelExtents.at(depth) > 0))
+                continue;
+            levels[depth] = qMax(levels.at(depth), cellExtent(hv, node, styleOptions));
+        }
+        for (int depth = 0; depth < levels.size() && depth < m_fixedLevelExtents.size(); ++depth) {
+            if (m_fixedLevelExtents.at(depth) > 0)
+                levels[depth] = m_fixedLevelExtents.at(depth);
+        }
+        return levels;
+    }
+
+    void ensureExtents(const HierarchicalHeaderView *hv) const
+    {
+        ensureLayout();
+        if (m_extentsValid)
+            return;
+
+        HIERARCHICAL_HEADER_TRACE("ensureExtents");
+
+        m_levelExtents = measureLevelExtents(hv);
+        m_nodeOffsets.resize(m_nodes.size());
+        m_nodeExtents.resize(m_nodes.size());
+        // parents always precede their children in m_nodes
+        for (int node = 0; node < m_nodes.size(); ++node) {
+            const int parent = m_nodes.at(node).parent;
+            m_nodeOffsets[node] = parent < 0 ? 0 : m_nodeOffsets.at(parent) + m_nodeExtents.at(parent);
+            m_nodeExtents[node] = isLeafNode(node) ? 0 : m_levelExtents.at(m_nodes.at(node).depth);
+        }
+        m_extentsValid = true;
+    }
+
+    // rect of node within the section of logicalLeafIndex, spanning all leaves of node;
+    // a collapsed group and the leaves take the rest of the section
+    QRect cellRect(const HierarchicalHeaderView *hv, int node, const QRect &sectionRect) const
+    {
+        const bool horizontal = hv->orientation() == Qt::Horizontal;
+        const int start = horizontal ? sectionRect.top() : sectionRect.left();
+        const int end = horizontal ? sectionRect.bottom() + 1 : sectionRect.right() + 1;
+        const int offset = start + m_nodeOffsets.at(node);
+        if (isLeafNode(node)) {
+            QRect rect(sectionRect);
+            if (horizontal)
+                rect.setTop(offset);
+            else
+                rect.setLeft(offset);
+            return rect;
+        }
+        return spanRect(hv, node, offset, m_nodes.at(node).collapsed ? end - offset : m_nodeExtents.at(node));
+    }
+
+    // cell under pos, parents included; a collapsed group ends the chain.
+    // The section is found by QHeaderView's binary search over section positions,
+    // the row by comparing against the cached cell offsets of the ancestors
+    int nodeAt(const HierarchicalHeaderView *hv, const QPoint &pos, QRect *rect = Q_NULLPTR) const
+    {
+        const int section = hv->logicalIndexAt(pos);
+        const int leaf = leafNode(section);
+        if (leaf < 0)
+            return -1;
+
+        ensureExtents(hv);
+        const QRect &sectionRect = hv->sectionRect(section);
+        const int point = hv->orientation() == Qt::Horizontal ? pos.y() - sectionRect.top()
+                                                              : pos.x() - sectionRect.left();
+        int result = leaf;
+        const QVector<int> &ancestors = ancestorNodes(leaf);
+        for (int i = 0; i < ancestors.size(); ++i) {
+            const int node = ancestors.at(i);
+            if (m_nodes.at(node).collapsed || point < m_nodeOffsets.at(node) + m_nodeExtents.at(node)) {
+                result = node;
+                break;
+            }
+        }
+        if (rect)
+            *rect = cellRect(hv, result, sectionRect);
+        return result;
+    }
+
+    inline QRect arrowRect(const QRect &cellRect) const
+    {
+        return HierarchicalHeaderRenderer::arrowRect(cellRect);
+    }
+
+    inline QRect filterButtonRect(const QRect &cellRect) const
+    {
+        return HierarchicalHeaderRenderer::filterButtonRect(cellRect, m_aggregateBandHeight);
+    }
+
+    inline bool hasFilterButton(const HierarchicalHeaderView *hv, int leaf) const
+    {
+        return hv->orientation() == Qt::Horizontal && m_canFilter
+                && headerModel->data(m_nodes.at(leaf).index, HierarchicalHeaderModel::CanFilter).toInt() != 0;
+    }
+
+    HierarchicalHeaderView::HitTestResult hitTest(const HierarchicalHeaderView *hv, const QPoint &pos) const
+    {
+        HierarchicalHeaderView::HitTestResult result;
+        result.logicalIndex = hv->logicalIndexAt(pos);
+        result.depth = -1;
+        result.element = HierarchicalHeaderView::NoElement;
+
+        const int node = nodeAt(hv, pos, &result.rect);
+        if (node < 0)
+            return result;
+
+        result.index = m_nodes.at(node).index;
+        result.depth = m_nodes.at(node).depth;
+        result.element = HierarchicalHeaderView::LabelElement;
+
+        const bool horizontal = hv->orientation() == Qt::Horizontal;
+        const int grip = hv->style()->pixelMetric(QStyle::PM_HeaderGripMargin, Q_NULLPTR, hv);
+        const int point = horizontal ? pos.x() : pos.y();
+        const int edge = horizontal ? (hv->isRightToLeft() ? result.rect.left() : result.rect.right())
+                                    : result.rect.bottom();
+        if (qAbs(point - edge) <= grip) {
+            result.element = HierarchicalHeaderView::ResizeEdgeElement;
+        } else if (!isLeafNode(node)) {
+            if (m_groupsCollapsible && collapseToggleRect(result.rect).contains(pos))
+                result.element = HierarchicalHeaderView::CollapseToggleElement;
+        } else if (hasFilterButton(hv, node) && filterButtonRect(result.rect).contains(pos)) {
+            result.element = HierarchicalHeaderView::FilterButtonElement;
+        } else if (headerModel->data(result.index, HierarchicalHeaderModel::Arrow).toInt() > 0
+                   && arrowRect(result.rect).contains(pos)) {
+            result.element = HierarchicalHeaderView::SortArrowElement;
+        }
+        return result;
+    }
+
+    bool isSearchMatch(int node) const
+    {
+        if (m_searchMatches.isEmpty())
+            return false;
+        if (!m_searchNodesValid) {
+            m_searchNodes.clear();
+            for (int i = 0; i < m_searchMatches.size(); ++i) {
+                int id = nodeId(m_searchMatches.at(i));
+                if (id >= 0)
+                    m_searchNodes.insert(id);
+            }
+            m_searchNodesValid = true;
+        }
+        return m_searchNodes.contains(node);
+    }
+
+    inline QColor searchColor(int node) const
+    {
+        const QColor &color = getColor(HierarchicalHeaderView::SearchMatchBackGroundRole);
+        if (m_searchCurrent >= 0 && nodeId(m_searchMatches.at(m_searchCurrent)) == node)
+            return color.darker(125);
+        return color;
+    }
+
+    void ensureNodeAggregates() const
+    {
+        ensureLayout();
+        if (m_nodeAggregatesValid && m_nodeAggregatesRevision == m_aggregates->revision())
+            return;
+
+        // children follow their parent in m_nodes, walking backwards finishes every child first
+        m_nodeAggregates.fill(HierarchicalHeaderAggregates::Aggregate::empty(), m_nodes.size());
+        for (int node = m_nodes.size() - 1; node >= 0; --node) {
+            if (isLeafNode(node))
+                m_nodeAggregates[node] = m_aggregates->aggregate(m_nodes.at(node).firstLeaf);
+            const int parent = m_nodes.at(node).parent;
+            if (parent >= 0)
+                m_nodeAggregates[parent].combine(m_nodeAggregates.at(node));
+        }
+        m_nodeAggregatesRevision = m_aggregates->revision();
+        m_nodeAggregatesValid = true;
+    }
+
+    QString aggregateText(int node) const
+    {
+        ensureNodeAggregates();
+        const HierarchicalHeaderAggregates::Aggregate &aggregate = m_nodeAggregates.at(node);
+        const QLocale locale;
+        QStringList lines;
+        if (m_aggregateFunctions & HierarchicalHeaderView::AggregateSum)
+            lines << QStringLiteral("sum ") + locale.toString(aggregate.sum + aggregate.compensation, 'g', 6);
+        if (m_aggregateFunctions & HierarchicalHeaderView::AggregateMin)
+            lines << QStringLiteral("min ") + (aggregate.count > 0 ? locale.toString(aggregate.min, 'g', 6) : QStringLiteral("-"));
+        if (m_aggregateFunctions & HierarchicalHeaderView::AggregateMax)
+            lines << QStringLiteral("max ") + (aggregate.count > 0 ? locale.toString(aggregate.max, 'g', 6) : QStringLiteral("-"));
+        if (m_aggregateFunctions & HierarchicalHeaderView::AggregateMean)
+            lines << QStringLiteral("avg ") + (aggregate.count > 0 ? locale.toString(aggregate.mean(), 'g', 6) : QStringLiteral("-"));
+        return lines.join(QLatin1Char('\n'));
+    }
+
+    // the lower m_aggregateBandHeight pixels of a cell show its aggregates, the title moves above them
+    void batchAggregate(PaintBatch &batch, const QRect &rect, int node) const
+    {
+        if (m_aggregateBandHeight <= 0 || m_aggregates == Q_NULLPTR)
+            return;
+
+        QRect band(rect);
+        band.setTop(rect.bottom() + 1 - m_aggregateBandHeight);
+        batch.texts.last().rect.setBottom(band.top() - 1);
+        PaintBatch::TextItem item;
+        item.rect = band;
+        item.text = aggregateText(node);
+        item.alignment = Qt::AlignCenter;
+        batch.texts.append(item);
+        batch.lines.append(QLine(band.topLeft(), band.topRight()));
+    }
+
+    inline QRect collapseToggleRect(const QRect &cellRect) const
+    {
+        return QRect(cellRect.left(), cellRect.top(), qMin(16, cellRect.width()), cellRect.height());
+    }
+
+    // adds the parents of a leaf that are not batched yet and, unless it is narrow,
+    // the leaf cell itself; returns the rect left for the leaf cell, empty when the
+    // leaf is the summary section of a collapsed group
+    QRect batchSection(PaintBatch &batch, const HierarchicalHeaderView *hv, int logicalLeafIndex,
+                       const QColor &parentColor, bool narrow) const
+    {
+        ensureExtents(hv);
+        const int leaf = leafNode(logicalLeafIndex);
+        const QRect &sectionRect = hv->sectionRect(logicalLeafIndex);
+        const QVector<int> &ancestors = ancestorNodes(leaf);
+        for (int i = 0; i < ancestors.size(); ++i) {
+            const int node = ancestors.at(i);
+            const bool collapsed = m_nodes.at(node).collapsed;
+            if (!batch.nodes.contains(node)) {
+                batch.nodes.insert(node);
+                const QRect &rect = cellRect(hv, node, sectionRect);
+                QColor color = isSearchMatch(node) ? searchColor(node) : parentColor;
+                if (node == m_hoverNode)
+                    color = getColor(HierarchicalHeaderView::HoverBackGroundRole);
+                batchCell(batch, rect, m_nodes.at(node).index.data(Qt::DisplayRole).toString(), m_leafAlignment, color,
+                          hv, m_nodes.at(node).index);
+                batchAggregate(batch, rect, node);
+                if (m_groupsCollapsible) {
+                    PaintBatch::TextItem toggle;
+                    toggle.rect = collapseToggleRect(rect);
+                    toggle.text = collapsed ? QStringLiteral("+") : QStringLiteral("-");
+                    toggle.alignment = Qt::AlignCenter;
+                    batch.texts.append(toggle);
+                }
+            }
+            if (collapsed)
+                return QRect();
+        }
+
+        const QRect &rect = cellRect(hv, leaf, sectionRect);
+        if (narrow)
+            return rect;
+
+        const QModelIndex &leafIndex = m_nodes.at(leaf).index;
+        QColor color = isSelected(m_nodes.at(leaf).firstLeaf, leafIndex)
+                ? getColor(HierarchicalHeaderView::SelectedBackGroundRole)
+                : getColor(HierarchicalHeaderView::UnSelectedBackGroundRole);
+        if (isSearchMatch(leaf))
+            color = searchColor(leaf);
+        if (leaf == m_hoverNode)
+            color = getColor(HierarchicalHeaderView::HoverBackGroundRole);
+        batchCell(batch, rect, leafIndex.data(Qt::DisplayRole).toString(), m_headerAlignment, color, hv, leafIndex);
+        batchAggregate(batch, rect, leaf);
+
+        int type = headerModel->data(leafIndex, HierarchicalHeaderModel::Arrow).toInt();
+        if (type > 0)
+            batch.arrows.append(qMakePair(arrowRect(rect), type));
+
+        if (hasFilterButton(hv, leaf)) {
+            const QRect &frame = filterButtonRect(rect);
+            if (leaf == m_hoverNode && m_hoverElement == HierarchicalHeaderView::FilterButtonElement)
+                batch.hoveredFilterFrames.append(frame);
+            else
+                batch.filterFrames.append(frame);
+
+            int triangleWidth = 8;
+            int triangLength = 6;
+            int triangTop = frame.top() + (frame.height() - triangLength) / 2;
+            int triangLeft = frame.left() + (frame.width() - triangleWidth) / 2;
+            QPolygon triangle;
+            triangle << QPoint(triangLeft, triangTop)
+                     << QPoint(triangLeft + triangleWidth, triangTop)
+                     << QPoint(triangLeft + triangleWidth / 2, triangTop + triangLength);
+            batch.filterTriangles.append(triangle);
+        }
+        return rect;
+    }
+
+    // a run of narrow leaves of one parent becomes a single band without text
+    void batchBand(PaintBatch &batch, const QRect &band, int leaf, bool horizontal) const
+    {
+        batch.fills[groupColor(leaf).rgba()].append(band);
+        if (horizontal) {
+            batch.lines.append(QLine(band.topRight(), band.bottomRight()));
+            batch.lines.append(QLine(band.bottomLeft(), band.bottomRight()));
+        } else {
+            batch.lines.append(QLine(band.bottomLeft(), band.bottomRight()));
+            batch.lines.append(QLine(band.topRight(), band.bottomRight()));
+        }
+    }
+
+    void flushBatch(QPainter *painter, const QHeaderView *hv, const PaintBatch &batch) const
+    {
+        HIERARCHICAL_HEADER_TRACE("flushBatch");
+        painter->save();
+        painter->setPen(Qt::NoPen);
+        for (QHash<QRgb, QVector<QRect> >::const_iterator it = batch.fills.constBegin();
+             it != batch.fills.constEnd(); ++it) {
+            painter->setBrush(QColor::fromRgba(it.key()));
+            painter->drawRects(it.value());
+        }
+        if (!batch.iconPlaceholders.isEmpty()) {
+            painter->setBrush(placeholderColor());
+            painter->drawRects(batch.iconPlaceholders);
+        }
+        for (int i = 0; i < batch.icons.size(); ++i)
+            painter->drawPixmap(batch.icons.at(i).first, batch.icons.at(i).second);
+
+        if (!batch.arrows.isEmpty()) {
+            painter->save();
+            QStyleOptionHeader opt;
+            opt.initFrom(hv);
+            opt.palette.setBrush(QPalette::ButtonText, QBrush(QColor(73, 179, 238)));
+            for (int i = 0; i < batch.arrows.size(); ++i) {
+                opt.rect = batch.arrows.at(i).first;
+                QStyle::PrimitiveElement pe = (batch.arrows.at(i).second == 1) ? QStyle::PE_IndicatorArrowDown
+                                                                               : QStyle::PE_IndicatorArrowUp;
+                hv->style()->drawPrimitive(pe, &opt, painter, hv);
+            }
+            painter->restore();
+        }
+
+        painter->setBrush(Qt::NoBrush);
+        painter->setPen(getColor(HierarchicalHeaderView::TextRole));
+        for (int i = 0; i < batch.texts.size(); ++i) {
+            const PaintBatch::TextItem &item = batch.texts.at(i);
+            painter->drawText(item.rect, item.text, QTextOption(item.alignment));
+        }
+
+        painter->setPen(getColor(HierarchicalHeaderView::BorderRole));
+        painter->drawRects(batch.borders);
+        painter->drawLines(batch.lines);
+
+        if (!batch.filterTriangles.isEmpty()) {
+            QPen curPen(QColor(150, 153, 163), 1, Qt::SolidLine, Qt::RoundCap, Qt::MiterJoin);
+            painter->setPen(curPen);
+            painter->setBrush(QColor(236, 237, 239));
+            painter->drawRects(batch.filterFrames);
+            painter->setBrush(getColor(HierarchicalHeaderView::HoverBackGroundRole));
+            painter->drawRects(batch.hoveredFilterFrames);
+            painter->setBrush(QColor(90, 90, 102));
+            for (int i = 0; i < batch.filterTriangles.size(); ++i)
+                painter->drawConvexPolygon(batch.filterTriangles.at(i));
+        }
+        painter->restore();
+    }
+
+    // part of the viewport that shows a hover change from (node, element) to the current hover
+    QRect hoverChangeRect(int node, HierarchicalHeaderView::HitElement element, const QRect &rect) const
+    {
+        if (node != m_hoverNode)
+            return rect;
+        if (element == HierarchicalHeaderView::FilterButtonElement
+                || m_hoverElement == HierarchicalHeaderView::FilterButtonElement)
+            return filterButtonRect(rect).adjusted(-1, -1, 1, 1);
+        return QRect();
+    }
+
+    // every visible leaf is below the overview width: one rect per top level span
+    void paintOverview(QPainter *painter, const HierarchicalHeaderView *hv,
+                       int firstVisual, int lastVisual) const
+    {
+        const bool horizontal = hv->orientation() == Qt::Horizontal;
+        for (int i = firstVisual; i <= lastVisual; ++i) {
+            int section = hv->logicalIndex(i);
+            int leaf = leafNode(section);
+            if (leaf < 0 || hv->isSectionHidden(section))
+                continue;
+
+            const LayoutNode &root = m_nodes.at(m_nodes.at(leaf).root);
+            QRect spanRect(hv->sectionRect(section));
+            if (!hv->sectionsMoved()) {
+                // untouched visual order keeps the span contiguous, jump over it
+                int lastLeaf = root.firstLeaf + root.leafCount - 1;
+                spanRect |= hv->sectionRect(lastLeaf);
+                i = qMax(i, lastLeaf);
+            } else {
+                while (i < lastVisual && leafNode(hv->logicalIndex(i + 1)) >= 0
+                       && m_nodes.at(leafNode(hv->logicalIndex(i + 1))).root == m_nodes.at(leaf).root) {
+                    ++i;
+                    spanRect |= hv->sectionRect(hv->logicalIndex(i));
+                }
+            }
+            paintBand(painter, spanRect, groupColor(leaf), horizontal);
+        }
+    }
+
+    inline bool hasRowGroups(const QHeaderView *hv) const
+    {
+        return hv->orientation() == Qt::Vertical && !m_rowGroups.isEmpty();
+    }
+
+    inline int rowGroupsWidth(const QHeaderView *hv) const
+    {
+        return hasRowGroups(hv) ? m_rowGroups.levelCount() * m_rowGroupWidth : 0;
+    }
+
+    // one column per level, consecutive visible rows of a group become one cell;
+    // the group is looked up again only when a row falls outside the current span
+    void batchRowGroups(PaintBatch &batch, const QHeaderView *hv, int firstVisual, int lastVisual) const
+    {
+        const QColor &color = getColor(HierarchicalHeaderView::UnSelectedBackGroundRole);
+        for (int level = 0; level < m_rowGroups.levelCount(); ++level) {
+            int group = -1;
+            QRect run;
+            for (int i = firstVisual; i <= lastVisual + 1; ++i) {
+                const int row = i <= lastVisual ? hv->logicalIndex(i) : -1;
+                if (row >= 0 && hv->isSectionHidden(row))
+                    continue;
+
+                int current = -1;
+                if (row >= 0)
+                    current = (group >= 0 && m_rowGroups.contains(level, group, row)) ? group : m_rowGroups.groupAt(level, row);
+                if (row < 0 || current != group) {
+                    if (group >= 0)
+                        batchCell(batch, run, m_rowGroups.title(level, group), m_leafAlignment, color);
+                    group = current;
+                    run = QRect();
+                }
+                if (group >= 0)
+                    run |= QRect(level * m_rowGroupWidth, hv->sectionViewportPosition(row), m_rowGroupWidth, hv->sectionSize(row));
+            }
+        }
+    }
+
+    void paintBand(QPainter *painter, const QRect &band, const QColor &color, bool horizontal) const
+    {
+        painter->fillRect(band, color);
+        painter->setPen(getColor(HierarchicalHeaderView::BorderRole));
+        if (horizontal) {
+            painter->drawLine(band.topRight(), band.bottomRight());
+            painter->drawLine(band.bottomLeft(), band.bottomRight());
+        } else {
+            painter->drawLine(band.bottomLeft(), band.bottomRight());
+            painter->drawLine(band.topRight(), band.bottomRight());
+        }
+    }
+};
+
+HierarchicalHeaderView::HierarchicalHeaderView(Qt::Orientation orientation, QWidget *parent) :
+    QHeaderView(orientation, parent),
+    _pd(new private_data()),
+    m_frozenHeader(Q_NULLPTR)
+{
+    setStyleSheet("background-color:rgb(240, 240, 240);border-color:rgb(210,210,210);");
+    setHighlightSections(true);
+    viewport()->setMouseTracking(true);
+    connect(this, SIGNAL(sectionResized(int, int, int)), this, SLOT(slotSectionResized(int)));
+    connect(this, SIGNAL(sectionMoved(int, int, int)), this, SLOT(slotSectionMoved(int, int, int)));
+    connect(this, SIGNAL(iconSizeChanged(QSize)), this, SLOT(slotIconSizeChanged()));
+    qRegisterMetaType<HierarchicalHeaderLayout>("HierarchicalHeaderLayout");
+    setIconCache(HierarchicalHeaderIconCache::instance());
+}
+
+HierarchicalHeaderView::~HierarchicalHeaderView()
+{
+    delete _pd;
+    _pd = Q_NULLPTR;
+}
+
+void HierarchicalHeaderView::setColor(HierarchicalHeaderView::ColorRole role, const QColor &color)
+{
+    if (_pd) _pd->setColor(role, color);
+    viewport()->update();
+}
+
+QStyleOptionHeader HierarchicalHeaderView::styleOptionForCell(int logicalInd) const
+{
+    QStyleOptionHeader opt;
+    initStyleOption(&opt);
+    if (window()->isActiveWindow())
+        opt.state |= QStyle::State_Active;
+    opt.textAlignment = Qt::AlignCenter;
+    opt.iconAlignment = Qt::AlignVCenter;
+    opt.section = logicalInd;
+
+    int visual = visualIndex(logicalInd);
+
+    if (count() == 1)
+    {
+        opt.position = QStyleOptionHeader::OnlyOneSection;
+    }
+    else
+    {
+        if (visual == 0)
+            opt.position = QStyleOptionHeader::Beginning;
+        else
+            opt.position=(visual==count()-1 ? QStyleOptionHeader::End : QStyleOptionHeader::Middle);
+    }
+
+    if (sectionsClickable())
+    {
+        if (highlightSections() && selectionModel())
+        {
+            if (orientation()==Qt::Horizontal)
+            {
+                if (selectionModel()->columnIntersectsSelection(logicalInd, rootIndex()))
+                    opt.state |= QStyle::State_On;
+                if (selectionModel()->isColumnSelected(logicalInd, rootIndex()))
+                    opt.state |= QStyle::State_Sunken;
+            }
+        }
+    }
+
+    if (selectionModel())
+    {
+        bool previousSelected=false;
+        if (orientation() == Qt::Horizontal)
+            previousSelected = selectionModel()->isColumnSelected(logicalIndex(visual - 1), rootIndex());
+        else
+            previousSelected = selectionModel()->isRowSelected(logicalIndex(visual - 1), rootIndex());
+        bool nextSelected=false;
+        if (orientation() == Qt::Horizontal)
+            nextSelected = selectionModel()->isColumnSelected(logicalIndex(visual + 1), rootIndex());
+        else
+            nextSelected = selectionModel()->isRowSelected(logicalIndex(visual + 1), rootIndex());
+        if (previousSelected && nextSelected)
+            opt.selectedPosition = QStyleOptionHeader::NextAndPreviousAreSelected;
+        else
+        {
+            if (previousSelected)
+                opt.selectedPosition = QStyleOptionHeader::PreviousIsSelected;
+            else
+            {
+                if (nextSelected)
+                    opt.selectedPosition = QStyleOptionHeader::NextIsSelected;
                 else
-                    s.rwidth() += _pd->cellSize(curLeafIndex, this, styleOption).width();
-                curLeafIndex = curLeafIndex.parent();
+                    opt.selectedPosition = QStyleOptionHeader::NotAdjacent;
             }
+        }
+    }
+    return opt;
+}
+
+QSize HierarchicalHeaderView::sectionSizeFromContents(int logicalIndex) const
+{
+    HIERARCHICAL_HEADER_TRACE("sectionSizeFromContents");
+    if (_pd->hasRowGroups(this))
+    {
+        QSize s(QHeaderView::sectionSizeFromContents(logicalIndex));
+        s.rwidth() += _pd->rowGroupsWidth(this);
+        return s;
+    }
+    if (_pd->headerModel)
+    {
+        QModelIndex curLeafIndex(_pd->leafIndex(logicalIndex));
+        if (curLeafIndex.isValid()/* && !isSectionHidden(logicalIndex)*/)
+        {
+            QStyleOptionHeader styleOption(styleOptionForCell(logicalIndex));
+            QSize s(_pd->cellSize(curLeafIndex, this, styleOption));
+            // the parent rows above the leaf are the level table, summed up in the leaf offset
+            _pd->ensureExtents(this);
+            const int leaf = _pd->leafNode(logicalIndex);
+            const int offset = leaf >= 0 ? _pd->m_nodeOffsets.at(leaf) : 0;
+            if (orientation() == Qt::Horizontal)
+                s.rheight() += _pd->m_aggregateBandHeight + offset;
+            else
+                s.rwidth() += offset;
             return s;
         }
     }
-    return QHeaderView::sectionSizeFromContents(logicalIndex);
+    return QHeaderView::sectionSizeFromContents(logicalIndex);
+}
+
+void HierarchicalHeaderView::mousePressEvent(QMouseEvent *e)
+{
+    if (e->button() != Qt::LeftButton)
+        return QHeaderView::mousePressEvent(e);
+
+    // the edge of a parent cell resizes the whole group, leaf edges are left to QHeaderView
+    const HitTestResult &hit = hitTest(e->pos());
+    if (hit.element == ResizeEdgeElement && hit.index.isValid() && hit.index != _pd->leafIndex(hit.logicalIndex)) {
+        const int node = _pd->nodeId(hit.index);
+        if (node >= 0 && groupResizeSections(node, _pd->m_resizeSections, _pd->m_resizeSizes)) {
+            _pd->m_resizeNode = node;
+            _pd->m_resizeStart = orientation() == Qt::Horizontal ? e->pos().x() : e->pos().y();
+            return;
+        }
+    }
+    if (cursor().shape() == Qt::SplitHCursor || cursor().shape() == Qt::SplitVCursor)
+        return QHeaderView::mousePressEvent(e);
+
+    if (hit.element == CollapseToggleElement) {
+        toggleGroup(hit.index);
+        return;
+    }
+
+    if (hit.element == LabelElement && hit.index.isValid() && hit.index != _pd->leafIndex(hit.logicalIndex)) {
+        emit signalCellClicked(hit.index, hit.depth);
+        selectFromClick(hit, e->modifiers());
+        if (sectionsMovable()) {
+            _pd->m_dragNode = _pd->nodeId(hit.index);
+            _pd->m_dragActive = false;
+            _pd->m_dragStart = e->pos();
+        }
+        return;
+    }
+
+    if (sectionsClickable()) {
+        int logicalIndex = hit.logicalIndex;
+        if (logicalIndex < 0)
+            return;
+        if (checkIsFilterBtnClicked(hit)) {
+        }
+        else if (getCanSort())
+        {
+            if (e->modifiers() == Qt::ControlModifier) {
+                clearArrowType(logicalIndex);
+            }
+            else
+                setClickSelectedColumn(logicalIndex);
+        }
+        selectFromClick(hit, e->modifiers());
+    }
+    return QHeaderView::mousePressEvent(e);
+}
+
+/**
+ * @brief HierarchicalHeaderView::selectFromClick select the leaf or, for a parent cell, all leaves of
+ * the group. Ctrl toggles, Shift extends from the last clicked section in visual order, Ctrl+Shift
+ * adds the extended range. Moved sections split the visual range into runs of logical columns.
+ */
+void HierarchicalHeaderView::selectFromClick(const HitTestResult &hit, Qt::KeyboardModifiers modifiers)
+{
+    HierarchicalHeaderModel *model = _pd->hierarchicalModel();
+    if (model == Q_NULLPTR) {
+        setSelectedColumn(hit.logicalIndex);
+        return;
+    }
+
+    // the leaves of a group are consecutive logical columns, whatever the visual order
+    int first = hit.logicalIndex;
+    int last = first;
+    const bool leaf = hit.index == _pd->leafIndex(hit.logicalIndex);
+    if (!leaf) {
+        const int node = _pd->nodeId(hit.index);
+        if (node < 0)
+            return;
+        first = _pd->m_nodes.at(node).firstLeaf;
+        last = first + _pd->m_nodes.at(node).leafCount - 1;
+    }
+
+    const bool control = modifiers & Qt::ControlModifier;
+    if (!(modifiers & Qt::ShiftModifier) || _pd->m_selectionAnchor < 0 || _pd->m_selectionAnchor >= count()) {
+        _pd->m_selectionAnchor = hit.logicalIndex;
+        if (!control)
+            model->selectColumns(first, last, HierarchicalHeaderModel::ClearAndSelect);
+        else if (leaf)
+            model->selectColumns(first, last, HierarchicalHeaderModel::Toggle);
+        else
+            model->selectColumns(first, last, model->isRangeSelected(first, last)
+                                 ? HierarchicalHeaderModel::Deselect : HierarchicalHeaderModel::Select);
+        return;
+    }
+
+    // Shift extends from the anchor in visual order, moved sections split it into runs of columns
+    int visualFirst = qMin(visualIndex(first), visualIndex(_pd->m_selectionAnchor));
+    int visualLast = qMax(visualIndex(last), visualIndex(_pd->m_selectionAnchor));
+    if (!leaf) {
+        int groupFirst, groupLast;
+        _pd->visualSpan(this, _pd->nodeId(hit.index), groupFirst, groupLast);
+        visualFirst = qMin(visualFirst, groupFirst);
+        visualLast = qMax(visualLast, groupLast);
+    }
+    if (visualFirst < 0)
+        return;
+
+    HierarchicalHeaderModel::SelectionCommand command = control ? HierarchicalHeaderModel::Select
+                                                                : HierarchicalHeaderModel::ClearAndSelect;
+    if (!sectionsMoved()) {
+        model->selectColumns(visualFirst, visualLast, command);
+        return;
+    }
+
+    if (command == HierarchicalHeaderModel::ClearAndSelect) {
+        model->clearSelection();
+        command = HierarchicalHeaderModel::Select;
+    }
+    int runFirst = -1;
+    int runLast = -1;
+    for (int visual = visualFirst; visual <= visualLast + 1; ++visual) {
+        const int logical = visual <= visualLast ? logicalIndex(visual) : -1;
+        if (logical >= 0 && isSectionHidden(logical))
+            continue;
+        if (logical >= 0 && runFirst >= 0 && logical == runLast + 1) {
+            runLast = logical;
+            continue;
+        }
+        if (runFirst >= 0)
+            model->selectColumns(runFirst, runLast, command);
+        runFirst = runLast = logical;
+    }
+}
+
+void HierarchicalHeaderView::mouseMoveEvent(QMouseEvent *e)
+{
+    if (e->buttons() == Qt::NoButton)
+        updateHover(e->pos());
+
+    if (_pd->m_resizeNode >= 0) {
+        int delta = (orientation() == Qt::Horizontal ? e->pos().x() : e->pos().y()) - _pd->m_resizeStart;
+        if (orientation() == Qt::Horizontal && isRightToLeft())
+            delta = -delta;
+        int size = 0;
+        for (int i = 0; i < _pd->m_resizeSizes.size(); ++i)
+            size += _pd->m_resizeSizes.at(i);
+        applyGroupSize(_pd->m_resizeSections, _pd->m_resizeSizes, size + delta);
+        return;
+    }
+
+    if (_pd->m_dragNode >= 0) {
+        if (!_pd->m_dragActive
+                && (e->pos() - _pd->m_dragStart).manhattanLength() >= QApplication::startDragDistance())
+            _pd->m_dragActive = true;
+        if (_pd->m_dragActive) {
+            _pd->m_dropNode = _pd->dropTargetAt(this, e->pos(), _pd->m_dragNode, _pd->m_dropAfter);
+            viewport()->update();
+        }
+        return;
+    }
+    return QHeaderView::mouseMoveEvent(e);
+}
+
+void HierarchicalHeaderView::mouseReleaseEvent(QMouseEvent *e)
+{
+    if (_pd->m_resizeNode >= 0) {
+        const int node = _pd->m_resizeNode;
+        int size = 0;
+        for (int i = 0; i < _pd->m_resizeSections.size(); ++i)
+            size += sectionSize(_pd->m_resizeSections.at(i));
+        _pd->m_resizeNode = -1;
+        _pd->m_resizeSections.clear();
+        _pd->m_resizeSizes.clear();
+        if (node < _pd->m_nodes.size())
+            emit signalGroupResized(_pd->m_nodes.at(node).index, size);
+        return;
+    }
+    if (_pd->m_dragNode >= 0) {
+        const int dragNode = _pd->m_dragNode;
+        const int dropNode = _pd->m_dropNode;
+        const bool active = _pd->m_dragActive;
+        _pd->m_dragNode = -1;
+        _pd->m_dropNode = -1;
+        _pd->m_dragActive = false;
+        if (active && dropNode >= 0)
+            moveGroup(_pd->m_nodes.at(dragNode).index, _pd->m_nodes.at(dropNode).index, _pd->m_dropAfter);
+        viewport()->update();
+        return;
+    }
+    return QHeaderView::mouseReleaseEvent(e);
+}
+
+bool HierarchicalHeaderView::viewportEvent(QEvent *e)
+{
+    if (e->type() == QEvent::Leave)
+        updateHover(QPoint(-1, -1));
+    return QHeaderView::viewportEvent(e);
+}
+
+void HierarchicalHeaderView::timerEvent(QTimerEvent *e)
+{
+    if (e->timerId() == _pd->m_hoverTimer.timerId()) {
+        _pd->m_hoverTimer.stop();
+        viewport()->update(_pd->m_hoverDirty);
+        _pd->m_hoverDirty = QRegion();
+        return;
+    }
+    QHeaderView::timerEvent(e);
+}
+
+/**
+ * @brief HierarchicalHeaderView::updateHover track the hovered cell and element, only the
+ * rects of the old and new hovered element are repainted, at most once per frame
+ */
+void HierarchicalHeaderView::updateHover(const QPoint &pos)
+{
+    HitTestResult hit;
+    hit.element = NoElement;
+    if (viewport()->rect().contains(pos))
+        hit = hitTest(pos);
+
+    const int node = hit.index.isValid() ? _pd->nodeId(hit.index) : -1;
+    const HitElement element = node >= 0 ? hit.element : NoElement;
+    if (node == _pd->m_hoverNode && element == _pd->m_hoverElement)
+        return;
+
+    const int oldNode = _pd->m_hoverNode;
+    const HitElement oldElement = _pd->m_hoverElement;
+    const QRect oldRect = _pd->m_hoverRect;
+    _pd->m_hoverNode = node;
+    _pd->m_hoverElement = element;
+    _pd->m_hoverRect = hit.rect;
+
+    if (oldNode >= 0)
+        _pd->m_hoverDirty += _pd->hoverChangeRect(oldNode, oldElement, oldRect);
+    if (node >= 0 && node != oldNode)
+        _pd->m_hoverDirty += hit.rect;
+    if (!_pd->m_hoverDirty.isEmpty() && !_pd->m_hoverTimer.isActive())
+        _pd->m_hoverTimer.start(16, this);
+}
+
+void HierarchicalHeaderView::changeEvent(QEvent *e)
+{
+    if (e->type() == QEvent::FontChange || e->type() == QEvent::StyleChange) {
+        _pd->invalidateExtents();
+        if (_pd->m_aggregateBand)
+            updateAggregateBand();
+    }
+    QHeaderView::changeEvent(e);
+}
+
+bool HierarchicalHeaderView::checkIsFilterBtnClicked(const HitTestResult &hit)
+{
+    if (hit.element != FilterButtonElement || _pd->headerModel.isNull())
+        return false;
+
+    const int &logicalIndex = hit.logicalIndex;
+    QRect popRect(sectionRect(logicalIndex));
+    bool btnState = _pd->headerModel->data(hit.index, HierarchicalHeaderModel::FilterBtnState).toBool();
+    if (!btnState) {
+        emit signalFilterBtnClicked(logicalIndex, popRect);
+    }
+    int colunm = getPrevSelected();
+    setColunmFilterState(logicalIndex, !btnState, HierarchicalHeaderModel::FilterBtnState);
+    if (colunm != logicalIndex)
+        setColunmFilterState(colunm, false, HierarchicalHeaderModel::FilterBtnState);
+    return  true;
+}
+
+HierarchicalHeaderView::HitTestResult HierarchicalHeaderView::hitTest(const QPoint &pos) const
+{
+    return _pd->hitTest(this, pos);
+}
+
+/**
+ * @brief HierarchicalHeaderView::saveState section sizes, order and visibility plus the collapse
+ * state of the groups; restore the model with HierarchicalHeaderModel::restoreState first
+ */
+QByteArray HierarchicalHeaderView::saveState() const
+{
+    QVector<qint32> collapsed;
+    _pd->ensureLayout();
+    for (int id = 0; id < _pd->m_nodes.size(); ++id) {
+        if (_pd->m_nodes.at(id).collapsed)
+            collapsed.append(id);
+    }
+
+    QByteArray state;
+    QDataStream stream(&state, QIODevice::WriteOnly);
+    stream.setVersion(QDataStream::Qt_5_0);
+    stream << HeaderViewStateMagic << HeaderViewStateVersion << QHeaderView::saveState() << collapsed;
+    return state;
+}
+
+bool HierarchicalHeaderView::restoreState(const QByteArray &state)
+{
+    QDataStream stream(state);
+    stream.setVersion(QDataStream::Qt_5_0);
+    quint32 magic = 0;
+    quint8 version = 0;
+    QByteArray sections;
+    QVector<qint32> collapsed;
+    stream >> magic >> version;
+    if (magic != HeaderViewStateMagic || version != HeaderViewStateVersion)
+        return false;
+    stream >> sections >> collapsed;
+    if (stream.status() != QDataStream::Ok)
+        return false;
+
+    // hidden sections are part of the base state, the collapse flags only need to be set
+    beginSectionBatch();
+    bool result = QHeaderView::restoreState(sections);
+    _pd->m_collapsed.clear();
+    _pd->invalidateLayout();
+    _pd->ensureLayout();
+    for (int i = 0; i < collapsed.size(); ++i) {
+        if (collapsed.at(i) >= 0 && collapsed.at(i) < _pd->m_nodes.size())
+            _pd->setGroupCollapsed(collapsed.at(i), true);
+    }
+    endSectionBatch();
+    return result;
+}
+
+quint64 HierarchicalHeaderView::layoutVersion() const
+{
+    return _pd->m_layoutVersion;
+}
+
+/**
+ * @brief HierarchicalHeaderView::verifyLayoutCache compare the cached layout (nodes, leaf map,
+ * collapsed state, cell extents and visual spans still marked valid) against a from-scratch
+ * computation; meant for stress runs, it walks the whole header
+ * @param error : receives the first difference found
+ */
+bool HierarchicalHeaderView::verifyLayoutCache(QString *error) const
+{
+    QString message;
+    const bool result = _pd->verify(this, message);
+    if (error != Q_NULLPTR)
+        *error = message;
+    return result;
+}
+
+/**
+ * @brief HierarchicalHeaderView::layoutSnapshot immutable copy of the current layout.
+ * The snapshot is rebuilt only when the layout version changed, otherwise the cached
+ * one is shared; it can be handed to worker threads while the view keeps changing
+ */
+HierarchicalHeaderLayout HierarchicalHeaderView::layoutSnapshot() const
+{
+    const bool horizontal = orientation() == Qt::Horizontal;
+    const int thickness = horizontal ? viewport()->height() : viewport()->width();
+    if (!_pd->m_snapshot.isNull() && _pd->m_snapshot.version() == _pd->m_layoutVersion
+            && _pd->m_snapshot.thickness() == thickness)
+        return _pd->m_snapshot;
+
+    HierarchicalHeaderLayoutData *data = new HierarchicalHeaderLayoutData;
+    data->version = _pd->m_layoutVersion;
+    data->orientation = orientation();
+    data->length = length();
+    data->thickness = thickness;
+
+    data->sections.resize(count());
+    data->logicalIndexes.resize(count());
+    for (int i = 0; i < count(); ++i) {
+        HierarchicalHeaderLayout::Section &section = data->sections[i];
+        section.position = sectionPosition(i);
+        section.size = sectionSize(i);
+        section.visualIndex = visualIndex(i);
+        section.hidden = isSectionHidden(i);
+        data->logicalIndexes[i] = logicalIndex(i);
+    }
+
+    if (!_pd->headerModel.isNull()) {
+        _pd->ensureExtents(this);
+        data->leafNodes = _pd->m_leafNodes;
+        data->nodes.resize(_pd->m_nodes.size());
+        for (int id = 0; id < _pd->m_nodes.size(); ++id) {
+            const private_data::LayoutNode &source = _pd->m_nodes.at(id);
+            HierarchicalHeaderLayout::Node &node = data->nodes[id];
+            node.title = source.index.data(Qt::DisplayRole).toString();
+            node.parent = source.parent;
+            node.depth = source.depth;
+            node.firstLeaf = source.firstLeaf;
+            node.leafCount = source.leafCount;
+            node.offset = _pd->m_nodeOffsets.at(id);
+            node.extent = _pd->m_nodeExtents.at(id);
+            node.collapsed = source.collapsed;
+            node.selected = source.leafCount == 1 && _pd->m_leafNodes.value(source.firstLeaf) == id
+                    && _pd->isSelected(source.firstLeaf, source.index) ? 1 : 0;
+            node.arrow = source.index.data(HierarchicalHeaderModel::Arrow).toInt();
+            node.filterBtnState = source.index.data(HierarchicalHeaderModel::FilterBtnState).toInt();
+            node.canFilter = source.index.data(HierarchicalHeaderModel::CanFilter).toInt();
+
+            int first, last;
+            _pd->visualSpan(this, id, first, last);
+            first = logicalIndex(first);
+            last = logicalIndex(last);
+            node.begin = qMin(sectionPosition(first), sectionPosition(last));
+            node.end = qMax(sectionPosition(first) + sectionSize(first), sectionPosition(last) + sectionSize(last));
+        }
+    }
+
+    _pd->m_snapshot = HierarchicalHeaderLayout(data);
+    return _pd->m_snapshot;
 }
 
-void HierarchicalHeaderView::mousePressEvent(QMouseEvent *e)
+/**
+ * @brief HierarchicalHeaderView::renderer headless renderer over the current layout, with the
+ * colors, font and alignments of this view; it can be used from worker threads
+ */
+HierarchicalHeaderRenderer HierarchicalHeaderView::renderer() const
 {
-    if (cursor().shape() != Qt::SplitHCursor && sectionsClickable() && e->button() == Qt::LeftButton) {
-        int logicalIndex = logicalIndexAt(e->pos());
-        if (logicalIndex < 0)
+    HierarchicalHeaderRenderer result(layoutSnapshot());
+    for (int role = SelectedBackGroundRole; role <= SearchMatchBackGroundRole; ++role)
+        result.setColor(ColorRole(role), _pd->getColor(ColorRole(role)));
+    result.setFont(font());
+    result.setLeafAlignment(_pd->m_leafAlignment);
+    result.setHeaderAlignment(_pd->m_headerAlignment);
+    result.setFilterButtonsVisible(_pd->m_canFilter);
+    return result;
+}
+
+/**
+ * @brief HierarchicalHeaderView::setRowGroups group the rows of a vertical header by row ranges
+ * instead of a header tree, cost and memory follow the number of groups, not the number of rows.
+ * An empty groups object switches back to the normal header.
+ */
+void HierarchicalHeaderView::setRowGroups(const HierarchicalRowGroups &groups)
+{
+    _pd->m_rowGroups = groups;
+    headerDataChanged(orientation(), 0, qMax(0, count() - 1));
+    emit geometriesChanged();
+    viewport()->update();
+}
+
+HierarchicalRowGroups HierarchicalHeaderView::rowGroups() const
+{
+    return _pd->m_rowGroups;
+}
+
+void HierarchicalHeaderView::setRowGroupWidth(int width)
+{
+    _pd->m_rowGroupWidth = qMax(0, width);
+    if (_pd->hasRowGroups(this)) {
+        headerDataChanged(orientation(), 0, qMax(0, count() - 1));
+        emit geometriesChanged();
+        viewport()->update();
+    }
+}
+
+/**
+ * @brief HierarchicalHeaderView::setSearchText highlight the cells whose title contains text
+ * (starts with it in PrefixSearch mode) and jump to the first match.
+ * The lookup goes through a HierarchicalHeaderSearchIndex kept up to date with the header model.
+ */
+void HierarchicalHeaderView::setSearchText(const QString &text, SearchMode mode)
+{
+    _pd->m_searchText = text;
+    _pd->m_searchMode = mode;
+    _pd->m_searchCurrent = -1;
+    refreshSearch();
+    if (!_pd->m_searchMatches.isEmpty()) {
+        _pd->m_searchCurrent = 0;
+        showSearchMatch();
+    }
+    if (_pd->m_searchBox != Q_NULLPTR && _pd->m_searchBox->text() != text)
+        _pd->m_searchBox->setText(text);
+    viewport()->update();
+}
+
+QString HierarchicalHeaderView::searchText() const
+{
+    return _pd->m_searchText;
+}
+
+int HierarchicalHeaderView::searchMatchCount() const
+{
+    return _pd->m_searchMatches.size();
+}
+
+QModelIndex HierarchicalHeaderView::currentSearchMatch() const
+{
+    if (_pd->m_searchCurrent < 0)
+        return QModelIndex();
+    return _pd->m_searchMatches.at(_pd->m_searchCurrent);
+}
+
+bool HierarchicalHeaderView::findNext()
+{
+    if (_pd->m_searchStale)
+        refreshSearch();
+    if (_pd->m_searchMatches.isEmpty())
+        return false;
+
+    _pd->m_searchCurrent = (_pd->m_searchCurrent + 1) % _pd->m_searchMatches.size();
+    showSearchMatch();
+    viewport()->update();
+    return true;
+}
+
+bool HierarchicalHeaderView::findPrevious()
+{
+    if (_pd->m_searchStale)
+        refreshSearch();
+    if (_pd->m_searchMatches.isEmpty())
+        return false;
+
+    const int count = _pd->m_searchMatches.size();
+    _pd->m_searchCurrent = _pd->m_searchCurrent <= 0 ? count - 1 : _pd->m_searchCurrent - 1;
+    showSearchMatch();
+    viewport()->update();
+    return true;
+}
+
+void HierarchicalHeaderView::setSearchBoxVisible(bool visible)
+{
+    if (_pd->m_searchBox == Q_NULLPTR) {
+        if (!visible)
             return;
-        if (checkIsFilterBtnClicked(logicalIndex)) {
+        _pd->m_searchBox = new QLineEdit(this);
+        _pd->m_searchBox->setPlaceholderText(tr("Search"));
+        _pd->m_searchBox->setClearButtonEnabled(true);
+        _pd->m_searchBox->setText(_pd->m_searchText);
+        connect(_pd->m_searchBox, SIGNAL(textEdited(QString)), this, SLOT(slotSearchTextEdited(QString)));
+        connect(_pd->m_searchBox, SIGNAL(returnPressed()), this, SLOT(slotSearchReturnPressed()));
+    }
+    _pd->m_searchBox->setVisible(visible);
+    if (visible) {
+        placeSearchBox();
+        _pd->m_searchBox->setFocus();
+    }
+}
+
+bool HierarchicalHeaderView::isSearchBoxVisible() const
+{
+    return _pd->m_searchBox != Q_NULLPTR && _pd->m_searchBox->isVisible();
+}
+
+void HierarchicalHeaderView::resizeEvent(QResizeEvent *e)
+{
+    QHeaderView::resizeEvent(e);
+    if (isSearchBoxVisible())
+        placeSearchBox();
+}
+
+void HierarchicalHeaderView::placeSearchBox()
+{
+    const int width = qMin(160, viewport()->width() - 4);
+    const int height = qMin(_pd->m_searchBox->sizeHint().height(), viewport()->height() - 2);
+    _pd->m_searchBox->setGeometry(viewport()->width() - width - 2, 1, width, height);
+    _pd->m_searchBox->raise();
+}
+
+void HierarchicalHeaderView::slotSearchTextEdited(const QString &text)
+{
+    setSearchText(text, _pd->m_searchMode);
+}
+
+void HierarchicalHeaderView::slotSearchReturnPressed()
+{
+    if (QApplication::keyboardModifiers() & Qt::ShiftModifier)
+        findPrevious();
+    else
+        findNext();
+}
+
+/**
+ * @brief HierarchicalHeaderView::refreshSearch run the query again and order the matches by the
+ * visual position of their first leaf, a parent before its children; the current match is kept
+ */
+void HierarchicalHeaderView::refreshSearch()
+{
+    const QPersistentModelIndex current = _pd->m_searchCurrent >= 0 ? _pd->m_searchMatches.at(_pd->m_searchCurrent)
+                                                                     : QPersistentModelIndex();
+    _pd->m_searchStale = false;
+    _pd->m_searchMatches.clear();
+    _pd->m_searchCurrent = -1;
+    _pd->m_searchNodesValid = false;
+
+    if (!_pd->m_searchText.isEmpty() && !_pd->headerModel.isNull()) {
+        if (_pd->m_searchIndex == Q_NULLPTR)
+            _pd->m_searchIndex = new HierarchicalHeaderSearchIndex(this);
+        _pd->m_searchIndex->setModel(_pd->headerModel.data());
+        const QList<QPersistentModelIndex> &matches = _pd->m_searchIndex->search(
+                    _pd->m_searchText, _pd->m_searchMode == PrefixSearch ? HierarchicalHeaderSearchIndex::PrefixMatch
+                                                                         : HierarchicalHeaderSearchIndex::SubstringMatch);
+        QVector<QPair<QPair<int, int>, int> > order;
+        for (int i = 0; i < matches.size(); ++i) {
+            const int node = _pd->nodeId(matches.at(i));
+            if (node < 0)
+                continue;
+            int first, last;
+            _pd->visualSpan(this, node, first, last);
+            order.append(qMakePair(qMakePair(first, _pd->m_nodes.at(node).depth), i));
         }
-        else if (getCanSort())
-        {
-            if (e->modifiers() == Qt::ControlModifier) {
-                clearArrowType(logicalIndex);
-            }
-            else
-                setClickSelectedColumn(logicalIndex);
+        std::sort(order.begin(), order.end());
+        for (int i = 0; i < order.size(); ++i) {
+            const QPersistentModelIndex &match = matches.at(order.at(i).second);
+            if (match == current)
+                _pd->m_searchCurrent = i;
+            _pd->m_searchMatches.append(match);
         }
-        setSelectedColumn(logicalIndex);
     }
-    return QHeaderView::mousePressEvent(e);
+    emit signalSearchMatchesChanged(_pd->m_searchMatches.size());
 }
 
-void HierarchicalHeaderView::mouseMoveEvent(QMouseEvent *e)
+// expand the collapsed groups hiding the current match and scroll its first leaf into view
+void HierarchicalHeaderView::showSearchMatch()
 {
-    return QHeaderView::mouseMoveEvent(e);
+    int node = _pd->nodeId(_pd->m_searchMatches.at(_pd->m_searchCurrent));
+    if (node < 0)
+        return;
+
+    for (int ancestor = _pd->collapsedAncestor(node); ancestor >= 0; ancestor = _pd->collapsedAncestor(node))
+        setGroupCollapsed(_pd->m_nodes.at(ancestor).index, false);
+    scrollToSection(_pd->m_nodes.at(node).firstLeaf);
 }
 
-void HierarchicalHeaderView::mouseReleaseEvent(QMouseEvent *e)
+void HierarchicalHeaderView::scrollToSection(int logicalIndex)
 {
-    return QHeaderView::mouseReleaseEvent(e);
+    // the offset of a header inside an item view follows the view's scroll bars
+    QAbstractItemView *itemView = qobject_cast<QAbstractItemView *>(parentWidget());
+    if (itemView != Q_NULLPTR && itemView->model() != Q_NULLPTR) {
+        const QModelIndex &topLeft = itemView->indexAt(QPoint(0, 0));
+        const QModelIndex &target = orientation() == Qt::Horizontal
+                ? itemView->model()->index(topLeft.isValid() ? topLeft.row() : 0, logicalIndex, itemView->rootIndex())
+                : itemView->model()->index(logicalIndex, topLeft.isValid() ? topLeft.column() : 0, itemView->rootIndex());
+        if (target.isValid()) {
+            itemView->scrollTo(target);
+            return;
+        }
+    }
+    setOffsetToSectionPosition(visualIndex(logicalIndex));
 }
 
-bool HierarchicalHeaderView::viewportEvent(QEvent *e)
+/**
+ * @brief HierarchicalHeaderView::setAggregateModel table model whose columns (one per leaf section)
+ * feed the aggregate band; the aggregates follow its changes incrementally
+ */
+void HierarchicalHeaderView::setAggregateModel(QAbstractItemModel *model, int role)
 {
-    return QHeaderView::viewportEvent(e);
+    if (_pd->m_aggregates == Q_NULLPTR) {
+        _pd->m_aggregates = new HierarchicalHeaderAggregates(this);
+        connect(_pd->m_aggregates, SIGNAL(signalAggregatesChanged()), viewport(), SLOT(update()));
+    }
+    _pd->m_aggregates->setSourceModel(model, role);
+    _pd->m_nodeAggregatesValid = false;
+    updateAggregateBand();
 }
 
-bool HierarchicalHeaderView::checkIsFilterBtnClicked(const int &logicalIndex)
+void HierarchicalHeaderView::setAggregateFunctions(AggregateFunctions functions)
 {
-    QModelIndex leafIndex(_pd->leafIndex(logicalIndex));
-    if (!leafIndex.isValid() || !getCanFilter())
-        return false;
-    int type = !_pd->headerModel.isNull() ? _pd->headerModel->data(leafIndex, HierarchicalHeaderModel::CanFilter).toInt() : 0;
-    if (type == 0)
-        return false;
-    int frameSize = 14;
-    QPoint pt = this->mapFromGlobal(QCursor::pos());
-    int columnleft = sectionViewportPosition(logicalIndex);
-    int width = _pd->currentCellWidth(leafIndex, leafIndex, logicalIndex, this);
-    int height = viewport()->height();
-    int frameLeft = columnleft + width - frameSize - 2;
-    if ((frameLeft <= pt.x() && (pt.x() <= columnleft + width))
-            && (pt.y() < height && (pt.y() > height - frameSize - 2))) {
-        QRect popRect(columnleft, 0, width, height);
-        bool btnState = !_pd->headerModel.isNull() ? _pd->headerModel->data(leafIndex, HierarchicalHeaderModel::FilterBtnState).toBool() : false;
-        if (!btnState) {
-            emit signalFilterBtnClicked(logicalIndex, popRect);
-        }
-        int colunm = getPrevSelected();
-        setColunmFilterState(logicalIndex, !btnState, HierarchicalHeaderModel::FilterBtnState);
-        if (colunm != logicalIndex)
-            setColunmFilterState(colunm, false, HierarchicalHeaderModel::FilterBtnState);
-        return  true;
-    }
-    return  false;
+    _pd->m_aggregateFunctions = functions;
+    updateAggregateBand();
+}
+
+HierarchicalHeaderView::AggregateFunctions HierarchicalHeaderView::aggregateFunctions() const
+{
+    return _pd->m_aggregateFunctions;
+}
+
+void HierarchicalHeaderView::setAggregateBandVisible(bool visible)
+{
+    _pd->m_aggregateBand = visible;
+    updateAggregateBand();
+}
+
+bool HierarchicalHeaderView::isAggregateBandVisible() const
+{
+    return _pd->m_aggregateBand;
+}
+
+// band height is one text line per aggregate function, every cell of a section gets one band
+void HierarchicalHeaderView::updateAggregateBand()
+{
+    int height = 0;
+    if (_pd->m_aggregateBand && _pd->m_aggregates != Q_NULLPTR && orientation() == Qt::Horizontal) {
+        int lines = 0;
+        for (int function = AggregateSum; function <= AggregateMean; function <<= 1) {
+            if (_pd->m_aggregateFunctions & function)
+                ++lines;
+        }
+        if (lines > 0)
+            height = lines * fontMetrics().height() + 4;
+    }
+    if (height == _pd->m_aggregateBandHeight) {
+        viewport()->update();
+        return;
+    }
+
+    _pd->m_aggregateBandHeight = height;
+    _pd->invalidateExtents();
+    headerDataChanged(orientation(), 0, qMax(0, count() - 1));
+    emit geometriesChanged();
+    viewport()->update();
 }
 
 void HierarchicalHeaderView::setSelectedColumn(const int &logicalIndex)
 {
+    if (_pd->hierarchicalModel() != Q_NULLPTR) {
+        // repaints come through signalSelectionChanged
+        _pd->m_selectionAnchor = logicalIndex;
+        if (logicalIndex < 0)
+            _pd->clearSelection();
+        else
+            _pd->setSelectedColumn(logicalIndex);
+        return;
+    }
     if (logicalIndex < 0) {
         _pd->clearSelection();
         int select = _pd->getPrevSelected();
@@ -825,9 +2569,123 @@ int HierarchicalHeaderView::getPrevSelected() const
     return _pd->getPrevSelected();
 }
 
+QRect HierarchicalHeaderView::sectionRect(int logicalIndex) const
+{
+    int position = sectionViewportPosition(logicalIndex);
+    int size = sectionSize(logicalIndex);
+    if (orientation() == Qt::Horizontal)
+        return QRect(position, 0, size, viewport()->height());
+    return QRect(0, position, viewport()->width(), size);
+}
+
+void HierarchicalHeaderView::paintEvent(QPaintEvent *e)
+{
+    HIERARCHICAL_HEADER_TRACE("paintEvent");
+    if ((_pd->headerModel.isNull() && !_pd->hasRowGroups(this)) || count() == 0)
+        return QHeaderView::paintEvent(e);
+    if (_pd->m_searchStale)
+        refreshSearch();
+
+    const bool horizontal = orientation() == Qt::Horizontal;
+    const QRect &area = e->rect();
+    int first = visualIndexAt(horizontal ? area.left() : area.top());
+    int last = visualIndexAt(horizontal ? area.right() : area.bottom());
+    if (horizontal && isRightToLeft())
+        qSwap(first, last);
+    if (first < 0)
+        first = 0;
+    if (last < 0)
+        last = count() - 1;
+
+    if (_pd->hasRowGroups(this)) {
+        QPainter painter(viewport());
+        private_data::PaintBatch batch;
+        _pd->batchRowGroups(batch, this, first, last);
+        _pd->flushBatch(&painter, this, batch);
+
+        const int groupsWidth = _pd->rowGroupsWidth(this);
+        for (int i = first; i <= last; ++i) {
+            int logical = logicalIndex(i);
+            if (isSectionHidden(logical))
+                continue;
+            painter.save();
+            paintSection(&painter, sectionRect(logical).adjusted(groupsWidth, 0, 0, 0), logical);
+            painter.restore();
+        }
+        return;
+    }
+
+    bool overview = true;
+    for (int i = first; i <= last && overview; ++i) {
+        int logical = logicalIndex(i);
+        if (!isSectionHidden(logical))
+            overview = _pd->detailLevel(sectionSize(logical)) == OverviewDetail;
+    }
+
+    QPainter painter(viewport());
+    if (overview) {
+        _pd->paintOverview(&painter, this, first, last);
+        return;
+    }
+
+    // every visible cell is collected once, consecutive narrow leaves sharing a parent
+    // are merged into one band, then the whole batch is submitted at once
+    private_data::PaintBatch batch;
+    const QColor &parentColor = painter.background().color();
+    int runLeaf = -1;
+    int runParent = -1;
+    QRect runRect;
+    for (int i = first; i <= last + 1; ++i) {
+        int logical = (i <= last) ? logicalIndex(i) : -1;
+        if (logical >= 0 && isSectionHidden(logical))
+            continue;
+
+        int leaf = _pd->leafNode(logical);
+        bool isNarrow = leaf >= 0 && _pd->detailLevel(sectionSize(logical)) != FullDetail;
+        int parent = isNarrow ? _pd->m_nodes.at(leaf).parent : -1;
+        if (runLeaf >= 0 && (!isNarrow || parent != runParent)) {
+            _pd->batchBand(batch, runRect, runLeaf, horizontal);
+            runLeaf = -1;
+        }
+        if (logical < 0)
+            break;
+
+        if (leaf < 0) {
+            painter.save();
+            paintSection(&painter, sectionRect(logical), logical);
+            painter.restore();
+            continue;
+        }
+
+        const QRect &leafRect = _pd->batchSection(batch, this, logical, parentColor, isNarrow);
+        if (!isNarrow || leafRect.isNull())
+            continue;
+        if (runLeaf < 0) {
+            runLeaf = leaf;
+            runParent = parent;
+            runRect = leafRect;
+        } else {
+            runRect |= leafRect;
+        }
+    }
+    _pd->flushBatch(&painter, this, batch);
+
+    if (_pd->m_dragActive && _pd->m_dropNode >= 0) {
+        const QRect &target = _pd->spanRect(this, _pd->m_dropNode, 0, 0);
+        bool atEnd = _pd->m_dropAfter != (horizontal && isRightToLeft());
+        if (horizontal)
+            painter.fillRect(QRect((atEnd ? target.right() + 1 : target.left()) - 1, 0, 2, viewport()->height()),
+                             palette().highlight());
+        else
+            painter.fillRect(QRect(0, (atEnd ? target.bottom() + 1 : target.top()) - 1, viewport()->width(), 2),
+                             palette().highlight());
+    }
+}
+
 void HierarchicalHeaderView::paintSection(QPainter *painter,
                 const QRect &rect, int logicalIndex) const
 {
+    HIERARCHICAL_HEADER_TRACE("paintSection");
     if (rect.isValid())
     {
         QModelIndex leafIndex(_pd->leafIndex(logicalIndex));
@@ -845,7 +2703,9 @@ void HierarchicalHeaderView::paintSection(QPainter *painter,
 
 void HierarchicalHeaderView::slotSectionResized(int logicalIndex)
 {
-    if (isSectionHidden(logicalIndex))
+    HIERARCHICAL_HEADER_TRACE("slotSectionResized");
+    _pd->touchLayout();
+    if (_pd->inSectionBatch() || isSectionHidden(logicalIndex))
         return;
 
     QModelIndex leafIndex(_pd->leafIndex(logicalIndex));
@@ -878,14 +2738,337 @@ void HierarchicalHeaderView::slotHeaderDataChange(int logicalIndex)
     headerDataChanged(Qt::Horizontal, logicalIndex, logicalIndex);
 }
 
+void HierarchicalHeaderView::slotHeaderLayoutChanged()
+{
+    HIERARCHICAL_HEADER_TRACE_INSTANT("invalidateLayout");
+    _pd->invalidateLayout();
+    _pd->m_searchStale = !_pd->m_searchText.isEmpty();
+}
+
+void HierarchicalHeaderView::slotHeaderTitleChanged(const QModelIndex &, const QModelIndex &, const QVector<int> &roles)
+{
+    if (roles.isEmpty() || roles.contains(Qt::DisplayRole)
+            || roles.contains(Qt::FontRole) || roles.contains(Qt::SizeHintRole)) {
+        _pd->invalidateExtents();
+        _pd->m_searchStale = !_pd->m_searchText.isEmpty();
+    } else if (roles.contains(Qt::DecorationRole) || roles.contains(HierarchicalHeaderModel::IconName)) {
+        // an icon added or removed changes the size of the cell
+        _pd->invalidateExtents();
+    } else
+        _pd->touchLayout();
+}
+
+/**
+ * @brief HierarchicalHeaderView::setLevelSize row height (column width for vertical headers) of the
+ * parent cells at depth; 0 sizes the level to its largest title again
+ */
+void HierarchicalHeaderView::setLevelSize(int depth, int size)
+{
+    if (depth < 0)
+        return;
+    if (depth >= _pd->m_fixedLevelExtents.size()) {
+        if (size <= 0)
+            return;
+        _pd->m_fixedLevelExtents.resize(depth + 1);
+    }
+    if (_pd->m_fixedLevelExtents.at(depth) == qMax(0, size))
+        return;
+    _pd->m_fixedLevelExtents[depth] = qMax(0, size);
+    _pd->invalidateExtents();
+    headerDataChanged(orientation(), 0, qMax(0, count() - 1));
+    viewport()->update();
+}
+
+// size of the parent cells at depth, measured or set; 0 when the header has no parent at depth
+int HierarchicalHeaderView::levelSize(int depth) const
+{
+    if (_pd->headerModel.isNull())
+        return 0;
+    _pd->ensureExtents(this);
+    return depth >= 0 && depth < _pd->m_levelExtents.size() ? _pd->m_levelExtents.at(depth) : 0;
+}
+
+/**
+ * @brief HierarchicalHeaderView::setIconCache where cell icons are decoded and kept, the cache shared
+ * by all views by default; Q_NULLPTR leaves named icons out
+ */
+void HierarchicalHeaderView::setIconCache(HierarchicalHeaderIconCache *cache)
+{
+    if (!_pd->m_iconCache.isNull())
+        disconnect(_pd->m_iconCache, SIGNAL(signalIconReady(QString)), viewport(), SLOT(update()));
+    _pd->m_iconCache = cache;
+    if (cache != Q_NULLPTR)
+        connect(cache, SIGNAL(signalIconReady(QString)), viewport(), SLOT(update()));
+    viewport()->update();
+}
+
+HierarchicalHeaderIconCache *HierarchicalHeaderView::iconCache() const
+{
+    return _pd->m_iconCache.data();
+}
+
+void HierarchicalHeaderView::slotIconSizeChanged()
+{
+    _pd->invalidateExtents();
+    headerDataChanged(orientation(), 0, qMax(0, count() - 1));
+    viewport()->update();
+}
+
+// only the leaves of the toggled columns change color
+void HierarchicalHeaderView::slotSelectionChanged(int first, int last)
+{
+    _pd->touchLayout();
+    if (sectionsMoved() || first < 0 || last >= count()) {
+        viewport()->update();
+        return;
+    }
+    viewport()->update(sectionRect(first).united(sectionRect(last)));
+}
+
+void HierarchicalHeaderView::slotSectionMoved(int logicalIndex, int oldVisualIndex, int newVisualIndex)
+{
+    _pd->invalidateVisualSpans();
+    if (_pd->inSectionBatch() || _pd->isLeafPlacementValid(this, logicalIndex))
+        return;
+
+    // a single leaf dragged out of its group, or into the middle of another one
+    beginSectionBatch();
+    moveSection(newVisualIndex, oldVisualIndex);
+    endSectionBatch();
+}
+
 void HierarchicalHeaderView::setModel(QAbstractItemModel *model)
 {
+    if (HierarchicalHeaderModel *hierarchicalModel = _pd->hierarchicalModel())
+        disconnect(hierarchicalModel, SIGNAL(signalSelectionChanged(int, int)), this, SLOT(slotSelectionChanged(int, int)));
+    if (!_pd->headerModel.isNull())
+        _pd->headerModel->disconnect(this);
     _pd->initFromNewModel(orientation(), model);
+    _pd->m_selectionAnchor = -1;
+    _pd->m_searchMatches.clear();
+    _pd->m_searchCurrent = -1;
+    _pd->m_searchStale = !_pd->m_searchText.isEmpty();
+    if (!_pd->headerModel.isNull()) {
+        QAbstractItemModel *headerModel = _pd->headerModel.data();
+        connect(headerModel, SIGNAL(modelReset()), this, SLOT(slotHeaderLayoutChanged()));
+        connect(headerModel, SIGNAL(layoutChanged()), this, SLOT(slotHeaderLayoutChanged()));
+        connect(headerModel, SIGNAL(columnsInserted(QModelIndex, int, int)), this, SLOT(slotHeaderLayoutChanged()));
+        connect(headerModel, SIGNAL(columnsRemoved(QModelIndex, int, int)), this, SLOT(slotHeaderLayoutChanged()));
+        connect(headerModel, SIGNAL(columnsMoved(QModelIndex, int, int, QModelIndex, int)), this, SLOT(slotHeaderLayoutChanged()));
+        connect(headerModel, SIGNAL(rowsRemoved(QModelIndex, int, int)), this, SLOT(slotHeaderLayoutChanged()));
+        connect(headerModel, SIGNAL(dataChanged(QModelIndex, QModelIndex, QVector<int>)), this, SLOT(slotHeaderTitleChanged(QModelIndex, QModelIndex, QVector<int>)));
+    }
+    if (HierarchicalHeaderModel *hierarchicalModel = _pd->hierarchicalModel())
+        connect(hierarchicalModel, SIGNAL(signalSelectionChanged(int, int)), this, SLOT(slotSelectionChanged(int, int)));
     QHeaderView::setModel(model);
     int cnt = (orientation() == Qt::Horizontal ? model->columnCount() : model->rowCount());
     if (cnt) initializeSections(0, cnt - 1);
 }
 
+void HierarchicalHeaderView::setDetailThresholds(int simplifiedWidth, int overviewWidth)
+{
+    _pd->setDetailThresholds(simplifiedWidth, overviewWidth);
+    viewport()->update();
+}
+
+HierarchicalHeaderView::DetailLevel HierarchicalHeaderView::detailLevel(int logicalIndex) const
+{
+    return _pd->detailLevel(sectionSize(logicalIndex));
+}
+
+void HierarchicalHeaderView::setGroupsCollapsible(bool flag)
+{
+    _pd->setGroupsCollapsible(flag);
+    viewport()->update();
+}
+
+bool HierarchicalHeaderView::groupsCollapsible() const
+{
+    return _pd->groupsCollapsible();
+}
+
+void HierarchicalHeaderView::setGroupCollapsed(const QModelIndex &groupIndex, bool collapsed)
+{
+    int node = _pd->nodeId(groupIndex);
+    if (!_pd->setGroupCollapsed(node, collapsed))
+        return;
+
+    applyGroupVisibility(node);
+    emit signalGroupCollapsed(groupIndex, collapsed);
+}
+
+bool HierarchicalHeaderView::isGroupCollapsed(const QModelIndex &groupIndex) const
+{
+    int node = _pd->nodeId(groupIndex);
+    return node >= 0 && _pd->m_nodes.at(node).collapsed;
+}
+
+void HierarchicalHeaderView::toggleGroup(const QModelIndex &groupIndex)
+{
+    setGroupCollapsed(groupIndex, !isGroupCollapsed(groupIndex));
+}
+
+void HierarchicalHeaderView::beginSectionBatch()
+{
+    if (!_pd->inSectionBatch())
+        setUpdatesEnabled(false);
+    _pd->beginSectionBatch();
+}
+
+void HierarchicalHeaderView::endSectionBatch()
+{
+    if (!_pd->endSectionBatch())
+        return;
+
+    setUpdatesEnabled(true);
+    updateGeometries();
+    viewport()->update();
+}
+
+/**
+ * @brief HierarchicalHeaderView::applyGroupVisibility hide or show the leaves of node
+ * in one batch, a collapsed group keeps its first leaf as summary section
+ */
+void HierarchicalHeaderView::applyGroupVisibility(int node)
+{
+    const int first = _pd->m_nodes.at(node).firstLeaf;
+    const int last = first + _pd->m_nodes.at(node).leafCount - 1;
+    beginSectionBatch();
+    for (int section = first; section <= last && section < count(); ++section) {
+        bool hidden = _pd->isLeafCollapsedAway(_pd->leafNode(section));
+        if (isSectionHidden(section) != hidden)
+            setSectionHidden(section, hidden);
+    }
+    endSectionBatch();
+}
+
+/**
+ * @brief HierarchicalHeaderView::resizeGroup give the group size pixels, spread over its visible
+ * interactive leaves in proportion to their sizes, within the leaf limits (MinimumSize, MaximumSize
+ * of the model, minimumSectionSize() and maximumSectionSize()); one layout and repaint for all leaves
+ */
+bool HierarchicalHeaderView::resizeGroup(const QModelIndex &groupIndex, int size)
+{
+    const int node = _pd->nodeId(groupIndex);
+    QVector<int> sections, sizes;
+    if (node < 0 || !groupResizeSections(node, sections, sizes))
+        return false;
+    applyGroupSize(sections, sizes, size);
+    emit signalGroupResized(groupIndex, size);
+    return true;
+}
+
+// visible leaves of node the user may resize, with their current sizes
+bool HierarchicalHeaderView::groupResizeSections(int node, QVector<int> &sections, QVector<int> &sizes) const
+{
+    sections.clear();
+    sizes.clear();
+    const int first = _pd->m_nodes.at(node).firstLeaf;
+    const int last = first + _pd->m_nodes.at(node).leafCount - 1;
+    for (int section = first; section <= last && section < count(); ++section) {
+        if (isSectionHidden(section) || sectionResizeMode(section) != Interactive)
+            continue;
+        sections.append(section);
+        sizes.append(sectionSize(section));
+    }
+    return !sections.isEmpty();
+}
+
+void HierarchicalHeaderView::applyGroupSize(const QVector<int> &sections, const QVector<int> &sizes, int size)
+{
+    HIERARCHICAL_HEADER_TRACE("applyGroupSize");
+    QVector<int> minimum(sections.size());
+    QVector<int> maximum(sections.size());
+    int lower = 0;
+    int upper = 0;
+    for (int i = 0; i < sections.size(); ++i) {
+        const QModelIndex &leafIndex = _pd->leafIndex(sections.at(i));
+        const int leafMinimum = leafIndex.data(HierarchicalHeaderModel::MinimumSize).toInt();
+        const int leafMaximum = leafIndex.data(HierarchicalHeaderModel::MaximumSize).toInt();
+        minimum[i] = qMax(minimumSectionSize(), leafMinimum);
+        maximum[i] = qMax(minimum.at(i), leafMaximum > 0 ? qMin(maximumSectionSize(), leafMaximum) : maximumSectionSize());
+        lower += minimum.at(i);
+        upper = qMin(INT_MAX - maximum.at(i), upper) + maximum.at(i);
+    }
+
+    const QVector<int> &result = private_data::distributeSizes(sizes, minimum, maximum, qBound(lower, size, upper));
+    beginSectionBatch();
+    for (int i = 0; i < sections.size(); ++i) {
+        if (sectionSize(sections.at(i)) != result.at(i))
+            resizeSection(sections.at(i), result.at(i));
+    }
+    endSectionBatch();
+}
+
+/**
+ * @brief HierarchicalHeaderView::moveGroup move all leaves of groupIndex next to its sibling targetIndex
+ * @param after : true to drop behind targetIndex, false to drop in front of it
+ */
+bool HierarchicalHeaderView::moveGroup(const QModelIndex &groupIndex, const QModelIndex &targetIndex, bool after)
+{
+    int node = _pd->nodeId(groupIndex);
+    int target = _pd->nodeId(targetIndex);
+    if (node < 0 || target < 0 || node == target
+            || _pd->m_nodes.at(node).parent != _pd->m_nodes.at(target).parent)
+        return false;
+
+    int first, last, targetFirst, targetLast;
+    _pd->visualSpan(this, node, first, last);
+    _pd->visualSpan(this, target, targetFirst, targetLast);
+    const int count = last - first + 1;
+    int to = 0;
+    if (targetFirst > last)
+        to = (after ? targetLast + 1 : targetFirst) - count;
+    else
+        to = after ? targetLast + 1 : targetFirst;
+    if (to == first)
+        return false;
+
+    beginSectionBatch();
+    moveVisualBlock(first, count, to);
+    endSectionBatch();
+    emit signalGroupMoved(groupIndex);
+    return true;
+}
+
+/**
+ * @brief HierarchicalHeaderView::moveVisualBlock move count sections starting at visual index from
+ * so that the first of them ends up at visual index to. The target order of the touched range is built
+ * once and applied from the side that needs fewer moveSection calls; every move is still announced by
+ * sectionMoved, the header itself lays out and repaints once at the end of the batch
+ */
+void HierarchicalHeaderView::moveVisualBlock(int from, int count, int to)
+{
+    if (count <= 0 || from == to)
+        return;
+
+    const int low = qMin(from, to);
+    const int displaced = qAbs(to - from);
+    QVector<int> order;
+    order.reserve(count + displaced);
+    if (to > from) {
+        for (int visual = from + count; visual < to + count; ++visual)
+            order.append(logicalIndex(visual));
+    }
+    for (int visual = from; visual < from + count; ++visual)
+        order.append(logicalIndex(visual));
+    if (to < from) {
+        for (int visual = to; visual < from; ++visual)
+            order.append(logicalIndex(visual));
+    }
+
+    // placing front to back moves the sections that go left, back to front the ones that go right
+    const bool frontToBack = (to > from) == (displaced <= count);
+    beginSectionBatch();
+    for (int i = 0; i < order.size(); ++i) {
+        const int position = frontToBack ? i : order.size() - 1 - i;
+        const int visual = visualIndex(order.at(position));
+        if (visual != low + position)
+            moveSection(visual, low + position);
+    }
+    endSectionBatch();
+}
+
 void HierarchicalHeaderView::setLeafAlignment(Qt::Alignment alignment)
 {
     _pd->setLeafAlignment(alignment);
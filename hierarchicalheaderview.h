@@ -4,6 +4,11 @@
 #include <QtWidgets/QHeaderView>
 #include "hierarchicalheadermodel.h"
 
+class HierarchicalHeaderIconCache;
+class HierarchicalHeaderLayout;
+class HierarchicalHeaderRenderer;
+class HierarchicalRowGroups;
+
 class HierarchicalHeaderView : public QHeaderView
 {
     Q_OBJECT
@@ -20,7 +25,46 @@ public:
         SelectedBackGroundRole,
         UnSelectedBackGroundRole,
         BorderRole,
-        TextRole
+        TextRole,
+        HoverBackGroundRole,
+        SearchMatchBackGroundRole
+    };
+
+    enum DetailLevel {
+        FullDetail,
+        SimplifiedDetail, // no text, one band per run of narrow leaves
+        OverviewDetail    // one band per top level span
+    };
+
+    enum HitElement {
+        NoElement,
+        LabelElement,
+        SortArrowElement,
+        FilterButtonElement,
+        ResizeEdgeElement,
+        CollapseToggleElement
+    };
+
+    enum AggregateFunction {
+        AggregateSum = 0x1,
+        AggregateMin = 0x2,
+        AggregateMax = 0x4,
+        AggregateMean = 0x8
+    };
+    Q_DECLARE_FLAGS(AggregateFunctions, AggregateFunction)
+
+    enum SearchMode {
+        SubstringSearch,
+        PrefixSearch
+    };
+
+    struct HitTestResult
+    {
+        QModelIndex index;   // header cell under the point, leaf or parent
+        int logicalIndex;    // section under the point
+        int depth;
+        HitElement element;
+        QRect rect;          // viewport rect of the cell
     };
 
     HierarchicalHeaderView(Qt::Orientation orientation, QWidget* parent = Q_NULLPTR);
@@ -41,6 +85,55 @@ public:
     void setColunmFilterState(const int &column, const int &value, const int &role);
     QModelIndex getModelIndexByColumn(const int &column);
 
+    void setDetailThresholds(int simplifiedWidth, int overviewWidth);
+    DetailLevel detailLevel(int logicalIndex) const;
+
+    void setGroupsCollapsible(bool flag);
+    bool groupsCollapsible() const;
+    void setGroupCollapsed(const QModelIndex &groupIndex, bool collapsed);
+    bool isGroupCollapsed(const QModelIndex &groupIndex) const;
+    void toggleGroup(const QModelIndex &groupIndex);
+    bool moveGroup(const QModelIndex &groupIndex, const QModelIndex &targetIndex, bool after);
+    bool resizeGroup(const QModelIndex &groupIndex, int size);
+
+    void setLevelSize(int depth, int size);
+    int levelSize(int depth) const;
+
+    HitTestResult hitTest(const QPoint &pos) const;
+
+    QByteArray saveState() const;
+    bool restoreState(const QByteArray &state);
+
+    quint64 layoutVersion() const;
+    HierarchicalHeaderLayout layoutSnapshot() const;
+    bool verifyLayoutCache(QString *error = Q_NULLPTR) const;
+    HierarchicalHeaderRenderer renderer() const;
+
+    // cell icons named through HierarchicalHeaderModel::IconName, at the item view iconSize()
+    void setIconCache(HierarchicalHeaderIconCache *cache);
+    HierarchicalHeaderIconCache *iconCache() const;
+
+    // vertical headers over a plain table model
+    void setRowGroups(const HierarchicalRowGroups &groups);
+    HierarchicalRowGroups rowGroups() const;
+    void setRowGroupWidth(int width);
+
+    void setSearchText(const QString &text, SearchMode mode = SubstringSearch);
+    QString searchText() const;
+    int searchMatchCount() const;
+    QModelIndex currentSearchMatch() const;
+    bool findNext();
+    bool findPrevious();
+    void setSearchBoxVisible(bool visible);
+    bool isSearchBoxVisible() const;
+
+    // summary band under the titles of a horizontal header, group cells show the rollup of their leaves
+    void setAggregateModel(QAbstractItemModel *model, int role = Qt::DisplayRole);
+    void setAggregateFunctions(AggregateFunctions functions);
+    AggregateFunctions aggregateFunctions() const;
+    void setAggregateBandVisible(bool visible);
+    bool isAggregateBandVisible() const;
+
     QSize sizeHint() const;
 
     inline void setFrozenHeader(HierarchicalHeaderView *header) { m_frozenHeader = header; }
@@ -49,8 +142,14 @@ public:
 signals:
     void signalArrowType(int column, bool Ascending);
     void signalFilterBtnClicked(const int &column, const QRect &popRect);
+    void signalGroupCollapsed(const QModelIndex &groupIndex, bool collapsed);
+    void signalGroupMoved(const QModelIndex &groupIndex);
+    void signalGroupResized(const QModelIndex &groupIndex, int size);
+    void signalCellClicked(const QModelIndex &cellIndex, int depth);
+    void signalSearchMatchesChanged(int count);
 
 protected:
+    void paintEvent(QPaintEvent *e) override;
     void paintSection(QPainter* painter, const QRect &rect, int logicalIndex) const;
     QSize sectionSizeFromContents(int logicalIndex) const;
 
@@ -58,8 +157,12 @@ protected:
     void mouseMoveEvent(QMouseEvent *e) override;
     void mouseReleaseEvent(QMouseEvent *e) override;
     bool viewportEvent(QEvent *e) override;
+    void changeEvent(QEvent *e) override;
+    void timerEvent(QTimerEvent *e) override;
+    void resizeEvent(QResizeEvent *e) override;
 
-    bool checkIsFilterBtnClicked(const int &logicalIndex);
+    bool checkIsFilterBtnClicked(const HitTestResult &hit);
+    void selectFromClick(const HitTestResult &hit, Qt::KeyboardModifiers modifiers);
     void setClickSelectedColumn(int logicalIndex);
     int getPrevSelected() const;
 
@@ -69,9 +172,29 @@ protected:
 private slots:
     void slotSectionResized(int logicalIndex);
     void slotHeaderDataChange(int logicalIndex);
+    void slotHeaderLayoutChanged();
+    void slotHeaderTitleChanged(const QModelIndex &topLeft, const QModelIndex &bottomRight, const QVector<int> &roles);
+    void slotSectionMoved(int logicalIndex, int oldVisualIndex, int newVisualIndex);
+    void slotSelectionChanged(int first, int last);
+    void slotIconSizeChanged();
+    void slotSearchTextEdited(const QString &text);
+    void slotSearchReturnPressed();
 
 private:
     QStyleOptionHeader styleOptionForCell(int logicalIndex) const;
+    QRect sectionRect(int logicalIndex) const;
+    void beginSectionBatch();
+    void endSectionBatch();
+    void applyGroupVisibility(int node);
+    bool groupResizeSections(int node, QVector<int> &sections, QVector<int> &sizes) const;
+    void applyGroupSize(const QVector<int> &sections, const QVector<int> &sizes, int size);
+    void moveVisualBlock(int from, int count, int to);
+    void updateHover(const QPoint &pos);
+    void refreshSearch();
+    void showSearchMatch();
+    void scrollToSection(int logicalIndex);
+    void placeSearchBox();
+    void updateAggregateBand();
 
     class private_data;
     private_data *_pd;
@@ -79,4 +202,6 @@ private:
 
 };
 
+Q_DECLARE_OPERATORS_FOR_FLAGS(HierarchicalHeaderView::AggregateFunctions)
+
 #endif
@@ -0,0 +1,81 @@
+#include "hierarchicalrowgroups.h"
+#include <algorithm>
+
+HierarchicalRowGroups::HierarchicalRowGroups()
+{
+}
+
+bool HierarchicalRowGroups::isEmpty() const
+{
+    return m_levels.isEmpty();
+}
+
+void HierarchicalRowGroups::clear()
+{
+    m_levels.clear();
+}
+
+int HierarchicalRowGroups::levelCount() const
+{
+    return m_levels.size();
+}
+
+int HierarchicalRowGroups::groupCount(int level) const
+{
+    if (level < 0 || level >= m_levels.size())
+        return 0;
+    return m_levels.at(level).starts.size();
+}
+
+/**
+ * @brief HierarchicalRowGroups::appendGroup add the span [firstRow, firstRow + rowCount) to level,
+ * missing levels in front of it are created empty
+ * @return false if the span is empty or starts before the end of the previous span of the level
+ */
+bool HierarchicalRowGroups::appendGroup(int level, int firstRow, int rowCount, const QString &title)
+{
+    if (level < 0 || firstRow < 0 || rowCount <= 0)
+        return false;
+    if (level >= m_levels.size())
+        m_levels.resize(level + 1);
+
+    Level &spans = m_levels[level];
+    if (!spans.ends.isEmpty() && firstRow < spans.ends.last())
+        return false;
+
+    spans.starts.append(firstRow);
+    spans.ends.append(firstRow + rowCount);
+    spans.titles.append(title);
+    return true;
+}
+
+/**
+ * @brief HierarchicalRowGroups::groupAt group of level containing row, -1 for rows between spans
+ */
+int HierarchicalRowGroups::groupAt(int level, int row) const
+{
+    if (level < 0 || level >= m_levels.size())
+        return -1;
+
+    const Level &spans = m_levels.at(level);
+    QVector<int>::const_iterator it = std::upper_bound(spans.starts.constBegin(), spans.starts.constEnd(), row);
+    const int group = int(it - spans.starts.constBegin()) - 1;
+    if (group < 0 || row >= spans.ends.at(group))
+        return -1;
+    return group;
+}
+
+int HierarchicalRowGroups::firstRow(int level, int group) const
+{
+    return m_levels.at(level).starts.at(group);
+}
+
+int HierarchicalRowGroups::rowCount(int level, int group) const
+{
+    return m_levels.at(level).ends.at(group) - m_levels.at(level).starts.at(group);
+}
+
+QString HierarchicalRowGroups::title(int level, int group) const
+{
+    return m_levels.at(level).titles.at(group);
+}
@@ -0,0 +1,48 @@
+#ifndef HIERARCHICAL_ROW_GROUPS_H
+#define HIERARCHICAL_ROW_GROUPS_H
+
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+/**
+ * @brief The HierarchicalRowGroups class row groups of a vertical HierarchicalHeaderView as
+ * run-length spans over row ranges, one list of spans per level (for example day, then hour).
+ * Memory follows the number of groups, a row is mapped to its group by binary search.
+ */
+class HierarchicalRowGroups
+{
+public:
+    HierarchicalRowGroups();
+
+    bool isEmpty() const;
+    void clear();
+
+    int levelCount() const;
+    int groupCount(int level) const;
+
+    // spans of one level are appended in row order and must not overlap, gaps are allowed
+    bool appendGroup(int level, int firstRow, int rowCount, const QString &title);
+
+    int groupAt(int level, int row) const;
+    inline bool contains(int level, int group, int row) const
+    {
+        const Level &spans = m_levels.at(level);
+        return row >= spans.starts.at(group) && row < spans.ends.at(group);
+    }
+    int firstRow(int level, int group) const;
+    int rowCount(int level, int group) const;
+    QString title(int level, int group) const;
+
+private:
+    struct Level
+    {
+        QVector<int> starts;
+        QVector<int> ends;
+        QStringList titles;
+    };
+
+    QVector<Level> m_levels;
+};
+
+#endif // HIERARCHICAL_ROW_GROUPS_H
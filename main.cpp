@@ -1,11 +1,23 @@
 #include "mainwindow.h"
+#include "hierarchicalheadertrace.h"
 #include <QApplication>
 
 int main(int argc, char *argv[])
 {
     QApplication a(argc, argv);
+
+    // QMULTIHEADER_TRACE=file.json records a header timeline and writes it on exit
+    const QString traceFile = QString::fromLocal8Bit(qgetenv("QMULTIHEADER_TRACE"));
+    if (!traceFile.isEmpty())
+        HierarchicalHeaderTrace::setEnabled(true);
+
     MainWindow w;
     w.show();
 
-    return a.exec();
+    int result = a.exec();
+    if (!traceFile.isEmpty()) {
+        HierarchicalHeaderTrace::setEnabled(false);
+        HierarchicalHeaderTrace::dump(traceFile);
+    }
+    return result;
 }
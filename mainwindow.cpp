@@ -38,6 +38,7 @@ MainWindow::MainWindow(QWidget *parent) :
     QTreeWidget *newTree = new QTreeWidget(this);
     HierarchicalHeaderView *horizontalheader = new HierarchicalHeaderView(Qt::Horizontal, this);
     horizontalheader->setCanSort(true);
+    horizontalheader->setGroupsCollapsible(true);
     horizontalheader->setModel(newModel);
     newTree->setHeader(horizontalheader);
 
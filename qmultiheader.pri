@@ -0,0 +1,36 @@
+# Header widget sources, shared by the demo application and the benchmarks
+
+INCLUDEPATH += $$PWD
+DEPENDPATH += $$PWD
+
+SOURCES += \
+        $$PWD/hierarchicalcolumnproxymodel.cpp \
+        $$PWD/hierarchicalheaderaggregates.cpp \
+        $$PWD/hierarchicalheaderexporter.cpp \
+        $$PWD/hierarchicalheadericoncache.cpp \
+        $$PWD/hierarchicalheaderlayout.cpp \
+        $$PWD/hierarchicalheadermodel.cpp \
+        $$PWD/hierarchicalheaderrenderer.cpp \
+        $$PWD/hierarchicalheadersearchindex.cpp \
+        $$PWD/hierarchicalheaderselection.cpp \
+        $$PWD/hierarchicalheadertrace.cpp \
+        $$PWD/hierarchicalheaderschema.cpp \
+        $$PWD/hierarchicalheaderview.cpp \
+        $$PWD/hierarchicalrowgroups.cpp
+
+HEADERS += \
+        $$PWD/hierarchicalcolumnproxymodel.h \
+        $$PWD/hierarchicalheaderaggregates.h \
+        $$PWD/hierarchicalheaderexporter.h \
+        $$PWD/hierarchicalheadericoncache.h \
+        $$PWD/hierarchicalheaderlayout.h \
+        $$PWD/hierarchicalheadermodel.h \
+        $$PWD/hierarchicalheadermutationqueue.h \
+        $$PWD/hierarchicalheaderrenderer.h \
+        $$PWD/hierarchicalheadersearchindex.h \
+        $$PWD/hierarchicalheaderselection.h \
+        $$PWD/hierarchicalheaderstaticschema.h \
+        $$PWD/hierarchicalheadertrace.h \
+        $$PWD/hierarchicalheaderschema.h \
+        $$PWD/hierarchicalheaderview.h \
+        $$PWD/hierarchicalrowgroups.h